@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
 #include <vector>
-#include <string>
 
 namespace sn
 {
@@ -12,7 +14,11 @@ enum class PeerType
     UI
 };
 
-enum class IOType
+/*!
+    @brief The type of an IO. Existing marks an IO in an update message, which carries only the ID
+           and value of an IO whose type was given when its node connected.
+ */
+enum class IOType : std::uint8_t
 {
     DigitalInput,
     DigitalOutput,
@@ -23,41 +29,26 @@ enum class IOType
 
 struct IO
 {
-    IO( const IOId ioId, const std::string& ioType, const int ioValue )
+    IO( const IOId ioId, const IOType ioType, const int ioValue )
         : id( ioId )
         , type( ioType )
         , value( ioValue )
     {}
 
-    IO( const IO& other )
-    {
-        id = other.id;
-        value = other.value;
-
-        if ( type != "Existing" )
-        {
-            type = other.type;
-        }
-    }
-
-    IO& operator=( IO rhs )
-    {
-        id = rhs.id;
-        value = rhs.value;
-
-        if ( rhs.type != "Existing" )
-        {
-            type = rhs.type;
-        }
-
-        return *this;
-    }
-
     IOId id;
-    std::string type; // TODO: Change this to use the enum IOType
+    IOType type;
     int value;
 };
 
+static_assert(
+    std::is_trivially_copyable_v<IO>,
+    "IOs are copied in bulk, so they must stay trivially copyable" );
+
+/*!
+    @brief A node and its IOs. The IOs can be allocated from a memory resource such as an arena
+           that is reset after each message. Copies of a node always use the default resource, so
+           a node copied out of a parsed message outlives the arena it was parsed into.
+ */
 struct Node
 {
     Node()
@@ -65,18 +56,20 @@ struct Node
         , io()
     {}
 
-    Node( const NodeId& nodeId )
+    Node(
+        const NodeId& nodeId,
+        std::pmr::memory_resource* const resource = std::pmr::get_default_resource() )
         : id( nodeId )
-        , io()
+        , io( resource )
     {}
 
     Node( const NodeId& nodeId, const std::vector<IO>& ios )
         : id( nodeId )
-        , io( ios )
+        , io( ios.begin(), ios.end() )
     {}
 
     NodeId id;
-    std::vector<IO> io;
+    std::pmr::vector<IO> io;
 };
 
 struct UI
@@ -84,4 +77,18 @@ struct UI
     UIId id;
 };
 
+/*!
+    @brief Milliseconds since the Unix epoch.
+ */
+using Timestamp = std::uint64_t;
+
+/*!
+    @brief The value of an IO at one point in time.
+ */
+struct HistorySample
+{
+    Timestamp time;
+    int value;
+};
+
 } // namespace sn
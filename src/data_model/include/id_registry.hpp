@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief Gives each registered ID a dense slot number, so that state kept per ID can live in
+           plain arrays indexed by slot rather than in maps keyed by ID. IDs are arbitrary values
+           picked by peers, so they are only translated to slots where they arrive from the wire.
+
+           The slot of a released ID is handed to the next ID registered, most recently released
+           first, so the number of slots never exceeds the most IDs registered at once.
+ */
+template<typename Id>
+class IdRegistry final
+{
+public:
+    /*!
+        @brief Returns the slot of the ID, giving it one if it is not registered yet.
+     */
+    std::size_t Register( const Id id )
+    {
+        const auto existing = m_slots.find( id );
+        if ( existing != m_slots.end() )
+        {
+            return existing->second;
+        }
+
+        std::size_t slot = m_ids.size();
+        if ( m_freeSlots.empty() )
+        {
+            m_ids.push_back( id );
+            m_used.push_back( true );
+        }
+        else
+        {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+            m_ids[slot] = id;
+            m_used[slot] = true;
+        }
+
+        m_slots.emplace( id, slot );
+        return slot;
+    }
+
+    /*!
+        @brief Releases the slot of the ID so that it can be given to another.
+        @returns The slot the ID had, or an empty optional if it is not registered.
+     */
+    std::optional<std::size_t> Release( const Id id )
+    {
+        const auto existing = m_slots.find( id );
+        if ( existing == m_slots.end() )
+        {
+            return std::nullopt;
+        }
+
+        const auto slot = existing->second;
+        m_slots.erase( existing );
+        m_used[slot] = false;
+        m_freeSlots.push_back( slot );
+        return slot;
+    }
+
+    /*!
+        @brief Returns the slot of the ID, or an empty optional if it is not registered.
+     */
+    std::optional<std::size_t> Find( const Id id ) const
+    {
+        const auto existing = m_slots.find( id );
+        if ( existing == m_slots.end() )
+        {
+            return std::nullopt;
+        }
+
+        return existing->second;
+    }
+
+    bool Contains( const Id id ) const
+    {
+        return m_slots.find( id ) != m_slots.end();
+    }
+
+    /*!
+        @brief Returns true if the slot is held by a registered ID.
+     */
+    bool InUse( const std::size_t slot ) const
+    {
+        return slot < m_used.size() && m_used[slot];
+    }
+
+    /*!
+        @brief Returns the ID that holds the slot, which must be in use.
+     */
+    Id IdAt( const std::size_t slot ) const
+    {
+        return m_ids[slot];
+    }
+
+    /*!
+        @brief Returns the number of IDs registered.
+     */
+    std::size_t Size() const
+    {
+        return m_slots.size();
+    }
+
+    /*!
+        @brief Returns one more than the highest slot ever given out, which is the size arrays
+               indexed by slot need to be.
+     */
+    std::size_t SlotCount() const
+    {
+        return m_ids.size();
+    }
+
+    /*!
+        @brief Calls the callback with the slot and ID of every registered ID, in slot order.
+     */
+    template<typename Callback>
+    void ForEach( Callback&& callback ) const
+    {
+        for ( std::size_t slot = 0; slot < m_ids.size(); ++slot )
+        {
+            if ( m_used[slot] )
+            {
+                callback( slot, m_ids[slot] );
+            }
+        }
+    }
+
+    void Clear()
+    {
+        m_slots.clear();
+        m_ids.clear();
+        m_used.clear();
+        m_freeSlots.clear();
+    }
+
+private:
+    std::unordered_map<Id, std::size_t> m_slots;
+    std::vector<Id> m_ids;
+    std::vector<bool> m_used;
+    std::vector<std::size_t> m_freeSlots;
+};
+
+} // namespace sn
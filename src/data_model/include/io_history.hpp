@@ -0,0 +1,200 @@
+#pragma once
+
+#include "id_registry.hpp"
+#include "id_types.hpp"
+#include "data_types.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief The recent values of the IOs of a set of nodes. Each IO has a ring buffer holding its
+           last Depth() samples, so memory use depends only on the depth and the number of IOs
+           tracked, never on how many updates arrive. Each tracked IO is given a slot, and the
+           rings live in one array indexed by slot, so the rings of removed nodes are reused by
+           the nodes added after them.
+ */
+class IOHistory final
+{
+public:
+    /*!
+        @param[in] depth The number of samples kept for each IO. Must not be zero.
+     */
+    explicit IOHistory( const std::size_t depth )
+        : m_depth( depth )
+    {}
+
+    std::size_t Depth() const
+    {
+        return m_depth;
+    }
+
+    /*!
+        @brief Starts tracking the IOs of a node, with their current values as the first samples.
+               Any history of a node with the same ID is discarded.
+     */
+    void AddNode( const Node& node, const Timestamp time )
+    {
+        RemoveNode( node.id );
+
+        auto& ioIds = m_nodeIOs[node.id];
+        for ( const auto& io : node.io )
+        {
+            const auto key = IOKey( node.id, io.id );
+            if ( m_ioSlots.Contains( key ) )
+            {
+                // The node listed the IO more than once.
+                continue;
+            }
+
+            const auto ring = AllocateRing( key );
+            ioIds.push_back( io.id );
+
+            Push( ring, HistorySample{ time, io.value } );
+        }
+    }
+
+    /*!
+        @brief Stops tracking the IOs of a node and discards their history.
+        @returns False if the node is not tracked.
+     */
+    bool RemoveNode( const NodeId id )
+    {
+        const auto node = m_nodeIOs.find( id );
+        if ( node == m_nodeIOs.end() )
+        {
+            return false;
+        }
+
+        for ( const auto ioId : node->second )
+        {
+            const auto ring = m_ioSlots.Release( IOKey( id, ioId ) );
+            m_rings[*ring] = Ring{};
+        }
+
+        m_nodeIOs.erase( node );
+        return true;
+    }
+
+    /*!
+        @brief Records a new value of an IO, overwriting its oldest sample once its ring is full.
+        @returns False if the IO is not tracked.
+     */
+    bool Record( const NodeId nodeId, const IOId ioId, const int value, const Timestamp time )
+    {
+        const auto ring = m_ioSlots.Find( IOKey( nodeId, ioId ) );
+        if ( !ring )
+        {
+            return false;
+        }
+
+        Push( *ring, HistorySample{ time, value } );
+        return true;
+    }
+
+    /*!
+        @brief Appends the samples of an IO taken between since and until inclusive to out, oldest
+               first. If there are more than maxSamples of them, only the latest are appended.
+        @param[in] maxSamples The most samples to append, or zero for no limit.
+        @param[in] since The earliest sample time to include, or zero for no limit.
+        @param[in] until The latest sample time to include, or zero for no limit.
+        @returns False if the IO is not tracked.
+     */
+    bool Query(
+        const NodeId nodeId,
+        const IOId ioId,
+        const std::size_t maxSamples,
+        const Timestamp since,
+        const Timestamp until,
+        std::vector<HistorySample>& out ) const
+    {
+        const auto found = m_ioSlots.Find( IOKey( nodeId, ioId ) );
+        if ( !found )
+        {
+            return false;
+        }
+
+        const auto& ring = m_rings[*found];
+        const auto* const samples = m_samples.data() + *found * m_depth;
+        const auto limit = maxSamples == 0 ? ring.count : std::min( maxSamples, ring.count );
+        const auto latest = until == 0 ? std::numeric_limits<Timestamp>::max() : until;
+        const auto first = out.size();
+
+        // Walk back from the newest sample, then put what was collected in time order.
+        for ( std::size_t age = 0; age < ring.count && out.size() - first < limit; ++age )
+        {
+            const auto column = ( ring.next + m_depth - 1 - age ) % m_depth;
+            const auto& sample = samples[column];
+            if ( sample.time < since )
+            {
+                break;
+            }
+            else if ( sample.time <= latest )
+            {
+                out.push_back( sample );
+            }
+        }
+
+        std::reverse( out.begin() + static_cast<std::ptrdiff_t>( first ), out.end() );
+        return true;
+    }
+
+    /*!
+        @brief Returns the number of IOs tracked.
+     */
+    std::size_t Size() const
+    {
+        return m_ioSlots.Size();
+    }
+
+private:
+    //! Where the next sample of one IO goes and how many it has. Its samples are the Depth()
+    //! entries of m_samples starting at its slot times the depth.
+    struct Ring
+    {
+        std::size_t next = 0;
+        std::size_t count = 0;
+    };
+
+    static std::uint64_t IOKey( const NodeId nodeId, const IOId ioId )
+    {
+        return static_cast<std::uint64_t>( static_cast<std::uint32_t>( nodeId ) ) << 32 |
+               static_cast<std::uint32_t>( ioId );
+    }
+
+    std::size_t AllocateRing( const std::uint64_t key )
+    {
+        const auto slot = m_ioSlots.Register( key );
+        if ( slot == m_rings.size() )
+        {
+            m_rings.emplace_back();
+            m_samples.resize( m_samples.size() + m_depth );
+        }
+
+        return slot;
+    }
+
+    void Push( const std::size_t slot, const HistorySample& sample )
+    {
+        auto& ring = m_rings[slot];
+        m_samples[slot * m_depth + ring.next] = sample;
+        ring.next = ( ring.next + 1 ) % m_depth;
+        ring.count = std::min( ring.count + 1, m_depth );
+    }
+
+private:
+    const std::size_t m_depth;
+    std::vector<HistorySample> m_samples;
+    std::vector<Ring> m_rings;
+    IdRegistry<std::uint64_t> m_ioSlots;
+    std::unordered_map<NodeId, std::vector<IOId>> m_nodeIOs;
+};
+
+} // namespace sn
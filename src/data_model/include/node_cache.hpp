@@ -0,0 +1,464 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#include <intrin.h>
+#endif
+
+namespace sn
+{
+
+/*!
+    @brief The last known state of a set of nodes, stored by column: the IDs, types and values of
+           every IO live in three contiguous arrays, and each node owns a range of them. Nodes are
+           indexed by ID and IOs by node and IO ID, so that updates, lookups and removals take
+           constant time however many nodes there are. Nodes are kept in the order they were added.
+
+           Every value change sets a bit for the IO and one for its node, so that consumers can
+           visit what changed since their last sweep without walking every node.
+ */
+class NodeCache final
+{
+public:
+    /*!
+        @brief The IOs of one node, as a view into the columns of the cache. A view is invalidated
+               by any change to the set of nodes.
+     */
+    struct NodeView
+    {
+        NodeId id;
+        const IOId* ioIds;
+        const IOType* ioTypes;
+        const int* values;
+        std::size_t ioCount;
+
+        IO IOAt( const std::size_t index ) const
+        {
+            return IO( ioIds[index], ioTypes[index], values[index] );
+        }
+    };
+
+    /*!
+        @brief Adds a node, replacing the state of any node with the same ID.
+        @param[in] node The node to add. Its ID must not be invalid_node_id, and no two of its IOs
+                   may have the same ID.
+     */
+    void Add( const Node& node )
+    {
+        const auto existing = m_slotIndex.find( node.id );
+        if ( existing == m_slotIndex.end() )
+        {
+            m_slotIndex.emplace( node.id, m_slots.size() );
+            m_slots.push_back( NodeSlot{ node.id, 0, 0 } );
+            AppendIOs( m_slots.size() - 1, node );
+            return;
+        }
+
+        const auto slot = existing->second;
+        RemoveIOs( slot );
+        if ( m_slots[slot].ioCount == node.io.size() )
+        {
+            WriteIOs( slot, node );
+        }
+        else
+        {
+            m_deadIOs += m_slots[slot].ioCount;
+            AppendIOs( slot, node );
+            CompactIfSparse();
+        }
+    }
+
+    /*!
+        @brief Replaces the contents of the cache with the provided nodes.
+     */
+    void Assign( const std::vector<Node>& nodes )
+    {
+        Clear();
+        for ( const auto& node : nodes )
+        {
+            Add( node );
+        }
+    }
+
+    /*!
+        @brief Removes the node with the provided ID. Its slot and IOs are left empty rather than
+               moving the nodes after it, and are compacted once they outnumber the live ones.
+        @returns False if there is no node with the ID.
+     */
+    bool Remove( const NodeId id )
+    {
+        const auto existing = m_slotIndex.find( id );
+        if ( existing == m_slotIndex.end() )
+        {
+            return false;
+        }
+
+        const auto slot = existing->second;
+        RemoveIOs( slot );
+        m_deadIOs += m_slots[slot].ioCount;
+        m_slots[slot] = NodeSlot{ invalid_node_id, 0, 0 };
+        ClearBit( m_dirtyNodes, slot );
+        m_slotIndex.erase( existing );
+        ++m_deadSlots;
+
+        CompactIfSparse();
+        return true;
+    }
+
+    void Clear()
+    {
+        m_slots.clear();
+        m_slotIndex.clear();
+        m_ioIndex.clear();
+        m_ioIds.clear();
+        m_ioTypes.clear();
+        m_values.clear();
+        m_dirtyIOs.clear();
+        m_dirtyNodes.clear();
+        m_deadSlots = 0;
+        m_deadIOs = 0;
+    }
+
+    bool Contains( const NodeId id ) const
+    {
+        return m_slotIndex.find( id ) != m_slotIndex.end();
+    }
+
+    /*!
+        @brief Returns a view of the node with the provided ID, or an empty optional if there is
+               none.
+     */
+    std::optional<NodeView> FindNode( const NodeId id ) const
+    {
+        const auto slot = m_slotIndex.find( id );
+        if ( slot == m_slotIndex.end() )
+        {
+            return std::nullopt;
+        }
+
+        return View( m_slots[slot->second] );
+    }
+
+    /*!
+        @brief Returns the number of nodes in the cache.
+     */
+    std::size_t Size() const
+    {
+        return m_slotIndex.size();
+    }
+
+    /*!
+        @brief Sets the value of an IO, marking it as changed if the value differs.
+        @returns False if there is no such node or the node has no such IO.
+     */
+    bool UpdateValue( const NodeId nodeId, const IOId ioId, const int value )
+    {
+        const auto location = m_ioIndex.find( IOKey( nodeId, ioId ) );
+        if ( location == m_ioIndex.end() )
+        {
+            return false;
+        }
+
+        const auto [slot, column] = location->second;
+        if ( m_values[column] != value )
+        {
+            m_values[column] = value;
+            SetBit( m_dirtyIOs, column );
+            SetBit( m_dirtyNodes, slot );
+        }
+
+        return true;
+    }
+
+    /*!
+        @brief Calls the callback with a NodeView of each node, in the order they were added.
+     */
+    template<typename Callback>
+    void ForEachNode( Callback&& callback ) const
+    {
+        for ( const auto& slot : m_slots )
+        {
+            if ( slot.id != invalid_node_id )
+            {
+                callback( View( slot ) );
+            }
+        }
+    }
+
+    /*!
+        @brief Replaces the contents of the vector with a copy of every node, in the order they
+               were added.
+     */
+    void CopyNodes( std::vector<Node>& nodes ) const
+    {
+        nodes.clear();
+        nodes.reserve( Size() );
+        ForEachNode( [&nodes]( const NodeView& view ) {
+            auto& node = nodes.emplace_back( view.id );
+            node.io.reserve( view.ioCount );
+            for ( std::size_t index = 0; index < view.ioCount; ++index )
+            {
+                node.io.push_back( view.IOAt( index ) );
+            }
+        } );
+    }
+
+    /*!
+        @brief Returns true if any value has changed since the last sweep.
+     */
+    bool HasChanges() const
+    {
+        for ( const auto word : m_dirtyNodes )
+        {
+            if ( word != 0 )
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /*!
+        @brief Calls the callback with the node ID and current state of every IO whose value has
+               changed since the last sweep, then clears the changes. Only the bitsets are scanned,
+               a word of 64 nodes or IOs at a time, so unchanged nodes cost next to nothing. The
+               callback must not change the cache.
+     */
+    template<typename Callback>
+    void SweepChanges( Callback&& callback )
+    {
+        for ( std::size_t nodeWord = 0; nodeWord < m_dirtyNodes.size(); ++nodeWord )
+        {
+            for ( auto nodeBits = m_dirtyNodes[nodeWord]; nodeBits != 0; nodeBits &= nodeBits - 1 )
+            {
+                const auto& slot = m_slots[nodeWord * bitsPerWord + LowestSetBit( nodeBits )];
+                const auto end = slot.firstIO + slot.ioCount;
+
+                for ( auto column = slot.firstIO; column < end; ++column )
+                {
+                    if ( TestBit( m_dirtyIOs, column ) )
+                    {
+                        ClearBit( m_dirtyIOs, column );
+                        callback(
+                            slot.id,
+                            IO( m_ioIds[column], m_ioTypes[column], m_values[column] ) );
+                    }
+                }
+            }
+
+            m_dirtyNodes[nodeWord] = 0;
+        }
+    }
+
+private:
+    //! The range of the IO columns that belongs to one node.
+    struct NodeSlot
+    {
+        NodeId id;
+        std::size_t firstIO;
+        std::size_t ioCount;
+    };
+
+    //! Where the state of one IO is kept.
+    struct IOLocation
+    {
+        std::size_t slot;
+        std::size_t column;
+    };
+
+    static constexpr std::size_t bitsPerWord = 64;
+
+    static std::uint64_t IOKey( const NodeId nodeId, const IOId ioId )
+    {
+        return static_cast<std::uint64_t>( static_cast<std::uint32_t>( nodeId ) ) << 32 |
+               static_cast<std::uint32_t>( ioId );
+    }
+
+    NodeView View( const NodeSlot& slot ) const
+    {
+        return NodeView{ slot.id,
+                         m_ioIds.data() + slot.firstIO,
+                         m_ioTypes.data() + slot.firstIO,
+                         m_values.data() + slot.firstIO,
+                         slot.ioCount };
+    }
+
+    /*!
+        @brief Appends the IOs of the node to the end of the columns and points the slot at them.
+     */
+    void AppendIOs( const std::size_t slot, const Node& node )
+    {
+        m_slots[slot].firstIO = m_values.size();
+        m_slots[slot].ioCount = node.io.size();
+
+        m_ioIds.resize( m_ioIds.size() + node.io.size() );
+        m_ioTypes.resize( m_ioTypes.size() + node.io.size() );
+        m_values.resize( m_values.size() + node.io.size() );
+        WriteIOs( slot, node );
+    }
+
+    /*!
+        @brief Writes the IOs of the node over the columns the slot already owns, which must be
+               exactly as many as the node has.
+     */
+    void WriteIOs( const std::size_t slot, const Node& node )
+    {
+        m_dirtyIOs.resize( WordsFor( m_values.size() ), 0 );
+        m_dirtyNodes.resize( WordsFor( m_slots.size() ), 0 );
+
+        auto column = m_slots[slot].firstIO;
+        for ( const auto& io : node.io )
+        {
+            m_ioIds[column] = io.id;
+            m_ioTypes[column] = io.type;
+            m_values[column] = io.value;
+            ClearBit( m_dirtyIOs, column );
+            m_ioIndex[IOKey( node.id, io.id )] = IOLocation{ slot, column };
+            ++column;
+        }
+    }
+
+    /*!
+        @brief Removes the IOs of the slot from the IO index and clears their changes. The columns
+               themselves are left as they are.
+     */
+    void RemoveIOs( const std::size_t slot )
+    {
+        const auto& nodeSlot = m_slots[slot];
+        const auto end = nodeSlot.firstIO + nodeSlot.ioCount;
+        for ( auto column = nodeSlot.firstIO; column < end; ++column )
+        {
+            m_ioIndex.erase( IOKey( nodeSlot.id, m_ioIds[column] ) );
+            ClearBit( m_dirtyIOs, column );
+        }
+
+        ClearBit( m_dirtyNodes, slot );
+    }
+
+    void CompactIfSparse()
+    {
+        if ( m_deadSlots > m_slotIndex.size() || m_deadIOs > m_values.size() - m_deadIOs )
+        {
+            Compact();
+        }
+    }
+
+    /*!
+        @brief Moves the live nodes and their IOs to the front of the slots and columns, keeping
+               their order and their changes.
+     */
+    void Compact()
+    {
+        std::vector<NodeSlot> slots;
+        std::vector<IOId> ioIds;
+        std::vector<IOType> ioTypes;
+        std::vector<int> values;
+        std::vector<std::uint64_t> dirtyIOs( WordsFor( m_values.size() - m_deadIOs ), 0 );
+        std::vector<std::uint64_t> dirtyNodes( WordsFor( m_slotIndex.size() ), 0 );
+        slots.reserve( m_slotIndex.size() );
+        ioIds.reserve( m_values.size() - m_deadIOs );
+        ioTypes.reserve( m_values.size() - m_deadIOs );
+        values.reserve( m_values.size() - m_deadIOs );
+
+        for ( std::size_t slot = 0; slot < m_slots.size(); ++slot )
+        {
+            const auto& nodeSlot = m_slots[slot];
+            if ( nodeSlot.id == invalid_node_id )
+            {
+                continue;
+            }
+
+            if ( TestBit( m_dirtyNodes, slot ) )
+            {
+                SetBit( dirtyNodes, slots.size() );
+            }
+
+            m_slotIndex[nodeSlot.id] = slots.size();
+            slots.push_back( NodeSlot{ nodeSlot.id, values.size(), nodeSlot.ioCount } );
+
+            const auto end = nodeSlot.firstIO + nodeSlot.ioCount;
+            for ( auto column = nodeSlot.firstIO; column < end; ++column )
+            {
+                if ( TestBit( m_dirtyIOs, column ) )
+                {
+                    SetBit( dirtyIOs, values.size() );
+                }
+
+                m_ioIndex[IOKey( nodeSlot.id, m_ioIds[column] )] =
+                    IOLocation{ slots.size() - 1, values.size() };
+                ioIds.push_back( m_ioIds[column] );
+                ioTypes.push_back( m_ioTypes[column] );
+                values.push_back( m_values[column] );
+            }
+        }
+
+        m_slots = std::move( slots );
+        m_ioIds = std::move( ioIds );
+        m_ioTypes = std::move( ioTypes );
+        m_values = std::move( values );
+        m_dirtyIOs = std::move( dirtyIOs );
+        m_dirtyNodes = std::move( dirtyNodes );
+        m_deadSlots = 0;
+        m_deadIOs = 0;
+    }
+
+    static std::size_t WordsFor( const std::size_t bits )
+    {
+        return ( bits + bitsPerWord - 1 ) / bitsPerWord;
+    }
+
+    static bool TestBit( const std::vector<std::uint64_t>& bits, const std::size_t index )
+    {
+        return ( bits[index / bitsPerWord] >> ( index % bitsPerWord ) & 1 ) != 0;
+    }
+
+    static void SetBit( std::vector<std::uint64_t>& bits, const std::size_t index )
+    {
+        bits[index / bitsPerWord] |= std::uint64_t{ 1 } << ( index % bitsPerWord );
+    }
+
+    static void ClearBit( std::vector<std::uint64_t>& bits, const std::size_t index )
+    {
+        if ( index / bitsPerWord < bits.size() )
+        {
+            bits[index / bitsPerWord] &= ~( std::uint64_t{ 1 } << ( index % bitsPerWord ) );
+        }
+    }
+
+    static std::size_t LowestSetBit( const std::uint64_t bits )
+    {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+        unsigned long index = 0;
+        _BitScanForward64( &index, bits );
+        return index;
+#else
+        return static_cast<std::size_t>( __builtin_ctzll( bits ) );
+#endif
+    }
+
+private:
+    std::vector<NodeSlot> m_slots;
+    std::unordered_map<NodeId, std::size_t> m_slotIndex;
+    std::unordered_map<std::uint64_t, IOLocation> m_ioIndex;
+
+    std::vector<IOId> m_ioIds;
+    std::vector<IOType> m_ioTypes;
+    std::vector<int> m_values;
+
+    std::vector<std::uint64_t> m_dirtyIOs;
+    std::vector<std::uint64_t> m_dirtyNodes;
+
+    std::size_t m_deadSlots = 0;
+    std::size_t m_deadIOs = 0;
+};
+
+} // namespace sn
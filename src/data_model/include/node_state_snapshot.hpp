@@ -0,0 +1,371 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+#include "node_cache.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief An immutable copy of the state of every node at one point in time, which may be read
+           from any thread. The nodes are stored in chunks, and a later snapshot shares every chunk
+           in which no node has changed.
+ */
+class NodeStateSnapshot final
+{
+public:
+    //! The nodes of one chunk. The IOs of node i are ios[ioOffsets[i]] to ios[ioOffsets[i + 1]].
+    struct Chunk
+    {
+        std::vector<NodeId> ids;
+        std::vector<std::size_t> ioOffsets;
+        std::vector<IO> ios;
+    };
+
+    //! The IOs of one node, as a view into a chunk.
+    struct NodeView
+    {
+        NodeId id;
+        const IO* io;
+        std::size_t ioCount;
+    };
+
+    NodeStateSnapshot(
+        const std::uint64_t version,
+        std::vector<std::shared_ptr<const Chunk>> chunks )
+        : m_version( version )
+        , m_size( 0 )
+        , m_chunks( std::move( chunks ) )
+    {
+        for ( const auto& chunk : m_chunks )
+        {
+            m_size += chunk->ids.size();
+        }
+    }
+
+    /*!
+        @brief Returns the number of snapshots published before this one, so that readers can tell
+               whether the state has changed since a snapshot they read earlier.
+     */
+    std::uint64_t Version() const
+    {
+        return m_version;
+    }
+
+    /*!
+        @brief Returns the number of nodes in the snapshot.
+     */
+    std::size_t Size() const
+    {
+        return m_size;
+    }
+
+    /*!
+        @brief Calls the callback with a NodeView of each node, in the order they connected.
+     */
+    template<typename Callback>
+    void ForEachNode( Callback&& callback ) const
+    {
+        for ( const auto& chunk : m_chunks )
+        {
+            for ( std::size_t index = 0; index < chunk->ids.size(); ++index )
+            {
+                const auto first = chunk->ioOffsets[index];
+                callback( NodeView{ chunk->ids[index],
+                                    chunk->ios.data() + first,
+                                    chunk->ioOffsets[index + 1] - first } );
+            }
+        }
+    }
+
+private:
+    friend class NodeStatePublisher;
+    friend class NodeStateSnapshotRef;
+
+    const std::uint64_t m_version;
+    std::size_t m_size;
+    const std::vector<std::shared_ptr<const Chunk>> m_chunks;
+
+    // The number of NodeStateSnapshotRefs to this snapshot. A snapshot that has been replaced is
+    // only deleted once this drops to zero.
+    mutable std::atomic<std::size_t> m_refs{ 0 };
+};
+
+/*!
+    @brief Keeps a snapshot alive while it is read. Releasing it never blocks and never deletes
+           the snapshot, which is left to the publisher.
+ */
+class NodeStateSnapshotRef final
+{
+public:
+    NodeStateSnapshotRef() = default;
+
+    NodeStateSnapshotRef( NodeStateSnapshotRef&& other ) noexcept
+        : m_snapshot( std::exchange( other.m_snapshot, nullptr ) )
+    {}
+
+    NodeStateSnapshotRef& operator=( NodeStateSnapshotRef&& other ) noexcept
+    {
+        if ( this != &other )
+        {
+            Release();
+            m_snapshot = std::exchange( other.m_snapshot, nullptr );
+        }
+
+        return *this;
+    }
+
+    NodeStateSnapshotRef( const NodeStateSnapshotRef& ) = delete;
+    NodeStateSnapshotRef& operator=( const NodeStateSnapshotRef& ) = delete;
+
+    ~NodeStateSnapshotRef()
+    {
+        Release();
+    }
+
+    const NodeStateSnapshot& operator*() const
+    {
+        return *m_snapshot;
+    }
+
+    const NodeStateSnapshot* operator->() const
+    {
+        return m_snapshot;
+    }
+
+    explicit operator bool() const
+    {
+        return m_snapshot != nullptr;
+    }
+
+private:
+    friend class NodeStatePublisher;
+
+    //! Takes over a reference that has already been counted.
+    explicit NodeStateSnapshotRef( const NodeStateSnapshot* const snapshot )
+        : m_snapshot( snapshot )
+    {}
+
+    void Release()
+    {
+        if ( m_snapshot != nullptr )
+        {
+            m_snapshot->m_refs.fetch_sub( 1, std::memory_order_release );
+            m_snapshot = nullptr;
+        }
+    }
+
+    const NodeStateSnapshot* m_snapshot = nullptr;
+};
+
+/*!
+    @brief Publishes snapshots of a NodeCache for readers on other threads, in the style of
+           read-copy-update. A single writer thread tells the publisher which nodes changed and
+           publishes a new snapshot by swapping a pointer, copying only the chunks those nodes are
+           in. Readers on any thread acquire the latest snapshot without taking a lock, and the
+           writer never waits for them: replaced snapshots are deleted by a later Publish() once
+           no reader holds them.
+ */
+class NodeStatePublisher final
+{
+public:
+    NodeStatePublisher()
+        : m_current( new NodeStateSnapshot( 0, {} ) )
+    {}
+
+    NodeStatePublisher( const NodeStatePublisher& ) = delete;
+    NodeStatePublisher& operator=( const NodeStatePublisher& ) = delete;
+
+    /*!
+        @brief Deletes every snapshot. No NodeStateSnapshotRef may outlive the publisher.
+     */
+    ~NodeStatePublisher()
+    {
+        delete m_current.load();
+    }
+
+    /*!
+        @brief Notes that a node has connected or disconnected, so that the next snapshot is built
+               from scratch. Must only be called by the writer.
+     */
+    void NodesAddedOrRemoved()
+    {
+        m_rebuild = true;
+    }
+
+    /*!
+        @brief Notes that the values of a node have changed, so that the next snapshot copies its
+               chunk. Must only be called by the writer.
+     */
+    void NodeChanged( const NodeId id )
+    {
+        const auto chunk = m_chunkOf.find( id );
+        if ( chunk != m_chunkOf.end() && !m_chunkChanged[chunk->second] )
+        {
+            m_chunkChanged[chunk->second] = true;
+            m_changedChunks.push_back( chunk->second );
+        }
+    }
+
+    /*!
+        @brief Returns true if anything has changed since the last snapshot was published. Must
+               only be called by the writer.
+     */
+    bool HasChanges() const
+    {
+        return m_rebuild || !m_changedChunks.empty();
+    }
+
+    /*!
+        @brief Publishes a snapshot of the cache if anything has changed since the last one. Must
+               only be called by the writer.
+     */
+    void Publish( const NodeCache& nodes )
+    {
+        if ( m_rebuild )
+        {
+            Rebuild( nodes );
+        }
+        else if ( !m_changedChunks.empty() )
+        {
+            for ( const auto chunk : m_changedChunks )
+            {
+                m_chunks[chunk] = CopyChunk( nodes, m_chunks[chunk]->ids );
+                m_chunkChanged[chunk] = false;
+            }
+
+            m_changedChunks.clear();
+        }
+        else
+        {
+            return;
+        }
+
+        auto* const previous = m_current.exchange(
+            new NodeStateSnapshot( ++m_version, m_chunks ),
+            std::memory_order_seq_cst );
+        m_retired.emplace_back( previous );
+
+        DeleteUnreadSnapshots();
+    }
+
+    /*!
+        @brief Returns the latest snapshot. May be called from any thread, and never blocks.
+     */
+    NodeStateSnapshotRef Acquire() const
+    {
+        // While any reader is between loading the pointer and counting its reference, the
+        // publisher does not delete replaced snapshots.
+        m_acquiring.fetch_add( 1, std::memory_order_seq_cst );
+        const auto* const snapshot = m_current.load( std::memory_order_seq_cst );
+        snapshot->m_refs.fetch_add( 1, std::memory_order_relaxed );
+        m_acquiring.fetch_sub( 1, std::memory_order_release );
+
+        return NodeStateSnapshotRef( snapshot );
+    }
+
+private:
+    static constexpr std::size_t nodesPerChunk = 32;
+
+    using Chunk = NodeStateSnapshot::Chunk;
+
+    /*!
+        @brief Builds a chunk holding the current state of the provided nodes.
+     */
+    static std::shared_ptr<const Chunk> CopyChunk(
+        const NodeCache& nodes,
+        const std::vector<NodeId>& ids )
+    {
+        auto chunk = std::make_shared<Chunk>();
+        chunk->ids = ids;
+        chunk->ioOffsets.reserve( ids.size() + 1 );
+        chunk->ioOffsets.push_back( 0 );
+
+        for ( const auto id : ids )
+        {
+            if ( const auto node = nodes.FindNode( id ) )
+            {
+                for ( std::size_t index = 0; index < node->ioCount; ++index )
+                {
+                    chunk->ios.push_back( node->IOAt( index ) );
+                }
+            }
+
+            chunk->ioOffsets.push_back( chunk->ios.size() );
+        }
+
+        return chunk;
+    }
+
+    void Rebuild( const NodeCache& nodes )
+    {
+        m_chunks.clear();
+        m_chunkOf.clear();
+
+        std::vector<NodeId> ids;
+        nodes.ForEachNode( [this, &nodes, &ids]( const NodeCache::NodeView& node ) {
+            m_chunkOf.emplace( node.id, m_chunks.size() );
+            ids.push_back( node.id );
+
+            if ( ids.size() == nodesPerChunk )
+            {
+                m_chunks.push_back( CopyChunk( nodes, ids ) );
+                ids.clear();
+            }
+        } );
+
+        if ( !ids.empty() )
+        {
+            m_chunks.push_back( CopyChunk( nodes, ids ) );
+        }
+
+        m_chunkChanged.assign( m_chunks.size(), false );
+        m_changedChunks.clear();
+        m_rebuild = false;
+    }
+
+    void DeleteUnreadSnapshots()
+    {
+        // A reader that loaded the pointer to a replaced snapshot has counted its reference by
+        // the time it stops acquiring, so with no reader acquiring the counts can be trusted.
+        if ( m_acquiring.load( std::memory_order_seq_cst ) != 0 )
+        {
+            return;
+        }
+
+        std::size_t kept = 0;
+        for ( auto& snapshot : m_retired )
+        {
+            if ( snapshot->m_refs.load( std::memory_order_acquire ) != 0 )
+            {
+                m_retired[kept++] = std::move( snapshot );
+            }
+        }
+
+        m_retired.resize( kept );
+    }
+
+private:
+    std::atomic<const NodeStateSnapshot*> m_current;
+    mutable std::atomic<std::size_t> m_acquiring{ 0 };
+
+    // Everything below is only used by the writer.
+    std::vector<std::unique_ptr<const NodeStateSnapshot>> m_retired;
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    std::unordered_map<NodeId, std::size_t> m_chunkOf;
+    std::vector<bool> m_chunkChanged;
+    std::vector<std::size_t> m_changedChunks;
+    std::uint64_t m_version = 0;
+    bool m_rebuild = false;
+};
+
+} // namespace sn
@@ -0,0 +1,200 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace
+{
+
+std::atomic<std::size_t> allocationCount{ 0 };
+volatile std::size_t optimizationSink = 0;
+
+void* CountedAllocate( const std::size_t size )
+{
+    allocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+    if ( void* ptr = std::malloc( size == 0 ? 1 : size ) )
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* CountedAllocate( const std::size_t size, const std::align_val_t alignment )
+{
+    allocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+    const auto align = static_cast<std::size_t>( alignment );
+    const auto roundedSize = ( std::max<std::size_t>( size, 1 ) + align - 1 ) / align * align;
+
+#ifdef _MSC_VER
+    void* ptr = _aligned_malloc( roundedSize, align );
+#else
+    void* ptr = std::aligned_alloc( align, roundedSize );
+#endif
+
+    if ( ptr )
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void AlignedFree( void* ptr )
+{
+#ifdef _MSC_VER
+    _aligned_free( ptr );
+#else
+    std::free( ptr );
+#endif
+}
+
+} // namespace
+
+// Every allocation in the process goes through these, which is how allocations per message are
+// measured without instrumenting the messaging library.
+void* operator new( const std::size_t size )
+{
+    return CountedAllocate( size );
+}
+
+void* operator new[]( const std::size_t size )
+{
+    return CountedAllocate( size );
+}
+
+void operator delete( void* ptr ) noexcept
+{
+    std::free( ptr );
+}
+
+void operator delete[]( void* ptr ) noexcept
+{
+    std::free( ptr );
+}
+
+void operator delete( void* ptr, std::size_t ) noexcept
+{
+    std::free( ptr );
+}
+
+void operator delete[]( void* ptr, std::size_t ) noexcept
+{
+    std::free( ptr );
+}
+
+// The over-aligned forms are what std::pmr::new_delete_resource() allocates with.
+void* operator new( const std::size_t size, const std::align_val_t alignment )
+{
+    return CountedAllocate( size, alignment );
+}
+
+void* operator new[]( const std::size_t size, const std::align_val_t alignment )
+{
+    return CountedAllocate( size, alignment );
+}
+
+void operator delete( void* ptr, std::align_val_t ) noexcept
+{
+    AlignedFree( ptr );
+}
+
+void operator delete[]( void* ptr, std::align_val_t ) noexcept
+{
+    AlignedFree( ptr );
+}
+
+void operator delete( void* ptr, std::size_t, std::align_val_t ) noexcept
+{
+    AlignedFree( ptr );
+}
+
+void operator delete[]( void* ptr, std::size_t, std::align_val_t ) noexcept
+{
+    AlignedFree( ptr );
+}
+
+namespace sn::bench
+{
+
+std::size_t AllocationCount()
+{
+    return allocationCount.load( std::memory_order_relaxed );
+}
+
+void DoNotOptimize( const std::size_t value )
+{
+    optimizationSink = optimizationSink + value;
+}
+
+BenchmarkRunner::BenchmarkRunner(
+    const std::chrono::milliseconds minDuration,
+    const std::string& filter )
+    : m_minDuration( minDuration )
+    , m_filter( filter )
+    , m_results()
+{}
+
+void BenchmarkRunner::Run(
+    const std::string& name,
+    const std::size_t messagesPerBatch,
+    const std::function<std::size_t()>& batch )
+{
+    if ( name.find( m_filter ) == std::string::npos )
+    {
+        return;
+    }
+
+    // Warm up caches and let any lazily initialised state allocate before measuring.
+    batch();
+
+    BenchmarkResult result{ name, 0, 0, 0, std::chrono::nanoseconds( 0 ) };
+    const auto startAllocations = AllocationCount();
+    const auto start = std::chrono::steady_clock::now();
+
+    do
+    {
+        result.bytes += batch();
+        result.messages += messagesPerBatch;
+        result.elapsed = std::chrono::steady_clock::now() - start;
+    } while ( result.elapsed < m_minDuration );
+
+    result.allocations = AllocationCount() - startAllocations;
+    m_results.push_back( result );
+}
+
+void BenchmarkRunner::PrintResults( std::ostream& os ) const
+{
+    std::size_t nameWidth = 9;
+    for ( const auto& result : m_results )
+    {
+        nameWidth = std::max( nameWidth, result.name.size() );
+    }
+
+    os << std::left << std::setw( static_cast<int>( nameWidth ) ) << "benchmark" << std::right
+       << std::setw( 16 ) << "messages/s" << std::setw( 14 ) << "MB/s" << std::setw( 14 )
+       << "allocs/msg" << '\n';
+
+    for ( const auto& result : m_results )
+    {
+        const auto seconds = std::chrono::duration<double>( result.elapsed ).count();
+        const auto messages = static_cast<double>( result.messages );
+
+        os << std::left << std::setw( static_cast<int>( nameWidth ) ) << result.name << std::right
+           << std::fixed << std::setprecision( 0 ) << std::setw( 16 ) << messages / seconds
+           << std::setprecision( 2 ) << std::setw( 14 )
+           << static_cast<double>( result.bytes ) / seconds / 1e6 << std::setw( 14 )
+           << static_cast<double>( result.allocations ) / messages << '\n';
+    }
+}
+
+} // namespace sn::bench
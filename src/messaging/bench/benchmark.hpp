@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sn::bench
+{
+
+/*!
+    @brief Returns the number of calls made to the global operator new so far.
+ */
+std::size_t AllocationCount();
+
+/*!
+    @brief Prevents the compiler from discarding work whose result is otherwise unused.
+ */
+void DoNotOptimize( const std::size_t value );
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::size_t messages;
+    std::size_t bytes;
+    std::size_t allocations;
+    std::chrono::nanoseconds elapsed;
+};
+
+/*!
+    @brief Runs benchmarks and collects their throughput and allocation counts.
+ */
+class BenchmarkRunner final
+{
+public:
+    /*!
+        @param[in] minDuration Each benchmark repeats its batch until at least this much time has
+                   passed.
+        @param[in] filter Only benchmarks whose name contains this string are run.
+     */
+    BenchmarkRunner( const std::chrono::milliseconds minDuration, const std::string& filter );
+
+    /*!
+        @brief Runs a benchmark if it matches the filter.
+        @param[in] name The name reported for the benchmark.
+        @param[in] messagesPerBatch The number of messages handled by each call to batch.
+        @param[in] batch Handles a batch of messages and returns the number of message bytes that
+                   were read or written.
+     */
+    void Run(
+        const std::string& name,
+        const std::size_t messagesPerBatch,
+        const std::function<std::size_t()>& batch );
+
+    /*!
+        @brief Prints a table of every result collected so far.
+     */
+    void PrintResults( std::ostream& os ) const;
+
+private:
+    std::chrono::milliseconds m_minDuration;
+    std::string m_filter;
+    std::vector<BenchmarkResult> m_results;
+};
+
+} // namespace sn::bench
@@ -0,0 +1,466 @@
+#include "benchmark.hpp"
+#include "workloads.hpp"
+#include "delimiter_scanner.hpp"
+#include "full_state_cache.hpp"
+#include "message_builder.hpp"
+#include "node_cache.hpp"
+#include "parser.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const std::vector<std::size_t> nodeConnectIoCounts{ 1, 10, 100, 1000 };
+const std::vector<std::size_t> fullStateIoCounts{ 10, 100, 1000, 10000, 100000 };
+const std::vector<std::size_t> scanIoCounts{ 250000, 1000000 };
+const std::vector<std::size_t> nodeCacheIoCounts{ 10000, 1000000 };
+
+const std::size_t nodeConnectsPerBatch = 16;
+const std::size_t updatesPerBurst = 1000;
+const std::size_t burstNodeCount = 100;
+const std::size_t iosPerNode = 16;
+const std::size_t maxIosPerUpdate = 8;
+
+std::string FormatName( const sn::WireFormat format )
+{
+    return format == sn::WireFormat::Binary ? "binary" : "text";
+}
+
+std::vector<sn::ParsedMessage> MakeMessages(
+    const std::vector<sn::Node>& nodes,
+    const sn::MessageType type )
+{
+    std::vector<sn::ParsedMessage> messages;
+    for ( const auto& node : nodes )
+    {
+        messages.emplace_back( type );
+        messages.back().node = node;
+    }
+
+    return messages;
+}
+
+std::vector<std::string> EncodeAll(
+    const std::vector<sn::ParsedMessage>& messages,
+    const sn::WireFormat format )
+{
+    std::vector<std::string> encoded;
+    for ( const auto& msg : messages )
+    {
+        encoded.push_back( sn::EncodeMessage( msg, format ) );
+    }
+
+    return encoded;
+}
+
+void RunNodeConnectBenchmarks(
+    sn::bench::BenchmarkRunner& runner,
+    sn::bench::WorkloadGenerator& generator,
+    const sn::WireFormat format )
+{
+    for ( const auto ioCount : nodeConnectIoCounts )
+    {
+        std::vector<sn::Node> nodes;
+        for ( std::size_t index = 0; index < nodeConnectsPerBatch; ++index )
+        {
+            nodes.push_back( generator.MakeNode( static_cast<sn::NodeId>( index + 1 ), ioCount ) );
+        }
+
+        const auto messages =
+            EncodeAll( MakeMessages( nodes, sn::MessageType::NodeConnect ), format );
+        runner.Run(
+            "parse/node_connect/" + std::to_string( ioCount ) + "_io/" + FormatName( format ),
+            messages.size(),
+            [&messages, format]() {
+                std::size_t bytes = 0;
+                for ( const auto& message : messages )
+                {
+                    const auto parsedMsg = sn::parse( message, sn::PeerType::Node, format );
+                    sn::bench::DoNotOptimize( parsedMsg.node.io.size() );
+                    bytes += message.size();
+                }
+
+                return bytes;
+            } );
+    }
+}
+
+void RunUpdateBurstBenchmarks(
+    sn::bench::BenchmarkRunner& runner,
+    sn::bench::WorkloadGenerator& generator,
+    const sn::WireFormat format )
+{
+    const auto nodes = generator.MakeNodes( burstNodeCount * iosPerNode, iosPerNode );
+    const auto updates = MakeMessages(
+        generator.MakeUpdateBurst( nodes, updatesPerBurst, maxIosPerUpdate ),
+        sn::MessageType::NodeUpdate );
+    const auto messages = EncodeAll( updates, format );
+    const auto suffix = "/update_burst/" + FormatName( format );
+
+    runner.Run( "parse" + suffix, messages.size(), [&messages, format]() {
+        std::size_t bytes = 0;
+        for ( const auto& message : messages )
+        {
+            const auto parsedMsg = sn::parse( message, sn::PeerType::Node, format );
+            sn::bench::DoNotOptimize( parsedMsg.node.io.size() );
+            bytes += message.size();
+        }
+
+        return bytes;
+    } );
+
+    // Parses the way the server does, into an arena that is released after each message.
+    std::array<std::byte, 64 * 1024> arenaBuffer;
+    std::pmr::monotonic_buffer_resource arena( arenaBuffer.data(), arenaBuffer.size() );
+    runner.Run( "try_parse_arena" + suffix, messages.size(), [&messages, &arena, format]() {
+        std::size_t bytes = 0;
+        for ( const auto& message : messages )
+        {
+            {
+                const auto result = sn::try_parse( message, sn::PeerType::Node, format, &arena );
+                sn::bench::DoNotOptimize( result.Value().node.io.size() );
+            }
+
+            arena.release();
+            bytes += message.size();
+        }
+
+        return bytes;
+    } );
+
+    runner.Run( "parse_ui_message" + suffix, messages.size(), [&messages, format]() {
+        std::size_t bytes = 0;
+        for ( const auto& message : messages )
+        {
+            const auto parsedMsg = sn::parse_ui_message( message, format );
+            sn::bench::DoNotOptimize( parsedMsg.nodes.size() );
+            bytes += message.size();
+        }
+
+        return bytes;
+    } );
+
+    runner.Run( "build" + suffix, updates.size(), [&updates, format]() {
+        std::size_t bytes = 0;
+        for ( const auto& update : updates )
+        {
+            bytes += format == sn::WireFormat::Binary
+                         ? sn::EncodeMessage( update, format ).size()
+                         : sn::BuildUpdateMessage( update.node.id, update.node.io ).size();
+        }
+
+        return bytes;
+    } );
+
+    std::string buffer;
+    runner.Run( "write" + suffix, updates.size(), [&updates, &buffer, format]() {
+        std::size_t bytes = 0;
+        for ( const auto& update : updates )
+        {
+            buffer.clear();
+            sn::WriteUpdateMessage( buffer, update.node.id, update.node.io, format );
+            bytes += buffer.size();
+        }
+
+        return bytes;
+    } );
+}
+
+void RunFullStateBenchmarks(
+    sn::bench::BenchmarkRunner& runner,
+    sn::bench::WorkloadGenerator& generator,
+    const sn::WireFormat format )
+{
+    for ( const auto ioCount : fullStateIoCounts )
+    {
+        const auto nodes = generator.MakeNodes( ioCount, iosPerNode );
+        const auto message = sn::EncodeFullState( nodes, format );
+        const auto suffix =
+            "/full_state/" + std::to_string( ioCount ) + "_io/" + FormatName( format );
+
+        runner.Run( "build" + suffix, 1, [&nodes, format]() {
+            return sn::EncodeFullState( nodes, format ).size();
+        } );
+
+        std::string buffer;
+        runner.Run( "write" + suffix, 1, [&nodes, &buffer, format]() {
+            buffer.clear();
+            sn::WriteFullState( buffer, nodes, format );
+            return buffer.size();
+        } );
+
+        // What a burst of UIs reconnecting costs when no node has changed in between.
+        sn::NodeCache cache;
+        sn::FullStateCache fullState;
+        for ( const auto& node : nodes )
+        {
+            cache.Add( node );
+            fullState.NodeChanged( node.id );
+        }
+
+        runner.Run( "write_cached" + suffix, 1, [&cache, &fullState, &buffer, format]() {
+            buffer.clear();
+            fullState.Write( buffer, cache, format );
+            return buffer.size();
+        } );
+
+        runner.Run( "parse_ui_message" + suffix, 1, [&message, format]() {
+            const auto parsedMsg = sn::parse_ui_message( message, format );
+            sn::bench::DoNotOptimize( parsedMsg.nodes.size() );
+            return message.size();
+        } );
+    }
+}
+
+/*!
+    @brief Applies a burst of updates to a node cache, then finds what changed either by sweeping
+           the dirty bitsets or by walking every node, which is what a consumer had to do before.
+ */
+void RunNodeCacheBenchmarks(
+    sn::bench::BenchmarkRunner& runner,
+    sn::bench::WorkloadGenerator& generator )
+{
+    for ( const auto ioCount : nodeCacheIoCounts )
+    {
+        const auto nodes = generator.MakeNodes( ioCount, iosPerNode );
+        const auto updates = generator.MakeUpdateBurst( nodes, updatesPerBurst, maxIosPerUpdate );
+        const auto suffix = "/node_cache/" + std::to_string( ioCount ) + "_io";
+
+        sn::NodeCache cache;
+        cache.Assign( nodes );
+
+        // Each burst offsets the values differently, so that every update is a change.
+        int burst = 0;
+        const auto applyUpdates = [&cache, &updates, &burst]() {
+            ++burst;
+            for ( const auto& update : updates )
+            {
+                for ( const auto& io : update.io )
+                {
+                    cache.UpdateValue( update.id, io.id, io.value + burst );
+                }
+            }
+            return std::size_t{ 0 };
+        };
+
+        runner.Run( "update" + suffix, updates.size(), applyUpdates );
+
+        runner.Run( "update_and_sweep" + suffix, updates.size(), [&cache, &applyUpdates]() {
+            applyUpdates();
+            std::size_t changes = 0;
+            cache.SweepChanges( [&changes]( const sn::NodeId, const sn::IO& ) { ++changes; } );
+            sn::bench::DoNotOptimize( changes );
+            return std::size_t{ 0 };
+        } );
+
+        runner.Run( "update_and_walk" + suffix, updates.size(), [&cache, &applyUpdates]() {
+            applyUpdates();
+            std::size_t sum = 0;
+            cache.ForEachNode( [&sum]( const sn::NodeCache::NodeView& node ) {
+                for ( std::size_t index = 0; index < node.ioCount; ++index )
+                {
+                    sum += static_cast<std::size_t>( node.values[index] );
+                }
+            } );
+            sn::bench::DoNotOptimize( sum );
+            return std::size_t{ 0 };
+        } );
+    }
+}
+
+/*!
+    @brief Walks every field of a text message byte by byte, checking which are all digits, the
+           way the parser did before it used DelimiterScanner.
+ */
+std::size_t TokenizeBytewise( const std::string& message )
+{
+    std::size_t numericFields = 0;
+    bool allDigits = true;
+
+    for ( const char c : message )
+    {
+        if ( c == '_' || c == '\n' || c == '\r' )
+        {
+            if ( allDigits )
+            {
+                ++numericFields;
+            }
+
+            allDigits = true;
+        }
+        else if ( c < '0' || c > '9' )
+        {
+            allDigits = false;
+        }
+    }
+
+    return numericFields;
+}
+
+/*!
+    @brief Does the same work as TokenizeBytewise with a DelimiterScanner.
+ */
+std::size_t TokenizeWithScanner( const std::string& message )
+{
+    sn::DelimiterScanner scanner( message );
+    std::size_t numericFields = 0;
+
+    for ( std::size_t pos = 0; pos < message.size(); )
+    {
+        const auto end = scanner.FindFieldEnd( pos );
+        if ( scanner.SkipDigits( pos ) >= end )
+        {
+            ++numericFields;
+        }
+
+        pos = end + 1;
+    }
+
+    return numericFields;
+}
+
+void RunScanBenchmarks(
+    sn::bench::BenchmarkRunner& runner,
+    sn::bench::WorkloadGenerator& generator )
+{
+    const auto bestLevel = sn::ActiveScanLevel();
+
+    for ( const auto ioCount : scanIoCounts )
+    {
+        const auto message =
+            sn::EncodeFullState( generator.MakeNodes( ioCount, iosPerNode ), sn::WireFormat::Text );
+        const auto suffix = "/full_state/" + std::to_string( ioCount ) + "_io/text/";
+
+        runner.Run( "scan" + suffix + "bytewise", 1, [&message]() {
+            sn::bench::DoNotOptimize( TokenizeBytewise( message ) );
+            return message.size();
+        } );
+
+        for ( const auto level :
+              { sn::ScanLevel::Scalar, sn::ScanLevel::Sse2, sn::ScanLevel::Avx2 } )
+        {
+            if ( !sn::SetScanLevel( level ) )
+            {
+                continue;
+            }
+
+            const auto name = std::string( sn::to_string( level ) );
+
+            runner.Run( "scan" + suffix + name, 1, [&message]() {
+                sn::bench::DoNotOptimize( TokenizeWithScanner( message ) );
+                return message.size();
+            } );
+
+            runner.Run( "parse_ui_message" + suffix + name, 1, [&message]() {
+                const auto parsedMsg = sn::parse_ui_message( message );
+                sn::bench::DoNotOptimize( parsedMsg.nodes.size() );
+                return message.size();
+            } );
+        }
+    }
+
+    sn::SetScanLevel( bestLevel );
+}
+
+void RunMalformedBenchmarks( sn::bench::BenchmarkRunner& runner )
+{
+    // The kind of garbage a misbehaving node sends, rejected at various depths of the parser.
+    const std::vector<std::string> messages{
+        "<x_1>",
+        "<u_1_2_3_x>",
+        "<c_1_di_2>",
+        "<c_0_di_1_1>",
+        "<u_1_2_3_4_5_6_7_8_9_10_11_12_13_14>" };
+
+    runner.Run( "try_parse/malformed/text", messages.size(), [&messages]() {
+        std::size_t bytes = 0;
+        for ( const auto& message : messages )
+        {
+            const auto result = sn::try_parse( message, sn::PeerType::Node );
+            sn::bench::DoNotOptimize( result.HasValue() ? 0 : result.Failure().offset );
+            bytes += message.size();
+        }
+
+        return bytes;
+    } );
+
+    runner.Run( "parse/malformed/text", messages.size(), [&messages]() {
+        std::size_t bytes = 0;
+        for ( const auto& message : messages )
+        {
+            try
+            {
+                sn::bench::DoNotOptimize( sn::parse( message, sn::PeerType::Node ).node.io.size() );
+            }
+            catch ( const std::exception& e )
+            {
+                sn::bench::DoNotOptimize( static_cast<std::size_t>( e.what()[0] ) );
+            }
+
+            bytes += message.size();
+        }
+
+        return bytes;
+    } );
+}
+
+void PrintUsage()
+{
+    std::cout << "Usage: messaging_bench [--filter <text>] [--min-time <milliseconds>]\n"
+              << "  --filter    Only run benchmarks whose name contains the text.\n"
+              << "  --min-time  How long to repeat each benchmark for. Defaults to 200.\n";
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+    std::string filter;
+    long minTime = 200;
+
+    for ( int index = 1; index < argc; ++index )
+    {
+        const std::string arg( argv[index] );
+
+        if ( arg == "--filter" && index + 1 < argc )
+        {
+            filter = argv[++index];
+        }
+        else if ( arg == "--min-time" && index + 1 < argc )
+        {
+            minTime = std::strtol( argv[++index], nullptr, 10 );
+        }
+        else
+        {
+            PrintUsage();
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    sn::bench::BenchmarkRunner runner( std::chrono::milliseconds( minTime ), filter );
+
+    for ( const auto format : { sn::WireFormat::Text, sn::WireFormat::Binary } )
+    {
+        // Every format gets the same workload so that the results can be compared.
+        sn::bench::WorkloadGenerator generator;
+
+        RunNodeConnectBenchmarks( runner, generator, format );
+        RunUpdateBurstBenchmarks( runner, generator, format );
+        RunFullStateBenchmarks( runner, generator, format );
+    }
+
+    sn::bench::WorkloadGenerator generator;
+    RunScanBenchmarks( runner, generator );
+    RunMalformedBenchmarks( runner );
+    RunNodeCacheBenchmarks( runner, generator );
+
+    runner.PrintResults( std::cout );
+    return EXIT_SUCCESS;
+}
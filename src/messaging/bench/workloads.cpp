@@ -0,0 +1,89 @@
+#include "workloads.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace sn::bench
+{
+
+const std::array<IOType, 4> ioTypes{ IOType::DigitalInput,
+                                     IOType::DigitalOutput,
+                                     IOType::AnalogueInput,
+                                     IOType::AnalogueOutput };
+
+WorkloadGenerator::WorkloadGenerator( const std::uint32_t seed )
+    : m_random( seed )
+{}
+
+Node WorkloadGenerator::MakeNode( const NodeId id, const std::size_t ioCount )
+{
+    std::uniform_int_distribution<std::size_t> typeDistribution( 0, ioTypes.size() - 1 );
+
+    Node node( id );
+    node.io.reserve( ioCount );
+    for ( std::size_t index = 0; index < ioCount; ++index )
+    {
+        node.io.emplace_back(
+            static_cast<IOId>( index + 1 ), ioTypes[typeDistribution( m_random )], MakeValue() );
+    }
+
+    return node;
+}
+
+std::vector<Node> WorkloadGenerator::MakeNodes(
+    const std::size_t ioCount,
+    const std::size_t iosPerNode )
+{
+    std::vector<Node> nodes;
+    for ( std::size_t remaining = ioCount; remaining > 0; )
+    {
+        const auto nodeIoCount = std::min( remaining, iosPerNode );
+        nodes.push_back( MakeNode( static_cast<NodeId>( nodes.size() + 1 ), nodeIoCount ) );
+        remaining -= nodeIoCount;
+    }
+
+    return nodes;
+}
+
+std::vector<Node> WorkloadGenerator::MakeUpdateBurst(
+    const std::vector<Node>& nodes,
+    const std::size_t updateCount,
+    const std::size_t maxIosPerUpdate )
+{
+    std::uniform_int_distribution<std::size_t> nodeDistribution( 0, nodes.size() - 1 );
+
+    std::vector<Node> updates;
+    updates.reserve( updateCount );
+    for ( std::size_t update = 0; update < updateCount; ++update )
+    {
+        const auto& node = nodes[nodeDistribution( m_random )];
+        std::uniform_int_distribution<std::size_t> countDistribution(
+            1, std::min( maxIosPerUpdate, node.io.size() ) );
+        std::uniform_int_distribution<std::size_t> ioDistribution( 0, node.io.size() - 1 );
+
+        Node updated( node.id );
+        const auto ioCount = countDistribution( m_random );
+        for ( std::size_t index = 0; index < ioCount; ++index )
+        {
+            const auto& io = node.io[ioDistribution( m_random )];
+            updated.io.emplace_back( io.id, io.type, MakeValue() );
+        }
+
+        updates.push_back( std::move( updated ) );
+    }
+
+    return updates;
+}
+
+int WorkloadGenerator::MakeValue()
+{
+    // Mostly small values, as digital IOs only hold 0 or 1, with the occasional large analogue one.
+    // Values are never negative because the text FullState message cannot carry them.
+    std::uniform_int_distribution<int> smallDistribution( 0, 1 );
+    std::uniform_int_distribution<int> largeDistribution( 0, 100000 );
+    std::bernoulli_distribution isLarge( 0.25 );
+
+    return isLarge( m_random ) ? largeDistribution( m_random ) : smallDistribution( m_random );
+}
+
+} // namespace sn::bench
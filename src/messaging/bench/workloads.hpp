@@ -0,0 +1,48 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace sn::bench
+{
+
+/*!
+    @brief Generates reproducible nodes and IO values to benchmark against.
+ */
+class WorkloadGenerator final
+{
+public:
+    explicit WorkloadGenerator( const std::uint32_t seed = 1 );
+
+    /*!
+        @brief Generates a node with ioCount IOs of random types and values.
+     */
+    Node MakeNode( const NodeId id, const std::size_t ioCount );
+
+    /*!
+        @brief Generates the nodes of a FullState holding ioCount IOs in total, split across
+               nodes of up to iosPerNode IOs each.
+     */
+    std::vector<Node> MakeNodes( const std::size_t ioCount, const std::size_t iosPerNode );
+
+    /*!
+        @brief Generates a burst of updates to the provided nodes, each changing between one and
+               maxIosPerUpdate of a node's IOs.
+     */
+    std::vector<Node> MakeUpdateBurst(
+        const std::vector<Node>& nodes,
+        const std::size_t updateCount,
+        const std::size_t maxIosPerUpdate );
+
+private:
+    int MakeValue();
+
+private:
+    std::mt19937 m_random;
+};
+
+} // namespace sn::bench
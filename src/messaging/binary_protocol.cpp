@@ -0,0 +1,836 @@
+#include "binary_protocol.hpp"
+#include "decoder_table.hpp"
+#include "varint.hpp"
+
+#include <optional>
+#include <stdexcept>
+
+namespace sn
+{
+
+/*!
+    @brief Returns the type character used on the wire, which is the same for both protocols.
+ */
+char wire_type( const MessageType type )
+{
+    return type == MessageType::UiUpdate ? static_cast<char>( MessageType::NodeUpdate )
+                                         : static_cast<char>( type );
+}
+
+char encode_io_type( const IOType type )
+{
+    if ( type == IOType::Existing )
+    {
+        throw std::runtime_error( "IO type cannot be encoded in the binary protocol: Existing" );
+    }
+
+    return static_cast<char>( type );
+}
+
+std::size_t node_size( const NodeId id, const Span<const IO> ios, const bool withTypes )
+{
+    std::size_t size = VarintSize( static_cast<std::uint32_t>( id ) ) +
+                       VarintSize( static_cast<std::uint32_t>( ios.size() ) );
+
+    for ( const auto& io : ios )
+    {
+        size += ( withTypes ? 1 : 0 ) + VarintSize( static_cast<std::uint32_t>( io.id ) ) +
+                VarintSize( ZigZagEncode( io.value ) );
+    }
+
+    return size;
+}
+
+void put_node( std::string& out, const NodeId id, const Span<const IO> ios, const bool withTypes )
+{
+    PutVarint( out, static_cast<std::uint32_t>( id ) );
+    PutVarint( out, static_cast<std::uint32_t>( ios.size() ) );
+
+    for ( const auto& io : ios )
+    {
+        if ( withTypes )
+        {
+            out.push_back( encode_io_type( io.type ) );
+        }
+
+        PutVarint( out, static_cast<std::uint32_t>( io.id ) );
+        PutVarint( out, ZigZagEncode( io.value ) );
+    }
+}
+
+/*!
+    @brief Writes the length prefix and type of a message whose body, including the type, is
+           bodySize bytes. The buffer is grown to hold the whole message so that writing the rest
+           of the body does not reallocate.
+ */
+void put_header( std::string& out, const std::size_t bodySize, const MessageType type )
+{
+    const auto length = static_cast<std::uint32_t>( bodySize );
+    const auto required = out.size() + VarintSize( length ) + bodySize;
+
+    // Only grow, as reserve() may shrink a reused buffer before C++20.
+    if ( out.capacity() < required )
+    {
+        out.reserve( required );
+    }
+
+    PutVarint( out, length );
+    out.push_back( wire_type( type ) );
+}
+
+template<typename IdType>
+void put_id_message( std::string& out, const MessageType type, const IdType id )
+{
+    put_header( out, 1 + VarintSize( static_cast<std::uint32_t>( id ) ), type );
+    PutVarint( out, static_cast<std::uint32_t>( id ) );
+}
+
+void put_node_message(
+    std::string& out,
+    const MessageType type,
+    const NodeId id,
+    const Span<const IO> ios,
+    const bool withTypes )
+{
+    put_header( out, 1 + node_size( id, ios, withTypes ), type );
+    put_node( out, id, ios, withTypes );
+}
+
+void put_history_request( std::string& out, const NodeId id, const HistoryQuery& query )
+{
+    // The end of the window is only written if it is set, and the start only if either is.
+    const bool withUntil = query.until != 0;
+    const bool withSince = withUntil || query.since != 0;
+    const auto nodeId = static_cast<std::uint32_t>( id );
+    const auto ioId = static_cast<std::uint32_t>( query.io );
+
+    std::size_t bodySize =
+        1 + VarintSize( nodeId ) + VarintSize( ioId ) + VarintSize( query.maxSamples );
+    bodySize += withSince ? VarintSize64( query.since ) : 0;
+    bodySize += withUntil ? VarintSize64( query.until ) : 0;
+
+    put_header( out, bodySize, MessageType::HistoryRequest );
+    PutVarint( out, nodeId );
+    PutVarint( out, ioId );
+    PutVarint( out, query.maxSamples );
+
+    if ( withSince )
+    {
+        PutVarint64( out, query.since );
+    }
+
+    if ( withUntil )
+    {
+        PutVarint64( out, query.until );
+    }
+}
+
+void WriteBinary( std::string& out, const ParsedMessage& msg )
+{
+    switch ( msg.type )
+    {
+    case MessageType::Ack:
+    case MessageType::Nak:
+        if ( msg.node.id != invalid_node_id )
+        {
+            put_id_message( out, msg.type, msg.node.id );
+        }
+        else
+        {
+            put_id_message( out, msg.type, msg.ui.id );
+        }
+        break;
+
+    case MessageType::UiConnect:
+        if ( msg.sequence != 0 )
+        {
+            const auto id = static_cast<std::uint32_t>( msg.ui.id );
+            put_header( out, 1 + VarintSize( id ) + VarintSize64( msg.sequence ), msg.type );
+            PutVarint( out, id );
+            PutVarint64( out, msg.sequence );
+        }
+        else
+        {
+            put_id_message( out, msg.type, msg.ui.id );
+        }
+        break;
+
+    case MessageType::Sequence:
+        put_header( out, 1 + VarintSize64( msg.sequence ), msg.type );
+        PutVarint64( out, msg.sequence );
+        break;
+
+    case MessageType::HistoryRequest:
+        put_history_request( out, msg.node.id, msg.history );
+        break;
+
+    case MessageType::NodeDisconnect:
+    case MessageType::NodeStale:
+        put_id_message( out, msg.type, msg.node.id );
+        break;
+
+    case MessageType::NodeConnect:
+        put_node_message( out, msg.type, msg.node.id, msg.node.io, true );
+        break;
+
+    case MessageType::NodeUpdate:
+    case MessageType::UiUpdate:
+        put_node_message( out, msg.type, msg.node.id, msg.node.io, false );
+        break;
+
+    default:
+        throw std::runtime_error( "Message type cannot be encoded on its own." );
+    }
+}
+
+void WriteBinaryUpdate( std::string& out, const NodeId id, const Span<const IO> ios )
+{
+    put_node_message( out, MessageType::NodeUpdate, id, ios, false );
+}
+
+void WriteBinaryHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples )
+{
+    const auto sampleCount = static_cast<std::uint32_t>( samples.size() );
+    std::size_t bodySize = 1 + VarintSize( static_cast<std::uint32_t>( id ) ) +
+                           VarintSize( static_cast<std::uint32_t>( ioId ) ) +
+                           VarintSize( sampleCount );
+
+    // Each time is sent as the difference from the one before, which usually fits in a few bytes.
+    // A clock that steps backwards wraps around and still decodes to the right time.
+    Timestamp previous = 0;
+    for ( const auto& sample : samples )
+    {
+        bodySize += VarintSize64( sample.time - previous ) +
+                    VarintSize( ZigZagEncode( sample.value ) );
+        previous = sample.time;
+    }
+
+    put_header( out, bodySize, MessageType::History );
+    PutVarint( out, static_cast<std::uint32_t>( id ) );
+    PutVarint( out, static_cast<std::uint32_t>( ioId ) );
+    PutVarint( out, sampleCount );
+
+    previous = 0;
+    for ( const auto& sample : samples )
+    {
+        PutVarint64( out, sample.time - previous );
+        PutVarint( out, ZigZagEncode( sample.value ) );
+        previous = sample.time;
+    }
+}
+
+void WriteBinaryFullState( std::string& out, const Span<const Node> nodes )
+{
+    std::size_t bodySize = 1;
+    for ( const auto& node : nodes )
+    {
+        bodySize += node_size( node.id, node.io, true );
+    }
+
+    put_header( out, bodySize, MessageType::FullState );
+
+    for ( const auto& node : nodes )
+    {
+        put_node( out, node.id, node.io, true );
+    }
+}
+
+void WriteBinaryFullStateSegment( std::string& out, const NodeId id, const Span<const IO> ios )
+{
+    const auto required = out.size() + node_size( id, ios, true );
+    if ( out.capacity() < required )
+    {
+        out.reserve( required );
+    }
+
+    put_node( out, id, ios, true );
+}
+
+void WriteBinaryFullStateFromSegments(
+    std::string& out,
+    const Span<const std::string_view> segments )
+{
+    // A FullState body is only the nodes one after another, so the segments are copied as is.
+    std::size_t bodySize = 1;
+    for ( const auto& segment : segments )
+    {
+        bodySize += segment.size();
+    }
+
+    put_header( out, bodySize, MessageType::FullState );
+
+    for ( const auto& segment : segments )
+    {
+        out.append( segment );
+    }
+}
+
+std::string EncodeBinary( const ParsedMessage& msg )
+{
+    std::string out;
+    WriteBinary( out, msg );
+    return out;
+}
+
+std::string EncodeBinaryFullState( const Span<const Node> nodes )
+{
+    std::string out;
+    WriteBinaryFullState( out, nodes );
+    return out;
+}
+
+/*!
+    @brief Reads the fields of a binary message body.
+ */
+class BinaryReader
+{
+public:
+    /*!
+        @param[in] msg The complete message, which failures are reported relative to.
+        @param[in] bodyOffset The offset of the first byte after the length prefix.
+     */
+    BinaryReader( const std::string_view msg, const std::size_t bodyOffset )
+        : m_msg( msg )
+        , m_bodyOffset( bodyOffset )
+        , m_pos( bodyOffset )
+    {}
+
+    bool AtEnd() const
+    {
+        return m_pos == m_msg.size();
+    }
+
+    std::size_t Remaining() const
+    {
+        return m_msg.size() - m_pos;
+    }
+
+    ParseResult<std::uint8_t> ReadByte()
+    {
+        if ( AtEnd() )
+        {
+            return Fail( ParseError::UnexpectedEnd );
+        }
+
+        return static_cast<std::uint8_t>( m_msg[m_pos++] );
+    }
+
+    ParseResult<std::uint32_t> ReadVarint()
+    {
+        const auto value = GetVarint( m_msg, m_pos );
+        if ( !value )
+        {
+            return Fail( AtEnd() ? ParseError::UnexpectedEnd : ParseError::InvalidVarint );
+        }
+
+        return *value;
+    }
+
+    ParseResult<std::uint64_t> ReadVarint64()
+    {
+        const auto value = GetVarint64( m_msg, m_pos );
+        if ( !value )
+        {
+            return Fail( AtEnd() ? ParseError::UnexpectedEnd : ParseError::InvalidVarint );
+        }
+
+        return *value;
+    }
+
+    /*!
+        @brief Returns a failure located at the current position.
+     */
+    ParseFailure Fail( const ParseError error ) const
+    {
+        return { error, m_pos };
+    }
+
+    /*!
+        @brief Returns a failure located at the message type, the first byte of the body.
+     */
+    ParseFailure FailAtType( const ParseError error ) const
+    {
+        return { error, m_bodyOffset };
+    }
+
+private:
+    const std::string_view m_msg;
+    const std::size_t m_bodyOffset;
+    std::size_t m_pos;
+};
+
+/*!
+    @brief Checks the length prefix of a binary message and returns the offset of its body.
+ */
+ParseResult<std::size_t> read_binary_body( const std::string_view msg )
+{
+    std::size_t pos = 0;
+    const auto length = GetVarint( msg, pos );
+
+    if ( !length || *length == 0 || *length != msg.size() - pos )
+    {
+        return ParseFailure{ ParseError::InvalidLength, 0 };
+    }
+
+    return pos;
+}
+
+ParseResult<Node> read_node(
+    BinaryReader& reader,
+    const bool withTypes,
+    std::pmr::memory_resource* const resource )
+{
+    const auto nodeId = reader.ReadVarint();
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+
+    const auto ioCount = reader.ReadVarint();
+    if ( !ioCount )
+    {
+        return ioCount.Failure();
+    }
+    else if ( ioCount.Value() > reader.Remaining() / 2 )
+    {
+        // Every IO takes at least two bytes, so don't trust a count that the message cannot hold.
+        return reader.Fail( ParseError::InvalidIoCount );
+    }
+
+    Node node( static_cast<NodeId>( nodeId.Value() ), resource );
+    node.io.reserve( ioCount.Value() );
+
+    for ( std::uint32_t index = 0; index < ioCount.Value(); ++index )
+    {
+        auto type = IOType::Existing;
+        if ( withTypes )
+        {
+            const auto ioType = reader.ReadByte();
+            if ( !ioType )
+            {
+                return ioType.Failure();
+            }
+            else if ( ioType.Value() >= static_cast<std::uint8_t>( IOType::Existing ) )
+            {
+                return reader.Fail( ParseError::InvalidIoType );
+            }
+
+            type = static_cast<IOType>( ioType.Value() );
+        }
+
+        const auto ioId = reader.ReadVarint();
+        if ( !ioId )
+        {
+            return ioId.Failure();
+        }
+
+        const auto value = reader.ReadVarint();
+        if ( !value )
+        {
+            return value.Failure();
+        }
+
+        node.io.emplace_back(
+            static_cast<IOId>( ioId.Value() ), type, ZigZagDecode( value.Value() ) );
+    }
+
+    return node;
+}
+
+ParseResult<Node> read_connected_node(
+    BinaryReader& reader,
+    const bool withTypes,
+    std::pmr::memory_resource* const resource )
+{
+    const auto invalidNodeId = reader.Fail( ParseError::InvalidNodeId );
+    auto node = read_node( reader, withTypes, resource );
+
+    if ( node && node.Value().id == invalid_node_id )
+    {
+        return invalidNodeId;
+    }
+
+    return node;
+}
+
+std::optional<ParseFailure> expect_end( const BinaryReader& reader )
+{
+    if ( !reader.AtEnd() )
+    {
+        return reader.Fail( ParseError::TrailingBytes );
+    }
+
+    return std::nullopt;
+}
+
+/*!
+    @brief Reads a connected node that must make up the rest of the message.
+ */
+ParseResult<Node> read_last_node(
+    BinaryReader& reader,
+    const bool withTypes,
+    std::pmr::memory_resource* const resource )
+{
+    auto node = read_connected_node( reader, withTypes, resource );
+    if ( !node )
+    {
+        return node;
+    }
+    else if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    return node;
+}
+
+ParseResult<ParsedMessage> read_id_message( BinaryReader& reader, const MessageType msgType )
+{
+    const auto id = reader.ReadVarint();
+    if ( !id )
+    {
+        return id.Failure();
+    }
+    else if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    ParsedMessage parsedMsg( msgType );
+    parsedMsg.node.id = static_cast<NodeId>( id.Value() );
+    return parsedMsg;
+}
+
+template<MessageType msgType>
+ParseResult<ParsedMessage> decode_ack( BinaryReader& reader, std::pmr::memory_resource* )
+{
+    return read_id_message( reader, msgType );
+}
+
+template<MessageType msgType>
+ParseResult<ParsedMessage> decode_node_message(
+    BinaryReader& reader,
+    std::pmr::memory_resource* const resource )
+{
+    auto node = read_last_node( reader, msgType == MessageType::NodeConnect, resource );
+    if ( !node )
+    {
+        return node.Failure();
+    }
+
+    ParsedMessage parsedMsg( msgType, resource );
+    parsedMsg.node = std::move( node.Value() );
+    return parsedMsg;
+}
+
+ParseResult<ParsedMessage> decode_ui_connect( BinaryReader& reader, std::pmr::memory_resource* )
+{
+    const auto idOffset = reader.Fail( ParseError::InvalidUiId );
+    const auto id = reader.ReadVarint();
+    if ( !id )
+    {
+        return id.Failure();
+    }
+
+    ParsedMessage parsedMsg( MessageType::UiConnect );
+    parsedMsg.ui.id = static_cast<UIId>( id.Value() );
+
+    // A UI that has been connected before may follow its ID with the last change it applied.
+    if ( !reader.AtEnd() )
+    {
+        const auto sequence = reader.ReadVarint64();
+        if ( !sequence )
+        {
+            return sequence.Failure();
+        }
+
+        parsedMsg.sequence = sequence.Value();
+    }
+
+    if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+    else if ( parsedMsg.ui.id == invalid_ui_id )
+    {
+        return idOffset;
+    }
+
+    return parsedMsg;
+}
+
+ParseResult<ParsedMessage> decode_history_request(
+    BinaryReader& reader,
+    std::pmr::memory_resource* )
+{
+    const auto invalidNodeId = reader.Fail( ParseError::InvalidNodeId );
+    const auto nodeId = reader.ReadVarint();
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+    else if ( static_cast<NodeId>( nodeId.Value() ) == invalid_node_id )
+    {
+        return invalidNodeId;
+    }
+
+    const auto ioId = reader.ReadVarint();
+    if ( !ioId )
+    {
+        return ioId.Failure();
+    }
+
+    const auto maxSamples = reader.ReadVarint();
+    if ( !maxSamples )
+    {
+        return maxSamples.Failure();
+    }
+
+    ParsedMessage parsedMsg( MessageType::HistoryRequest );
+    parsedMsg.node.id = static_cast<NodeId>( nodeId.Value() );
+    parsedMsg.history.io = static_cast<IOId>( ioId.Value() );
+    parsedMsg.history.maxSamples = maxSamples.Value();
+
+    // The time window is optional, and its end may be left out to mean the present.
+    for ( auto* const time : { &parsedMsg.history.since, &parsedMsg.history.until } )
+    {
+        if ( !reader.AtEnd() )
+        {
+            const auto value = reader.ReadVarint64();
+            if ( !value )
+            {
+                return value.Failure();
+            }
+
+            *time = value.Value();
+        }
+    }
+
+    if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    return parsedMsg;
+}
+
+ParseResult<ParsedMessage> reject_unhandled( BinaryReader& reader, std::pmr::memory_resource* )
+{
+    return reader.FailAtType( ParseError::UnhandledMessageType );
+}
+
+using BinaryDecoder =
+    ParseResult<ParsedMessage> ( * )( BinaryReader&, std::pmr::memory_resource* );
+
+// The decoders for the binary messages the server receives.
+constexpr DecoderEntry<BinaryDecoder> binaryDecoderEntries[] = {
+    { 'a', &decode_ack<MessageType::Ack> },
+    { 'n', &decode_ack<MessageType::Nak> },
+    { 'c', &decode_node_message<MessageType::NodeConnect> },
+    { 'u', PeerType::Node, &decode_node_message<MessageType::NodeUpdate> },
+    { 'u', PeerType::UI, &decode_node_message<MessageType::UiUpdate> },
+    { 'g', &decode_ui_connect },
+    { 'h', PeerType::UI, &decode_history_request },
+    { 'h', PeerType::Node, &reject_unhandled },
+    { 's', &reject_unhandled },
+    { 'd', &reject_unhandled },
+    { 'q', &reject_unhandled },
+    { 'y', &reject_unhandled },
+    { 'o', &reject_unhandled } };
+
+constexpr DecoderTable<BinaryDecoder> binaryDecoders( binaryDecoderEntries );
+
+ParseResult<ParsedMessage> try_parse_binary(
+    const std::string_view msg,
+    const PeerType peerType,
+    std::pmr::memory_resource* const resource )
+{
+    const auto bodyOffset = read_binary_body( msg );
+    if ( !bodyOffset )
+    {
+        return bodyOffset.Failure();
+    }
+
+    BinaryReader reader( msg, bodyOffset.Value() );
+    const auto typeByte = reader.ReadByte();
+    if ( !typeByte )
+    {
+        return typeByte.Failure();
+    }
+
+    const auto decoder = binaryDecoders.Find( static_cast<char>( typeByte.Value() ), peerType );
+    if ( decoder == nullptr )
+    {
+        return reader.FailAtType( ParseError::InvalidMessageType );
+    }
+
+    return decoder( reader, resource );
+}
+
+ParseResult<ParsedUiMessage> decode_full_state( BinaryReader& reader )
+{
+    ParsedUiMessage parsedMsg{ MessageType::FullState, {} };
+    while ( !reader.AtEnd() )
+    {
+        auto node = read_node( reader, true, std::pmr::get_default_resource() );
+        if ( !node )
+        {
+            return node.Failure();
+        }
+
+        parsedMsg.nodes.push_back( std::move( node.Value() ) );
+    }
+
+    return parsedMsg;
+}
+
+template<MessageType msgType>
+ParseResult<ParsedUiMessage> decode_node_id_message( BinaryReader& reader )
+{
+    const auto id = reader.ReadVarint();
+    if ( !id )
+    {
+        return id.Failure();
+    }
+    else if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    const auto nodeId = static_cast<NodeId>( id.Value() );
+    return ParsedUiMessage{ msgType, { Node( nodeId ) } };
+}
+
+template<MessageType msgType>
+ParseResult<ParsedUiMessage> decode_node_message_for_ui( BinaryReader& reader )
+{
+    auto node = read_last_node(
+        reader,
+        msgType == MessageType::NodeConnect,
+        std::pmr::get_default_resource() );
+    if ( !node )
+    {
+        return node.Failure();
+    }
+
+    return ParsedUiMessage{ msgType, { std::move( node.Value() ) } };
+}
+
+ParseResult<ParsedUiMessage> decode_sequence( BinaryReader& reader )
+{
+    const auto sequence = reader.ReadVarint64();
+    if ( !sequence )
+    {
+        return sequence.Failure();
+    }
+    else if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    ParsedUiMessage parsedMsg{ MessageType::Sequence, {} };
+    parsedMsg.sequence = sequence.Value();
+    return parsedMsg;
+}
+
+ParseResult<ParsedUiMessage> decode_history( BinaryReader& reader )
+{
+    const auto nodeId = reader.ReadVarint();
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+
+    const auto ioId = reader.ReadVarint();
+    if ( !ioId )
+    {
+        return ioId.Failure();
+    }
+
+    const auto sampleCount = reader.ReadVarint();
+    if ( !sampleCount )
+    {
+        return sampleCount.Failure();
+    }
+    else if ( sampleCount.Value() > reader.Remaining() / 2 )
+    {
+        // Every sample takes at least two bytes, so don't trust a count the message cannot hold.
+        return reader.Fail( ParseError::InvalidSegmentCount );
+    }
+
+    ParsedUiMessage parsedMsg{ MessageType::History,
+                               { Node( static_cast<NodeId>( nodeId.Value() ) ) } };
+    parsedMsg.historyIO = static_cast<IOId>( ioId.Value() );
+    parsedMsg.history.reserve( sampleCount.Value() );
+
+    Timestamp time = 0;
+    for ( std::uint32_t index = 0; index < sampleCount.Value(); ++index )
+    {
+        const auto delta = reader.ReadVarint64();
+        if ( !delta )
+        {
+            return delta.Failure();
+        }
+
+        const auto value = reader.ReadVarint();
+        if ( !value )
+        {
+            return value.Failure();
+        }
+
+        time += delta.Value();
+        parsedMsg.history.push_back( HistorySample{ time, ZigZagDecode( value.Value() ) } );
+    }
+
+    if ( const auto failure = expect_end( reader ) )
+    {
+        return *failure;
+    }
+
+    return parsedMsg;
+}
+
+using BinaryUiDecoder = ParseResult<ParsedUiMessage> ( * )( BinaryReader& );
+
+// The decoders for the binary messages the server sends to UIs.
+constexpr DecoderEntry<BinaryUiDecoder> binaryUiDecoderEntries[] = {
+    { 's', &decode_full_state },
+    { 'd', &decode_node_id_message<MessageType::NodeDisconnect> },
+    { 'o', &decode_node_id_message<MessageType::NodeStale> },
+    { 'c', &decode_node_message_for_ui<MessageType::NodeConnect> },
+    { 'u', &decode_node_message_for_ui<MessageType::NodeUpdate> },
+    { 'q', &decode_sequence },
+    { 'y', &decode_history } };
+
+constexpr DecoderTable<BinaryUiDecoder> binaryUiDecoders( binaryUiDecoderEntries );
+
+ParseResult<ParsedUiMessage> try_parse_binary_ui_message( const std::string_view msg )
+{
+    const auto bodyOffset = read_binary_body( msg );
+    if ( !bodyOffset )
+    {
+        return bodyOffset.Failure();
+    }
+
+    BinaryReader reader( msg, bodyOffset.Value() );
+    const auto typeByte = reader.ReadByte();
+    if ( !typeByte )
+    {
+        return typeByte.Failure();
+    }
+
+    const auto decoder =
+        binaryUiDecoders.Find( static_cast<char>( typeByte.Value() ), PeerType::Node );
+    if ( decoder == nullptr )
+    {
+        return reader.FailAtType( ParseError::UnhandledMessageType );
+    }
+
+    return decoder( reader );
+}
+
+} // namespace sn
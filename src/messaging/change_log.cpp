@@ -0,0 +1,56 @@
+#include "change_log.hpp"
+#include "message_builder.hpp"
+
+namespace sn
+{
+
+ChangeLog::ChangeLog( const std::size_t capacity, const SequenceNumber lastSequence )
+    : m_changes( capacity, ParsedMessage( MessageType::NodeUpdate ) )
+    , m_size( 0 )
+    , m_next( 0 )
+    , m_lastSequence( lastSequence )
+{}
+
+SequenceNumber ChangeLog::Record( const ParsedMessage& message )
+{
+    auto& change = m_changes[m_next];
+    change.type = message.type;
+    change.node.id = message.node.id;
+    change.node.io.assign( message.node.io.begin(), message.node.io.end() );
+
+    m_next = ( m_next + 1 ) % m_changes.size();
+    if ( m_size < m_changes.size() )
+    {
+        ++m_size;
+    }
+
+    return ++m_lastSequence;
+}
+
+SequenceNumber ChangeLog::LastSequence() const
+{
+    return m_lastSequence;
+}
+
+bool ChangeLog::Covers( const SequenceNumber sequence ) const
+{
+    return sequence <= m_lastSequence && m_lastSequence - sequence <= m_size;
+}
+
+void ChangeLog::WriteSince(
+    std::string& out,
+    const SequenceNumber sequence,
+    const WireFormat format ) const
+{
+    // Covers() guarantees the difference is no larger than the log.
+    const std::size_t missed = m_lastSequence - sequence;
+    auto index = ( m_next + m_changes.size() - missed ) % m_changes.size();
+
+    for ( std::size_t count = 0; count < missed; ++count )
+    {
+        WriteMessage( out, m_changes[index], format );
+        index = ( index + 1 ) % m_changes.size();
+    }
+}
+
+} // namespace sn
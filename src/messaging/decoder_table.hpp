@@ -0,0 +1,86 @@
+#pragma once
+
+#include "data_types.hpp"
+
+#include <array>
+#include <cstddef>
+
+namespace sn
+{
+
+/*!
+    @brief Registers the decoder for one message type character, either for one type of peer or
+           for both.
+ */
+template<typename Decoder>
+struct DecoderEntry
+{
+    constexpr DecoderEntry( const char entryTypeChar, const Decoder entryDecoder )
+        : typeChar( entryTypeChar )
+        , anyPeer( true )
+        , peerType( PeerType::Node )
+        , decoder( entryDecoder )
+    {}
+
+    constexpr DecoderEntry(
+        const char entryTypeChar,
+        const PeerType entryPeerType,
+        const Decoder entryDecoder )
+        : typeChar( entryTypeChar )
+        , anyPeer( false )
+        , peerType( entryPeerType )
+        , decoder( entryDecoder )
+    {}
+
+    char typeChar;
+    bool anyPeer;
+    PeerType peerType;
+    Decoder decoder;
+};
+
+/*!
+    @brief Maps a message type character and the type of peer that sent it straight to a decoder.
+           The table is built at compile time from a list of entries, so looking up a decoder is a
+           single index into an array and adding a message type only takes another entry.
+ */
+template<typename Decoder>
+class DecoderTable final
+{
+public:
+    template<std::size_t N>
+    constexpr DecoderTable( const DecoderEntry<Decoder> ( &entries )[N] )
+        : m_decoders{}
+    {
+        for ( const auto& entry : entries )
+        {
+            for ( const auto peerType : { PeerType::Node, PeerType::UI } )
+            {
+                if ( entry.anyPeer || entry.peerType == peerType )
+                {
+                    m_decoders[Index( entry.typeChar, peerType )] = entry.decoder;
+                }
+            }
+        }
+    }
+
+    /*!
+        @brief Returns the decoder registered for the message type, or nullptr if there is none.
+     */
+    constexpr Decoder Find( const char typeChar, const PeerType peerType ) const
+    {
+        return m_decoders[Index( typeChar, peerType )];
+    }
+
+private:
+    static constexpr std::size_t typeCharCount = 256;
+
+    static constexpr std::size_t Index( const char typeChar, const PeerType peerType )
+    {
+        return static_cast<std::size_t>( peerType ) * typeCharCount +
+               static_cast<unsigned char>( typeChar );
+    }
+
+    std::array<Decoder, 2 * typeCharCount> m_decoders;
+};
+
+} // namespace sn
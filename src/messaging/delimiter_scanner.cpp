@@ -0,0 +1,266 @@
+#include "delimiter_scanner.hpp"
+
+#include <algorithm>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define SN_SCAN_X86_64 1
+#include <immintrin.h>
+#endif
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define SN_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#else
+#define SN_TARGET_AVX2
+#endif
+
+namespace sn
+{
+
+using BlockMasks = DelimiterScanner::BlockMasks;
+using ComputeMasks = BlockMasks ( * )( const char* block );
+
+constexpr std::size_t blockSize = DelimiterScanner::blockSize;
+
+BlockMasks ComputeMasksScalar( const char* block )
+{
+    BlockMasks masks{ 0, 0 };
+    for ( std::size_t index = 0; index < blockSize; ++index )
+    {
+        const char c = block[index];
+        const std::uint64_t bit = std::uint64_t{ 1 } << index;
+
+        if ( c == '_' || c == '\n' || c == '\r' )
+        {
+            masks.fieldEnds |= bit;
+        }
+
+        if ( c >= '0' && c <= '9' )
+        {
+            masks.digits |= bit;
+        }
+    }
+
+    return masks;
+}
+
+#ifdef SN_SCAN_X86_64
+
+/*!
+    @brief Widens a movemask result to 64 bits without sign extension.
+ */
+std::uint64_t Lanes( const int movemask )
+{
+    return static_cast<std::uint32_t>( movemask );
+}
+
+// SSE2 is part of x86-64, so this needs no runtime check. Bytes are compared as signed values,
+// which is safe for the digit range because bytes above 0x7f compare as negative.
+BlockMasks ComputeMasksSse2( const char* block )
+{
+    const __m128i underscore = _mm_set1_epi8( '_' );
+    const __m128i lineFeed = _mm_set1_epi8( '\n' );
+    const __m128i carriageReturn = _mm_set1_epi8( '\r' );
+    const __m128i belowZero = _mm_set1_epi8( '0' - 1 );
+    const __m128i aboveNine = _mm_set1_epi8( '9' + 1 );
+
+    BlockMasks masks{ 0, 0 };
+    for ( std::size_t offset = 0; offset < blockSize; offset += 16 )
+    {
+        const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( block + offset ) );
+        const __m128i fieldEnds = _mm_or_si128(
+            _mm_cmpeq_epi8( bytes, underscore ),
+            _mm_or_si128(
+                _mm_cmpeq_epi8( bytes, lineFeed ),
+                _mm_cmpeq_epi8( bytes, carriageReturn ) ) );
+        const __m128i digits =
+            _mm_and_si128( _mm_cmpgt_epi8( bytes, belowZero ), _mm_cmpgt_epi8( aboveNine, bytes ) );
+
+        masks.fieldEnds |= Lanes( _mm_movemask_epi8( fieldEnds ) ) << offset;
+        masks.digits |= Lanes( _mm_movemask_epi8( digits ) ) << offset;
+    }
+
+    return masks;
+}
+
+SN_TARGET_AVX2 BlockMasks ComputeMasksAvx2( const char* block )
+{
+    const __m256i underscore = _mm256_set1_epi8( '_' );
+    const __m256i lineFeed = _mm256_set1_epi8( '\n' );
+    const __m256i carriageReturn = _mm256_set1_epi8( '\r' );
+    const __m256i belowZero = _mm256_set1_epi8( '0' - 1 );
+    const __m256i aboveNine = _mm256_set1_epi8( '9' + 1 );
+
+    BlockMasks masks{ 0, 0 };
+    for ( std::size_t offset = 0; offset < blockSize; offset += 32 )
+    {
+        const __m256i bytes =
+            _mm256_loadu_si256( reinterpret_cast<const __m256i*>( block + offset ) );
+        const __m256i fieldEnds = _mm256_or_si256(
+            _mm256_cmpeq_epi8( bytes, underscore ),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8( bytes, lineFeed ),
+                _mm256_cmpeq_epi8( bytes, carriageReturn ) ) );
+        const __m256i digits = _mm256_and_si256(
+            _mm256_cmpgt_epi8( bytes, belowZero ),
+            _mm256_cmpgt_epi8( aboveNine, bytes ) );
+
+        masks.fieldEnds |= Lanes( _mm256_movemask_epi8( fieldEnds ) ) << offset;
+        masks.digits |= Lanes( _mm256_movemask_epi8( digits ) ) << offset;
+    }
+
+    return masks;
+}
+
+bool CpuSupportsAvx2()
+{
+#if defined( _MSC_VER ) && !defined( __clang__ )
+    int registers[4];
+    __cpuid( registers, 1 );
+    const bool osSavesAvxState = ( registers[2] & ( 1 << 27 ) ) != 0;
+    if ( !osSavesAvxState || ( _xgetbv( 0 ) & 0x6 ) != 0x6 )
+    {
+        return false;
+    }
+
+    __cpuidex( registers, 7, 0 );
+    return ( registers[1] & ( 1 << 5 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+#endif
+
+bool IsSupported( const ScanLevel level )
+{
+    switch ( level )
+    {
+    case ScanLevel::Scalar:
+        return true;
+#ifdef SN_SCAN_X86_64
+    case ScanLevel::Sse2:
+        return true;
+    case ScanLevel::Avx2:
+        return CpuSupportsAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+ComputeMasks ComputeMasksFor( const ScanLevel level )
+{
+    switch ( level )
+    {
+#ifdef SN_SCAN_X86_64
+    case ScanLevel::Sse2:
+        return &ComputeMasksSse2;
+    case ScanLevel::Avx2:
+        return &ComputeMasksAvx2;
+#endif
+    default:
+        return &ComputeMasksScalar;
+    }
+}
+
+ScanLevel BestScanLevel()
+{
+    if ( IsSupported( ScanLevel::Avx2 ) )
+    {
+        return ScanLevel::Avx2;
+    }
+    else if ( IsSupported( ScanLevel::Sse2 ) )
+    {
+        return ScanLevel::Sse2;
+    }
+
+    return ScanLevel::Scalar;
+}
+
+ScanLevel activeScanLevel = BestScanLevel();
+ComputeMasks computeMasks = ComputeMasksFor( activeScanLevel );
+
+std::string_view to_string( const ScanLevel level )
+{
+    switch ( level )
+    {
+    case ScanLevel::Scalar:
+        return "scalar";
+    case ScanLevel::Sse2:
+        return "sse2";
+    case ScanLevel::Avx2:
+        return "avx2";
+    }
+
+    return "unknown";
+}
+
+ScanLevel ActiveScanLevel()
+{
+    return activeScanLevel;
+}
+
+bool SetScanLevel( const ScanLevel level )
+{
+    if ( !IsSupported( level ) )
+    {
+        return false;
+    }
+
+    activeScanLevel = level;
+    computeMasks = ComputeMasksFor( level );
+    return true;
+}
+
+DelimiterScanner::DelimiterScanner( const std::string_view text )
+    : m_text( text )
+    , m_block( static_cast<std::size_t>( -1 ) )
+    , m_masks{ 0, 0 }
+{}
+
+std::size_t DelimiterScanner::FindFirstInLaterBlocks(
+    std::size_t pos,
+    std::uint64_t ( *maskOf )( const BlockMasks& ) )
+{
+    while ( pos < m_text.size() )
+    {
+        const std::size_t block = pos / blockSize;
+        if ( block != m_block )
+        {
+            LoadBlock( block );
+        }
+
+        // The padding after the end of the text is a non-digit, so neither mask can find a bit
+        // past the end of the text.
+        const std::uint64_t mask = maskOf( m_masks ) >> ( pos % blockSize );
+        if ( mask != 0 )
+        {
+            return pos + LowestSetBit( mask );
+        }
+
+        pos = ( block + 1 ) * blockSize;
+    }
+
+    return m_text.size();
+}
+
+void DelimiterScanner::LoadBlock( const std::size_t block )
+{
+    const std::size_t offset = block * blockSize;
+    if ( m_text.size() - offset >= blockSize )
+    {
+        m_masks = computeMasks( m_text.data() + offset );
+    }
+    else
+    {
+        // The final block is copied so that the vector loads cannot read past the end of the
+        // text. Zero bytes are neither field ends nor digits.
+        char padded[blockSize] = {};
+        std::copy( m_text.begin() + static_cast<std::ptrdiff_t>( offset ), m_text.end(), padded );
+        m_masks = computeMasks( padded );
+    }
+
+    m_block = block;
+}
+
+} // namespace sn
@@ -0,0 +1,86 @@
+#include "message_framer.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+/*!
+    @brief Appends each chunk in turn and returns every message the framer completes.
+ */
+std::vector<std::string> Frame( sn::MessageFramer& framer, const std::vector<std::string>& chunks )
+{
+    std::vector<std::string> messages;
+    for ( const auto& chunk : chunks )
+    {
+        framer.Append( chunk );
+        while ( const auto message = framer.Next() )
+        {
+            messages.emplace_back( *message );
+        }
+    }
+
+    return messages;
+}
+
+/*!
+    @brief Frames the chunks and checks the messages and the number of bytes discarded.
+    @returns False, having printed what differed, if either is not as expected.
+ */
+bool Check(
+    const std::string& name,
+    const std::vector<std::string>& chunks,
+    const std::vector<std::string>& expectedMessages,
+    const std::size_t expectedDiscarded )
+{
+    sn::MessageFramer framer;
+    const auto messages = Frame( framer, chunks );
+
+    if ( messages == expectedMessages && framer.DiscardedBytes() == expectedDiscarded )
+    {
+        return true;
+    }
+
+    std::cout << name << " failed. Messages:";
+    for ( const auto& message : messages )
+    {
+        std::cout << ' ' << message;
+    }
+
+    std::cout << "\n  expected:";
+    for ( const auto& message : expectedMessages )
+    {
+        std::cout << ' ' << message;
+    }
+
+    std::cout << "\n  discarded " << framer.DiscardedBytes() << " byte(s), expected "
+              << expectedDiscarded << '\n';
+    return false;
+}
+
+} // namespace
+
+int main()
+{
+    // A message cut short must not merge with the next, which the parser would otherwise take as
+    // an update of IO 7.
+    const bool passed =
+        Check( "Split message", { "<u_1_", "2_3>" }, { "<u_1_2_3>" }, 0 ) &
+        Check( "Several messages", { "<a_1><u_1_2_3>" }, { "<a_1>", "<u_1_2_3>" }, 0 ) &
+        Check( "Truncated message", { "<u_1_7", "<u_1_2_3>" }, { "<u_1_2_3>" }, 6 ) &
+        Check( "Truncated messages", { "<u_1_7<u_1<u_1_2_3>" }, { "<u_1_2_3>" }, 10 ) &
+        Check( "Bytes outside messages", { "garbage", "<a_1>xy" }, { "<a_1>" }, 9 );
+
+    if ( !passed )
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "The framer split every stream as expected.\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#include "full_state_cache.hpp"
+#include "message_builder.hpp"
+
+namespace sn
+{
+
+void FullStateCache::NodeChanged( const NodeId id )
+{
+    const auto segment = m_segments.find( id );
+    if ( segment != m_segments.end() )
+    {
+        segment->second.current.fill( false );
+    }
+}
+
+void FullStateCache::NodeRemoved( const NodeId id )
+{
+    m_segments.erase( id );
+}
+
+void FullStateCache::Clear()
+{
+    m_segments.clear();
+}
+
+void FullStateCache::Write( std::string& out, const NodeCache& nodes, const WireFormat format )
+{
+    const auto formatIndex = static_cast<std::size_t>( format );
+    m_gather.clear();
+
+    nodes.ForEachNode( [this, formatIndex, format]( const NodeCache::NodeView& node ) {
+        auto& segment = m_segments[node.id];
+        auto& encoded = segment.encoded[formatIndex];
+
+        if ( !segment.current[formatIndex] )
+        {
+            m_ios.clear();
+            for ( std::size_t index = 0; index < node.ioCount; ++index )
+            {
+                m_ios.push_back( node.IOAt( index ) );
+            }
+
+            encoded.clear();
+            WriteFullStateSegment( encoded, node.id, m_ios, format );
+            segment.current[formatIndex] = true;
+        }
+
+        m_gather.emplace_back( encoded );
+    } );
+
+    WriteFullStateFromSegments( out, m_gather, format );
+}
+
+} // namespace sn
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "messages.hpp"
+#include "parse_result.hpp"
+#include "span.hpp"
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The binary protocol carries the same messages as the text protocol. Every message is
+//
+//     <length> <type> <fields...>
+//
+// where length is the number of bytes that follow it and type is the same character the text
+// protocol uses. IDs and counts are unsigned LEB128 varints, IO values are zig-zag encoded varints
+// and IO types are a single byte holding an IOType. Sequence numbers and timestamps are varints of
+// up to 64 bits. The fields of each message type are:
+//
+//     Ack, Nak, NodeDisconnect, NodeStale:  <id>
+//     UiConnect:                            <ui id> [<sequence>]
+//     Sequence:                             <sequence>
+//     NodeConnect:                          <node id> <io count> (<io type> <io id> <value>)*
+//     NodeUpdate, UiUpdate:                 <node id> <io count> (<io id> <value>)*
+//     FullState:                            (<node id> <io count> (<io type> <io id> <value>)*)*
+//     HistoryRequest:                       <node id> <io id> <max samples> [<since> [<until>]]
+//     History:                              <node id> <io id> <sample count> (<time> <value>)*
+//
+// The time of each sample in a History is the difference from the time of the sample before it.
+
+namespace sn
+{
+
+/*!
+    @brief The WebSocket subprotocol a client offers during the handshake to use the binary
+           protocol. Clients that do not offer it use the text protocol.
+ */
+constexpr std::string_view binarySubprotocol = "smartnode.binary.v1";
+
+/*!
+    @brief Encodes a single message in the binary protocol.
+    @throws std::runtime_error if the message is a FullState or holds an IO type that has no
+            binary representation.
+ */
+std::string EncodeBinary( const ParsedMessage& msg );
+
+/*!
+    @brief Encodes a FullState message holding the provided nodes in the binary protocol.
+ */
+std::string EncodeBinaryFullState( const Span<const Node> nodes );
+
+/*!
+    @brief Appends the binary encoding of a message to the buffer, growing it at most once.
+    @throws std::runtime_error under the same conditions as EncodeBinary().
+ */
+void WriteBinary( std::string& out, const ParsedMessage& msg );
+
+/*!
+    @brief Appends a binary update message for the provided IOs to the buffer.
+ */
+void WriteBinaryUpdate( std::string& out, const NodeId id, const Span<const IO> ios );
+
+/*!
+    @brief Appends a binary History message holding the provided samples of an IO to the buffer.
+ */
+void WriteBinaryHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples );
+
+/*!
+    @brief Appends a binary FullState message holding the provided nodes to the buffer.
+ */
+void WriteBinaryFullState( std::string& out, const Span<const Node> nodes );
+
+/*!
+    @brief Appends the binary encoding of one node of a FullState message to the buffer.
+ */
+void WriteBinaryFullStateSegment( std::string& out, const NodeId id, const Span<const IO> ios );
+
+/*!
+    @brief Appends a binary FullState message made up of segments written by
+           WriteBinaryFullStateSegment() to the buffer.
+ */
+void WriteBinaryFullStateFromSegments(
+    std::string& out,
+    const Span<const std::string_view> segments );
+
+/*!
+    @brief Decodes a binary message received by the server. The binary equivalent of try_parse().
+ */
+ParseResult<ParsedMessage> try_parse_binary(
+    const std::string_view msg,
+    const PeerType peerType,
+    std::pmr::memory_resource* const resource = std::pmr::get_default_resource() );
+
+/*!
+    @brief Decodes a binary message received by a UI. The binary equivalent of
+           try_parse_ui_message().
+ */
+ParseResult<ParsedUiMessage> try_parse_binary_ui_message( const std::string_view msg );
+
+} // namespace sn
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "messages.hpp"
+#include "span.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief Stamps every change to the state of the nodes that is forwarded to UIs with the next
+           sequence number, and keeps the latest changes so that a UI that reconnects can be sent
+           only the ones it missed. Once full, recording a change forgets the oldest one.
+ */
+class ChangeLog final
+{
+public:
+    /*!
+        @param[in] capacity The number of changes to keep. Must not be zero.
+        @param[in] lastSequence The sequence number the first change follows on from. Starting
+                   from a different number each time the server runs stops a UI from being
+                   resynced with the changes of a previous run.
+     */
+    ChangeLog( const std::size_t capacity, const SequenceNumber lastSequence );
+
+    /*!
+        @brief Records a node connecting, updating its values or disconnecting.
+        @param[in] message The NodeConnect, NodeUpdate or NodeDisconnect message forwarded to UIs.
+        @returns The sequence number of the change.
+     */
+    SequenceNumber Record( const ParsedMessage& message );
+
+    /*!
+        @brief Returns the sequence number of the latest change.
+     */
+    SequenceNumber LastSequence() const;
+
+    /*!
+        @brief Returns true if every change after the provided one is still in the log, in which
+               case a UI that applied that change can be brought up to date with WriteSince().
+     */
+    bool Covers( const SequenceNumber sequence ) const;
+
+    /*!
+        @brief Appends every change after the provided one to the buffer, oldest first, as the
+               messages that were forwarded to UIs. Covers() must return true for the sequence.
+     */
+    void WriteSince(
+        std::string& out,
+        const SequenceNumber sequence,
+        const WireFormat format ) const;
+
+private:
+    // The changes are kept in a ring whose messages are overwritten in place, so that the IOs of
+    // a recorded change reuse the capacity left by the one it replaces.
+    std::vector<ParsedMessage> m_changes;
+    std::size_t m_size;
+    std::size_t m_next;
+    SequenceNumber m_lastSequence;
+};
+
+} // namespace sn
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#include <intrin.h>
+#endif
+
+namespace sn
+{
+
+/*!
+    @brief The instruction sets the delimiter scanner can classify bytes with.
+ */
+enum class ScanLevel
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+std::string_view to_string( const ScanLevel level );
+
+/*!
+    @brief Returns the fastest scan level supported by the CPU the program is running on.
+ */
+ScanLevel BestScanLevel();
+
+/*!
+    @brief Returns the scan level currently used by every DelimiterScanner.
+ */
+ScanLevel ActiveScanLevel();
+
+/*!
+    @brief Selects the scan level used by every DelimiterScanner. The best level is selected at
+           start-up, so this only exists to compare the implementations against each other. It
+           must not be called while messages are being parsed on another thread.
+    @param[in] level The level to use.
+    @returns False, and leaves the active level unchanged, if the CPU does not support the level.
+ */
+bool SetScanLevel( const ScanLevel level );
+
+/*!
+    @brief Classifies the bytes of a text message 64 at a time, using SSE2 or AVX2 when the CPU
+           supports them, so that field boundaries and digit runs are found with a bit scan instead
+           of a byte-by-byte loop. Blocks are classified lazily as the scanner moves through the
+           text, and positions passed to it are expected to mostly increase.
+ */
+class DelimiterScanner final
+{
+public:
+    explicit DelimiterScanner( const std::string_view text );
+
+    /*!
+        @brief Returns the position of the first '_', '\n' or '\r' at or after pos, or the size of
+               the text if there is none.
+     */
+    std::size_t FindFieldEnd( const std::size_t pos )
+    {
+        return FindFirst<&FieldEnds>( pos );
+    }
+
+    /*!
+        @brief Returns the position of the first byte at or after pos that is not a decimal digit,
+               or the size of the text if the digits run to the end.
+     */
+    std::size_t SkipDigits( const std::size_t pos )
+    {
+        return FindFirst<&NonDigits>( pos );
+    }
+
+    //! Bits set for the field ends and the digits of one block, lowest bit first.
+    struct BlockMasks
+    {
+        std::uint64_t fieldEnds;
+        std::uint64_t digits;
+    };
+
+    static constexpr std::size_t blockSize = 64;
+
+private:
+    /*!
+        @brief Finds the first set bit at or after pos in one of the masks, classifying further
+               blocks as needed. The common case of the bit being in the current block is inlined.
+     */
+    template<std::uint64_t ( *MaskOf )( const BlockMasks& )>
+    std::size_t FindFirst( const std::size_t pos )
+    {
+        if ( pos / blockSize == m_block )
+        {
+            const std::uint64_t mask = MaskOf( m_masks ) >> ( pos % blockSize );
+            if ( mask != 0 )
+            {
+                return pos + LowestSetBit( mask );
+            }
+        }
+
+        return FindFirstInLaterBlocks( pos, MaskOf );
+    }
+
+    std::size_t FindFirstInLaterBlocks(
+        std::size_t pos,
+        std::uint64_t ( *maskOf )( const BlockMasks& ) );
+
+    void LoadBlock( const std::size_t block );
+
+    static std::uint64_t FieldEnds( const BlockMasks& masks )
+    {
+        return masks.fieldEnds;
+    }
+
+    static std::uint64_t NonDigits( const BlockMasks& masks )
+    {
+        return ~masks.digits;
+    }
+
+    /*!
+        @brief Returns the index of the lowest set bit. The mask must not be zero.
+     */
+    static std::size_t LowestSetBit( const std::uint64_t mask )
+    {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+        unsigned long index = 0;
+        _BitScanForward64( &index, mask );
+        return index;
+#else
+        return static_cast<std::size_t>( __builtin_ctzll( mask ) );
+#endif
+    }
+
+private:
+    const std::string_view m_text;
+    std::size_t m_block;
+    BlockMasks m_masks;
+};
+
+} // namespace sn
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "messages.hpp"
+#include "node_cache.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief Keeps the FullState message of a NodeCache serialised as one segment per node and
+           protocol, so that a FullState is a concatenation of ready-made segments instead of a
+           serialisation of every node. Segments are only rewritten for nodes that have changed
+           since they were last written, and only in the protocols FullStates are requested in.
+ */
+class FullStateCache final
+{
+public:
+    /*!
+        @brief Marks the segments of a node as out of date, so that they are rewritten the next
+               time a FullState is written. Must be called whenever a node connects or any of its
+               values change.
+     */
+    void NodeChanged( const NodeId id );
+
+    /*!
+        @brief Forgets the segments of a node that has disconnected.
+     */
+    void NodeRemoved( const NodeId id );
+
+    void Clear();
+
+    /*!
+        @brief Appends a FullState message holding every node in the cache to the buffer, in the
+               order the nodes were added to it.
+     */
+    void Write( std::string& out, const NodeCache& nodes, const WireFormat format );
+
+private:
+    static constexpr std::size_t formatCount = 2;
+
+    //! The serialised form of one node in each protocol.
+    struct Segment
+    {
+        std::array<std::string, formatCount> encoded;
+        std::array<bool, formatCount> current{};
+    };
+
+private:
+    std::unordered_map<NodeId, Segment> m_segments;
+
+    // Reused by Write() so that writing a FullState does not allocate once they are large enough.
+    std::vector<std::string_view> m_gather;
+    std::vector<IO> m_ios;
+};
+
+} // namespace sn
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+
+namespace sn
+{
+
+//! Indexed by IOType.
+constexpr std::array<std::string_view, 5> ioTypeNames{ "di", "do", "ai", "ao", "Existing" };
+
+/*!
+    @brief Returns the name of the IO type in the text protocol, e.g. "di" for a digital input.
+           IOType::Existing is never sent with a type and is named "Existing".
+ */
+inline std::string_view to_string( const IOType type )
+{
+    return ioTypeNames[static_cast<std::size_t>( type )];
+}
+
+/*!
+    @brief Returns the IO type with the provided name in the text protocol, or an empty optional if
+           the name is not one of "di", "do", "ai" or "ao".
+ */
+std::optional<IOType> to_io_type( const std::string_view name );
+
+std::ostream& operator<<( std::ostream& os, const IOType type );
+
+} // namespace sn
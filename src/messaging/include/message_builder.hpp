@@ -1,8 +1,10 @@
 #pragma once
 
 #include "messages.hpp"
+#include "span.hpp"
 
 #include <string>
+#include <string_view>
 
 namespace sn
 {
@@ -10,8 +12,97 @@ namespace sn
 std::string BuildAck( const ParsedMessage& msg );
 std::string BuildNak( const ParsedMessage& msg );
 std::string BuildUiConnect( const UIId id );
-std::string BuildFullState( const std::vector<Node>& nodes );
+std::string BuildFullState( const Span<const Node> nodes );
 std::string BuildNodeDisconnect( const NodeId id );
-std::string BuildUpdateMessage( const NodeId id, std::vector<IO> ios );
+std::string BuildUpdateMessage( const NodeId id, const Span<const IO> ios );
+std::string BuildNodeConnect( const Node& node );
+
+/*!
+    @brief Builds the text form of any message other than a FullState.
+ */
+std::string BuildMessage( const ParsedMessage& msg );
+
+/*!
+    @brief Encodes any message other than a FullState in the requested protocol.
+ */
+std::string EncodeMessage( const ParsedMessage& msg, const WireFormat format );
+
+/*!
+    @brief Encodes a FullState message in the requested protocol.
+ */
+std::string EncodeFullState( const Span<const Node> nodes, const WireFormat format );
+
+// The Write functions append the text form of a message to the provided buffer instead of
+// returning a new string. The size of the message is computed up front so the buffer grows at
+// most once, and a buffer that is cleared and reused does not allocate once it is large enough.
+
+void WriteAck( std::string& out, const ParsedMessage& msg );
+void WriteNak( std::string& out, const ParsedMessage& msg );
+void WriteUiConnect( std::string& out, const UIId id, const SequenceNumber lastSequence = 0 );
+void WriteSequence( std::string& out, const SequenceNumber sequence );
+void WriteHistoryRequest( std::string& out, const NodeId id, const HistoryQuery& query );
+void WriteHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples );
+void WriteFullState( std::string& out, const Span<const Node> nodes );
+void WriteFullStateSegment( std::string& out, const NodeId id, const Span<const IO> ios );
+void WriteFullStateFromSegments( std::string& out, const Span<const std::string_view> segments );
+void WriteNodeDisconnect( std::string& out, const NodeId id );
+void WriteNodeStale( std::string& out, const NodeId id );
+void WriteUpdateMessage( std::string& out, const NodeId id, const Span<const IO> ios );
+void WriteNodeConnect( std::string& out, const Node& node );
+
+/*!
+    @brief Appends any message other than a FullState to the buffer in the requested protocol.
+    @throws std::runtime_error if the message is a FullState or cannot be encoded in the protocol.
+ */
+void WriteMessage( std::string& out, const ParsedMessage& msg, const WireFormat format );
+
+/*!
+    @brief Appends a FullState message to the buffer in the requested protocol.
+ */
+void WriteFullState( std::string& out, const Span<const Node> nodes, const WireFormat format );
+
+/*!
+    @brief Appends the part of a FullState message that holds one node to the buffer, in the
+           requested protocol. Segments written once can be joined into any number of FullState
+           messages with WriteFullStateFromSegments().
+ */
+void WriteFullStateSegment(
+    std::string& out,
+    const NodeId id,
+    const Span<const IO> ios,
+    const WireFormat format );
+
+/*!
+    @brief Appends a FullState message made up of the provided segments to the buffer. The
+           segments must have been written in the same protocol.
+ */
+void WriteFullStateFromSegments(
+    std::string& out,
+    const Span<const std::string_view> segments,
+    const WireFormat format );
+
+/*!
+    @brief Appends an update message to the buffer in the requested protocol.
+ */
+void WriteUpdateMessage(
+    std::string& out,
+    const NodeId id,
+    const Span<const IO> ios,
+    const WireFormat format );
+
+/*!
+    @brief Appends a History message holding the provided samples of an IO to the buffer in the
+           requested protocol.
+ */
+void WriteHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples,
+    const WireFormat format );
 
 } // namespace sn
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "messages.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sn
+{
+
+/*!
+    @brief Extracts complete protocol messages from a stream of bytes. A single read may contain
+           any number of messages and a message may be split across reads, in which case the
+           partial message is held until the rest of it arrives. Text messages are delimited by
+           "<" and ">" while binary messages are prefixed with their length.
+ */
+class MessageFramer final
+{
+public:
+    /*!
+        @param[in] format The protocol the peer is using.
+        @param[in] maxMessageSize Partial messages that grow beyond this many bytes without being
+                   terminated are discarded.
+     */
+    explicit MessageFramer(
+        const WireFormat format = WireFormat::Text,
+        const std::size_t maxMessageSize = defaultMaxMessageSize );
+
+    /*!
+        @brief Appends bytes read from the peer. Invalidates any message previously returned by
+               Next().
+        @param[in] bytes The bytes to append.
+     */
+    void Append( const std::string_view bytes );
+
+    /*!
+        @brief Returns the next complete message, including framing, or an empty optional if
+               there are no complete messages left. Bytes outside of a text message are skipped,
+               as is a text message that is cut short by the start of another, while an invalid
+               binary length prefix causes everything received so far to be discarded. The returned view remains valid until the next call to Append().
+     */
+    std::optional<std::string_view> Next();
+
+    /*!
+        @brief Returns the number of bytes held for a message that has not been completed yet.
+     */
+    std::size_t PendingBytes() const;
+
+    /*!
+        @brief Returns the total number of bytes that have been skipped because they were not part
+               of a complete message.
+     */
+    std::size_t DiscardedBytes() const;
+
+    static constexpr std::size_t defaultMaxMessageSize = 16 * 1024 * 1024;
+
+private:
+    std::optional<std::string_view> NextText();
+    std::optional<std::string_view> NextBinary();
+
+    /*!
+        @brief Drops every byte that has not been returned yet.
+     */
+    void DiscardPending();
+
+private:
+    WireFormat m_format;
+    std::string m_buffer;
+    std::size_t m_pos;
+    std::size_t m_scanned;
+    std::size_t m_discarded;
+    std::size_t m_maxMessageSize;
+};
+
+} // namespace sn
@@ -3,7 +3,10 @@
 #include "id_types.hpp"
 #include "data_types.hpp"
 
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <vector>
 
 namespace sn
 {
@@ -11,6 +14,12 @@ namespace sn
 static const std::string startOfMessage = "<";
 static const std::string endOfMessage = ">";
 
+enum class WireFormat
+{
+    Text,
+    Binary
+};
+
 enum class MessageType : char
 {
     NodeConnect = 'c',
@@ -20,26 +29,67 @@ enum class MessageType : char
     UiConnect = 'g',
     FullState = 's',
     NodeDisconnect = 'd',
-    UiUpdate = 'v'
+    UiUpdate = 'v',
+    Sequence = 'q',
+    HistoryRequest = 'h',
+    History = 'y',
+    NodeStale = 'o'
+};
+
+/*!
+    @brief Numbers the changes to the state of the nodes that the server forwards to UIs, so that a
+           reconnecting UI can be sent only the changes it missed. Zero means no change.
+ */
+using SequenceNumber = std::uint64_t;
+
+/*!
+    @brief Which samples of an IO a HistoryRequest asks for: those taken between since and until,
+           or the latest maxSamples of them. A zero in any field means no limit.
+ */
+struct HistoryQuery
+{
+    IOId io = invalid_io_id;
+    std::uint32_t maxSamples = 0;
+    Timestamp since = 0;
+    Timestamp until = 0;
 };
 
 struct ParsedMessage
 {
-    ParsedMessage( const MessageType msgType )
+    /*!
+        @param[in] msgType The type of the message.
+        @param[in] resource Where the IOs of the node are allocated.
+     */
+    ParsedMessage(
+        const MessageType msgType,
+        std::pmr::memory_resource* const resource = std::pmr::get_default_resource() )
         : type( msgType )
-        , node( Node{} )
+        , node( invalid_node_id, resource )
         , ui( UI{} )
     {}
 
     MessageType type;
     Node node;
     UI ui;
+
+    //! For a UiConnect, the last change the UI applied, if any. For a Sequence, the latest change.
+    SequenceNumber sequence = 0;
+
+    //! For a HistoryRequest, the IO of the node and the samples requested.
+    HistoryQuery history;
 };
 
 struct ParsedUiMessage
 {
     MessageType type;
     std::vector<Node> nodes;
+
+    //! For a Sequence, the change the UI is up to date with.
+    SequenceNumber sequence = 0;
+
+    //! For a History, the IO of the only node and its samples, oldest first.
+    IOId historyIO = invalid_io_id;
+    std::vector<HistorySample> history{};
 };
 
 } // namespace sn
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace sn
+{
+
+/*!
+    @brief The reasons a message can be rejected by the parser.
+ */
+enum class ParseError
+{
+    TooShort,
+    InvalidFraming,
+    InvalidMessageType,
+    UnhandledMessageType,
+    UnexpectedEnd,
+    LineBreak,
+    InvalidInteger,
+    InvalidNodeId,
+    InvalidUiId,
+    InvalidSegmentCount,
+    InvalidIoType,
+    MissingSeparator,
+    MissingNode,
+    InvalidLength,
+    InvalidVarint,
+    InvalidIoCount,
+    TrailingBytes
+};
+
+/*!
+    @brief Returns a description of the error that does not need to be freed or copied.
+ */
+std::string_view to_string( const ParseError error );
+
+/*!
+    @brief Describes why and where a message was rejected.
+ */
+struct ParseFailure
+{
+    ParseError error;
+
+    //! Offset of the byte at which the message was rejected, counted from the start of the
+    //! message including its framing.
+    std::size_t offset;
+};
+
+/*!
+    @brief Holds either a parsed value or the reason parsing failed, so that malformed messages
+           can be rejected without throwing.
+ */
+template<typename T>
+class ParseResult final
+{
+public:
+    ParseResult( const T& value )
+        : m_result( value )
+    {}
+
+    ParseResult( T&& value )
+        : m_result( std::move( value ) )
+    {}
+
+    ParseResult( const ParseFailure& failure )
+        : m_result( failure )
+    {}
+
+    /*!
+        @brief Returns true if parsing succeeded.
+     */
+    bool HasValue() const
+    {
+        return std::holds_alternative<T>( m_result );
+    }
+
+    explicit operator bool() const
+    {
+        return HasValue();
+    }
+
+    /*!
+        @brief Returns the parsed value. Must only be called if HasValue() returns true.
+     */
+    T& Value()
+    {
+        return std::get<T>( m_result );
+    }
+
+    const T& Value() const
+    {
+        return std::get<T>( m_result );
+    }
+
+    /*!
+        @brief Returns the reason parsing failed. Must only be called if HasValue() returns false.
+     */
+    const ParseFailure& Failure() const
+    {
+        return std::get<ParseFailure>( m_result );
+    }
+
+private:
+    std::variant<T, ParseFailure> m_result;
+};
+
+} // namespace sn
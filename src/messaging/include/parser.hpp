@@ -1,11 +1,69 @@
+#pragma once
+
 #include "messages.hpp"
+#include "parse_result.hpp"
 
-#include <string>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
 
 namespace sn
 {
 
-ParsedMessage parse( std::string msg, const PeerType peerType );
-ParsedUiMessage parse_ui_message( std::string msg );
+/*!
+    @brief Decodes a message received by the server without throwing.
+    @param[in] msg The complete message, including framing.
+    @param[in] peerType The type of peer that sent the message.
+    @param[in] format The protocol the peer is using.
+    @param[in] resource Where the IOs of the decoded message are allocated, e.g. an arena that is
+               released once the message has been handled.
+    @returns The decoded message, or the reason it was rejected and the offset at which that was
+             detected.
+ */
+ParseResult<ParsedMessage> try_parse(
+    const std::string_view msg,
+    const PeerType peerType,
+    const WireFormat format = WireFormat::Text,
+    std::pmr::memory_resource* const resource = std::pmr::get_default_resource() );
+
+/*!
+    @brief Decodes a message received by a UI without throwing.
+    @param[in] msg The complete message, including framing.
+    @param[in] format The protocol the server is using.
+    @returns The decoded message, or the reason it was rejected and the offset at which that was
+             detected.
+ */
+ParseResult<ParsedUiMessage> try_parse_ui_message(
+    const std::string_view msg,
+    const WireFormat format = WireFormat::Text );
+
+/*!
+    @brief Throwing equivalents of try_parse() and try_parse_ui_message().
+    @throws std::runtime_error describing the failure if the message is rejected.
+ */
+ParsedMessage parse( const std::string_view msg, const PeerType peerType );
+ParsedUiMessage parse_ui_message( const std::string_view msg );
+ParsedMessage parse( const std::string_view msg, const PeerType peerType, const WireFormat format );
+ParsedUiMessage parse_ui_message( const std::string_view msg, const WireFormat format );
+
+/*!
+    @brief Decodes a FullState message in a single pass, handing each node to the callback as soon
+           as it has been decoded.
+    @param[in] msg The complete FullState message, including framing.
+    @param[in] onNode Called once for each node, in the order they appear in the message.
+    @returns An empty optional on success, otherwise the reason the message was rejected. Any
+             nodes that precede the malformed part of the message will already have been passed
+             to onNode.
+ */
+std::optional<ParseFailure> try_parse_full_state(
+    const std::string_view msg,
+    const std::function<void( Node&& )>& onNode );
+
+/*!
+    @brief Throwing equivalent of try_parse_full_state().
+    @throws std::runtime_error if the message is malformed.
+ */
+void parse_full_state( const std::string_view msg, const std::function<void( Node&& )>& onNode );
 
 } // namespace sn
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace sn
+{
+
+/*!
+    @brief A non-owning view of a contiguous sequence of elements, standing in for std::span until
+           the project moves to C++20. Any container with data() and size(), such as std::vector
+           or std::array, converts to a Span implicitly.
+ */
+template<typename T>
+class Span final
+{
+public:
+    constexpr Span() noexcept
+        : m_data( nullptr )
+        , m_size( 0 )
+    {}
+
+    constexpr Span( T* data, const std::size_t size ) noexcept
+        : m_data( data )
+        , m_size( size )
+    {}
+
+    template<
+        typename Container,
+        typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<Container>, Span> &&
+            std::is_convertible_v<decltype( std::declval<Container&>().data() ), T*>>>
+    constexpr Span( Container&& container ) noexcept
+        : m_data( container.data() )
+        , m_size( container.size() )
+    {}
+
+    constexpr T* data() const noexcept
+    {
+        return m_data;
+    }
+
+    constexpr std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    constexpr bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    constexpr T* begin() const noexcept
+    {
+        return m_data;
+    }
+
+    constexpr T* end() const noexcept
+    {
+        return m_data + m_size;
+    }
+
+    constexpr T& operator[]( const std::size_t index ) const noexcept
+    {
+        return m_data[index];
+    }
+
+private:
+    T* m_data;
+    std::size_t m_size;
+};
+
+} // namespace sn
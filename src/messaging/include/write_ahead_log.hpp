@@ -0,0 +1,109 @@
+#pragma once
+
+#include "messages.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// A write-ahead log is a file header followed by one record per change, appended in the order the
+// changes were handled. Numbers are in the byte order of the machine that wrote the log:
+//
+//     header:  "SNWAL" '\0' '\0' '\0', layout version (u32), reserved (u32)
+//     record:  <length> (u32) <checksum> (u32) <time> (u64) <source> (u8) <message>
+//
+// where length counts the bytes after the checksum, checksum is the CRC-32 of those bytes, time is
+// in milliseconds since the Unix epoch, source is the PeerType that sent the message and message
+// is its binary protocol encoding. A crash can only leave a partial record at the end of the log.
+
+namespace sn
+{
+
+constexpr std::size_t walHeaderSize = 16;
+
+/*!
+    @brief Appends the header that starts every write-ahead log to the buffer.
+ */
+void WriteWalHeader( std::string& out );
+
+/*!
+    @brief Returns true if the data starts with a write-ahead log header this library can read.
+ */
+bool IsWalHeader( const std::string_view data );
+
+/*!
+    @brief Appends a record of a NodeConnect, NodeUpdate, UiUpdate or NodeDisconnect to the
+           buffer.
+    @throws std::runtime_error if the message cannot be encoded in the binary protocol.
+ */
+void AppendWalRecord( std::string& out, const ParsedMessage& msg, const Timestamp time );
+
+/*!
+    @brief One change read back from a write-ahead log.
+ */
+struct WalRecord
+{
+    Timestamp time = 0;
+    ParsedMessage message{ MessageType::Ack };
+};
+
+enum class WalStatus
+{
+    Record,
+    End,
+    Truncated,
+    Corrupt
+};
+
+/*!
+    @brief Reads the records of a write-ahead log one at a time.
+ */
+class WalReader final
+{
+public:
+    /*!
+        @param[in] log The whole log, including its header, which must have been checked with
+                   IsWalHeader(), or part of one.
+        @param[in] offset Where the first record starts: just after the header for a whole log,
+                   or 0 for part of one that starts with a record.
+     */
+    explicit WalReader( const std::string_view log, const std::size_t offset = walHeaderSize );
+
+    /*!
+        @brief Reads the next record.
+        @returns Record if one was read into record, End at the end of the log, Truncated if the
+                 log ends part way through a record, or Corrupt if a record fails its checksum or
+                 holds a message that cannot be decoded. Reading stops at the first failure.
+     */
+    WalStatus Next( WalRecord& record );
+
+    /*!
+        @brief Moves past the next record once its checksum is checked, without decoding it, for
+               a log that only needs checking.
+        @returns As Next(), except that a record holding a message that cannot be decoded is not
+                 found Corrupt.
+     */
+    WalStatus Skip();
+
+    /*!
+        @brief Returns the offset of the next record, or of the record that could not be read.
+     */
+    std::size_t Offset() const
+    {
+        return m_pos;
+    }
+
+private:
+    /*!
+        @brief Finds the body of the next record and checks its checksum and source.
+        @returns As Skip(), with body set if it returns Record.
+     */
+    WalStatus NextBody( std::string_view& body ) const;
+
+private:
+    const std::string_view m_log;
+    std::size_t m_pos;
+};
+
+} // namespace sn
@@ -0,0 +1,35 @@
+#include "io_types.hpp"
+
+#include <ostream>
+
+namespace sn
+{
+
+std::optional<IOType> to_io_type( const std::string_view name )
+{
+    if ( name.size() != 2 )
+    {
+        return std::nullopt;
+    }
+
+    for ( const auto type :
+          { IOType::DigitalInput,
+            IOType::DigitalOutput,
+            IOType::AnalogueInput,
+            IOType::AnalogueOutput } )
+    {
+        if ( to_string( type ) == name )
+        {
+            return type;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::ostream& operator<<( std::ostream& os, const IOType type )
+{
+    return os << to_string( type );
+}
+
+} // namespace sn
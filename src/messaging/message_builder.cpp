@@ -1,78 +1,567 @@
 #include "message_builder.hpp"
+#include "binary_protocol.hpp"
+#include "io_types.hpp"
 
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
 
 namespace sn
 {
 
-std::string BuildAck( const ParsedMessage& msg )
+/*!
+    @brief Returns the number of characters needed to print the value in decimal.
+ */
+std::size_t DecimalSize( const std::uint32_t value )
 {
-    if ( msg.node.id != invalid_node_id )
+    std::size_t size = 1;
+    for ( std::uint32_t remaining = value; remaining >= 10; remaining /= 10 )
     {
-        return startOfMessage + "a_" + std::to_string( static_cast<uint32_t>( msg.node.id ) ) +
-               endOfMessage;
+        ++size;
     }
-    else
+
+    return size;
+}
+
+std::size_t DecimalSize( const std::uint64_t value )
+{
+    std::size_t size = 1;
+    for ( std::uint64_t remaining = value; remaining >= 10; remaining /= 10 )
     {
-        return startOfMessage + "a_" + std::to_string( static_cast<uint32_t>( msg.ui.id ) ) +
-               endOfMessage;
+        ++size;
     }
+
+    return size;
 }
 
-std::string BuildNak( const ParsedMessage& msg )
+std::size_t DecimalSize( const int value )
+{
+    if ( value >= 0 )
+    {
+        return DecimalSize( static_cast<std::uint32_t>( value ) );
+    }
+
+    // Negate in unsigned arithmetic so that INT_MIN does not overflow.
+    return 1 + DecimalSize( 0u - static_cast<std::uint32_t>( value ) );
+}
+
+template<typename IdType>
+std::size_t IdSize( const IdType id )
+{
+    return DecimalSize( static_cast<std::uint32_t>( id ) );
+}
+
+/*!
+    @brief Writes a message of a precomputed size into the end of a buffer. The buffer is grown by
+           exactly that size up front, so writing never reallocates.
+ */
+class TextWriter
+{
+public:
+    TextWriter( std::string& out, const std::size_t size )
+    {
+        const auto offset = out.size();
+        out.resize( offset + size );
+
+        m_pos = out.data() + offset;
+        m_end = m_pos + size;
+    }
+
+    void Put( const char c )
+    {
+        *m_pos++ = c;
+    }
+
+    void Put( const std::string_view text )
+    {
+        m_pos = std::copy( text.begin(), text.end(), m_pos );
+    }
+
+    template<typename Number>
+    void PutNumber( const Number value )
+    {
+        m_pos = std::to_chars( m_pos, m_end, value ).ptr;
+    }
+
+    template<typename IdType>
+    void PutId( const IdType id )
+    {
+        PutNumber( static_cast<std::uint32_t>( id ) );
+    }
+
+private:
+    char* m_pos;
+    char* m_end;
+};
+
+/*!
+    @brief Writes a message made up of a header and a single ID, e.g. "<a_1>".
+ */
+template<typename IdType>
+void WriteIdMessage( std::string& out, const std::string_view header, const IdType id )
+{
+    TextWriter writer( out, header.size() + IdSize( id ) + 1 );
+    writer.Put( header );
+    writer.PutId( id );
+    writer.Put( endOfMessage );
+}
+
+/*!
+    @brief Writes an ID message for either the node or the UI a message came from.
+ */
+void WriteReply( std::string& out, const std::string_view header, const ParsedMessage& msg )
 {
     if ( msg.node.id != invalid_node_id )
     {
-        return startOfMessage + "n_" + std::to_string( static_cast<uint32_t>( msg.node.id ) ) +
-               endOfMessage;
+        WriteIdMessage( out, header, msg.node.id );
     }
     else
     {
-        return startOfMessage + "n_" + std::to_string( static_cast<uint32_t>( msg.ui.id ) ) +
-               endOfMessage;
+        WriteIdMessage( out, header, msg.ui.id );
     }
 }
 
-std::string BuildUiConnect( const UIId id )
+std::size_t TypedIOSize( const IO& io )
+{
+    return 3 + to_string( io.type ).size() + IdSize( io.id ) + DecimalSize( io.value );
+}
+
+void PutTypedIO( TextWriter& writer, const IO& io )
 {
-    return startOfMessage + "g_" + std::to_string( static_cast<uint32_t>( id ) ) + endOfMessage;
+    writer.Put( '_' );
+    writer.Put( to_string( io.type ) );
+    writer.Put( '_' );
+    writer.PutId( io.id );
+    writer.Put( '_' );
+    writer.PutNumber( io.value );
 }
 
-std::string BuildFullState( const std::vector<Node>& nodes )
+void WriteAck( std::string& out, const ParsedMessage& msg )
 {
-    std::ostringstream oss;
-    oss << startOfMessage << 's' << ( nodes.empty() ? "_" : "" );
+    WriteReply( out, "<a_", msg );
+}
+
+void WriteNak( std::string& out, const ParsedMessage& msg )
+{
+    WriteReply( out, "<n_", msg );
+}
+
+void WriteUiConnect( std::string& out, const UIId id, const SequenceNumber lastSequence )
+{
+    if ( lastSequence == 0 )
+    {
+        WriteIdMessage( out, "<g_", id );
+        return;
+    }
+
+    TextWriter writer( out, 5 + IdSize( id ) + DecimalSize( lastSequence ) );
+    writer.Put( "<g_" );
+    writer.PutId( id );
+    writer.Put( '_' );
+    writer.PutNumber( lastSequence );
+    writer.Put( endOfMessage );
+}
+
+void WriteSequence( std::string& out, const SequenceNumber sequence )
+{
+    TextWriter writer( out, 4 + DecimalSize( sequence ) );
+    writer.Put( "<q_" );
+    writer.PutNumber( sequence );
+    writer.Put( endOfMessage );
+}
+
+void WriteHistoryRequest( std::string& out, const NodeId id, const HistoryQuery& query )
+{
+    // The end of the window is only written if it is set, and the start only if either is.
+    const bool withUntil = query.until != 0;
+    const bool withSince = withUntil || query.since != 0;
+
+    std::size_t size = 6 + IdSize( id ) + IdSize( query.io ) + DecimalSize( query.maxSamples );
+    size += withSince ? 1 + DecimalSize( query.since ) : 0;
+    size += withUntil ? 1 + DecimalSize( query.until ) : 0;
+
+    TextWriter writer( out, size );
+    writer.Put( "<h_" );
+    writer.PutId( id );
+    writer.Put( '_' );
+    writer.PutId( query.io );
+    writer.Put( '_' );
+    writer.PutNumber( query.maxSamples );
+
+    if ( withSince )
+    {
+        writer.Put( '_' );
+        writer.PutNumber( query.since );
+    }
+
+    if ( withUntil )
+    {
+        writer.Put( '_' );
+        writer.PutNumber( query.until );
+    }
+
+    writer.Put( endOfMessage );
+}
+
+void WriteHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples )
+{
+    std::size_t size = 5 + IdSize( id ) + IdSize( ioId );
+    for ( const auto& sample : samples )
+    {
+        size += 2 + DecimalSize( sample.time ) + DecimalSize( sample.value );
+    }
+
+    TextWriter writer( out, size );
+    writer.Put( "<y_" );
+    writer.PutId( id );
+    writer.Put( '_' );
+    writer.PutId( ioId );
+
+    for ( const auto& sample : samples )
+    {
+        writer.Put( '_' );
+        writer.PutNumber( sample.time );
+        writer.Put( '_' );
+        writer.PutNumber( sample.value );
+    }
+
+    writer.Put( endOfMessage );
+}
+
+void WriteNodeDisconnect( std::string& out, const NodeId id )
+{
+    WriteIdMessage( out, "<d_", id );
+}
+
+void WriteNodeStale( std::string& out, const NodeId id )
+{
+    WriteIdMessage( out, "<o_", id );
+}
+
+/*!
+    @brief Returns the size of the part of a FullState that holds one node, e.g. "_n_1_di_2_0".
+ */
+std::size_t FullStateNodeSize( const NodeId id, const Span<const IO> ios )
+{
+    std::size_t size = 3 + IdSize( id );
+    for ( const auto& io : ios )
+    {
+        size += TypedIOSize( io );
+    }
+
+    return size;
+}
+
+void PutFullStateNode( TextWriter& writer, const NodeId id, const Span<const IO> ios )
+{
+    writer.Put( "_n_" );
+    writer.PutId( id );
+
+    for ( const auto& io : ios )
+    {
+        PutTypedIO( writer, io );
+    }
+}
+
+/*!
+    @brief Returns the size of a FullState whose nodes take up nodesSize characters.
+ */
+std::size_t FullStateSize( const std::size_t nodesSize, const bool empty )
+{
+    // "<s" and ">", plus the '_' that makes up the body of an empty FullState.
+    return nodesSize + ( empty ? 4 : 3 );
+}
+
+void WriteFullState( std::string& out, const Span<const Node> nodes )
+{
+    std::size_t nodesSize = 0;
+    for ( const auto& node : nodes )
+    {
+        nodesSize += FullStateNodeSize( node.id, node.io );
+    }
+
+    TextWriter writer( out, FullStateSize( nodesSize, nodes.empty() ) );
+    writer.Put( "<s" );
+
+    if ( nodes.empty() )
+    {
+        writer.Put( '_' );
+    }
 
     for ( const auto& node : nodes )
     {
-        oss << "_n_" << node.id;
-        for ( const auto& io : node.io )
-        {
-            oss << '_' << io.type << '_' << io.id << '_' << io.value;
-        }
+        PutFullStateNode( writer, node.id, node.io );
     }
 
-    oss << endOfMessage;
-    return oss.str();
+    writer.Put( endOfMessage );
 }
 
-std::string BuildNodeDisconnect( const NodeId id )
+void WriteFullStateSegment( std::string& out, const NodeId id, const Span<const IO> ios )
 {
-    return startOfMessage + "d_" + std::to_string( static_cast<uint32_t>( id ) ) + endOfMessage;
+    TextWriter writer( out, FullStateNodeSize( id, ios ) );
+    PutFullStateNode( writer, id, ios );
 }
 
-std::string BuildUpdateMessage( const NodeId id, std::vector<IO> ios )
+void WriteFullStateFromSegments( std::string& out, const Span<const std::string_view> segments )
 {
-    std::ostringstream oss;
-    oss << startOfMessage << "u_" << id;
+    std::size_t nodesSize = 0;
+    for ( const auto& segment : segments )
+    {
+        nodesSize += segment.size();
+    }
+
+    TextWriter writer( out, FullStateSize( nodesSize, segments.empty() ) );
+    writer.Put( "<s" );
+
+    if ( segments.empty() )
+    {
+        writer.Put( '_' );
+    }
+
+    for ( const auto& segment : segments )
+    {
+        writer.Put( segment );
+    }
+
+    writer.Put( endOfMessage );
+}
+
+void WriteUpdateMessage( std::string& out, const NodeId id, const Span<const IO> ios )
+{
+    std::size_t size = 4 + IdSize( id );
+    for ( const auto& io : ios )
+    {
+        size += 2 + IdSize( io.id ) + DecimalSize( io.value );
+    }
+
+    TextWriter writer( out, size );
+    writer.Put( "<u_" );
+    writer.PutId( id );
 
     for ( const auto& io : ios )
     {
-        oss << '_' << io.id << '_' << io.value;
+        writer.Put( '_' );
+        writer.PutId( io.id );
+        writer.Put( '_' );
+        writer.PutNumber( io.value );
+    }
+
+    writer.Put( endOfMessage );
+}
+
+void WriteNodeConnect( std::string& out, const Node& node )
+{
+    std::size_t size = 4 + IdSize( node.id );
+    for ( const auto& io : node.io )
+    {
+        size += TypedIOSize( io );
+    }
+
+    TextWriter writer( out, size );
+    writer.Put( "<c_" );
+    writer.PutId( node.id );
+
+    for ( const auto& io : node.io )
+    {
+        PutTypedIO( writer, io );
+    }
+
+    writer.Put( endOfMessage );
+}
+
+/*!
+    @brief Appends the text form of any message other than a FullState.
+ */
+void WriteTextMessage( std::string& out, const ParsedMessage& msg )
+{
+    switch ( msg.type )
+    {
+    case MessageType::Ack:
+        return WriteAck( out, msg );
+    case MessageType::Nak:
+        return WriteNak( out, msg );
+    case MessageType::NodeConnect:
+        return WriteNodeConnect( out, msg.node );
+    case MessageType::NodeUpdate:
+    case MessageType::UiUpdate:
+        return WriteUpdateMessage( out, msg.node.id, msg.node.io );
+    case MessageType::UiConnect:
+        return WriteUiConnect( out, msg.ui.id, msg.sequence );
+    case MessageType::Sequence:
+        return WriteSequence( out, msg.sequence );
+    case MessageType::HistoryRequest:
+        return WriteHistoryRequest( out, msg.node.id, msg.history );
+    case MessageType::NodeDisconnect:
+        return WriteNodeDisconnect( out, msg.node.id );
+    case MessageType::NodeStale:
+        return WriteNodeStale( out, msg.node.id );
+    default:
+        throw std::runtime_error( "Message type cannot be built on its own." );
+    }
+}
+
+void WriteMessage( std::string& out, const ParsedMessage& msg, const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinary( out, msg );
+    }
+    else
+    {
+        WriteTextMessage( out, msg );
+    }
+}
+
+void WriteFullState( std::string& out, const Span<const Node> nodes, const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinaryFullState( out, nodes );
+    }
+    else
+    {
+        WriteFullState( out, nodes );
+    }
+}
+
+void WriteFullStateSegment(
+    std::string& out,
+    const NodeId id,
+    const Span<const IO> ios,
+    const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinaryFullStateSegment( out, id, ios );
+    }
+    else
+    {
+        WriteFullStateSegment( out, id, ios );
+    }
+}
+
+void WriteFullStateFromSegments(
+    std::string& out,
+    const Span<const std::string_view> segments,
+    const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinaryFullStateFromSegments( out, segments );
+    }
+    else
+    {
+        WriteFullStateFromSegments( out, segments );
+    }
+}
+
+void WriteUpdateMessage(
+    std::string& out,
+    const NodeId id,
+    const Span<const IO> ios,
+    const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinaryUpdate( out, id, ios );
+    }
+    else
+    {
+        WriteUpdateMessage( out, id, ios );
+    }
+}
+
+void WriteHistory(
+    std::string& out,
+    const NodeId id,
+    const IOId ioId,
+    const Span<const HistorySample> samples,
+    const WireFormat format )
+{
+    if ( format == WireFormat::Binary )
+    {
+        WriteBinaryHistory( out, id, ioId, samples );
+    }
+    else
+    {
+        WriteHistory( out, id, ioId, samples );
     }
+}
+
+std::string BuildAck( const ParsedMessage& msg )
+{
+    std::string out;
+    WriteAck( out, msg );
+    return out;
+}
 
-    oss << endOfMessage;
-    return oss.str();
+std::string BuildNak( const ParsedMessage& msg )
+{
+    std::string out;
+    WriteNak( out, msg );
+    return out;
+}
+
+std::string BuildUiConnect( const UIId id )
+{
+    std::string out;
+    WriteUiConnect( out, id );
+    return out;
+}
+
+std::string BuildFullState( const Span<const Node> nodes )
+{
+    std::string out;
+    WriteFullState( out, nodes );
+    return out;
+}
+
+std::string BuildNodeDisconnect( const NodeId id )
+{
+    std::string out;
+    WriteNodeDisconnect( out, id );
+    return out;
+}
+
+std::string BuildUpdateMessage( const NodeId id, const Span<const IO> ios )
+{
+    std::string out;
+    WriteUpdateMessage( out, id, ios );
+    return out;
+}
+
+std::string BuildNodeConnect( const Node& node )
+{
+    std::string out;
+    WriteNodeConnect( out, node );
+    return out;
+}
+
+std::string BuildMessage( const ParsedMessage& msg )
+{
+    std::string out;
+    WriteTextMessage( out, msg );
+    return out;
+}
+
+std::string EncodeMessage( const ParsedMessage& msg, const WireFormat format )
+{
+    std::string out;
+    WriteMessage( out, msg, format );
+    return out;
+}
+
+std::string EncodeFullState( const Span<const Node> nodes, const WireFormat format )
+{
+    std::string out;
+    WriteFullState( out, nodes, format );
+    return out;
 }
 
 } // namespace sn
@@ -0,0 +1,125 @@
+#include "message_framer.hpp"
+#include "varint.hpp"
+
+#include <algorithm>
+
+namespace sn
+{
+
+MessageFramer::MessageFramer( const WireFormat format, const std::size_t maxMessageSize )
+    : m_format( format )
+    , m_buffer()
+    , m_pos( 0 )
+    , m_scanned( 0 )
+    , m_discarded( 0 )
+    , m_maxMessageSize( maxMessageSize )
+{}
+
+void MessageFramer::Append( const std::string_view bytes )
+{
+    // Drop everything that has already been handed out before growing the buffer.
+    m_buffer.erase( 0, m_pos );
+    m_pos = 0;
+
+    m_buffer.append( bytes );
+}
+
+std::optional<std::string_view> MessageFramer::Next()
+{
+    return m_format == WireFormat::Binary ? NextBinary() : NextText();
+}
+
+std::optional<std::string_view> MessageFramer::NextText()
+{
+    auto start = m_buffer.find( startOfMessage, m_pos );
+    if ( start == std::string::npos )
+    {
+        m_discarded += m_buffer.size() - m_pos;
+        m_pos = m_buffer.size();
+        return std::nullopt;
+    }
+
+    if ( start != m_pos )
+    {
+        m_discarded += start - m_pos;
+        m_pos = start;
+        m_scanned = 0;
+    }
+
+    // Don't rescan the part of a partial message that was already searched on a previous call.
+    const auto end = m_buffer.find( endOfMessage, m_pos + std::max<std::size_t>( m_scanned, 1 ) );
+    if ( end == std::string::npos )
+    {
+        m_scanned = PendingBytes();
+
+        if ( PendingBytes() > m_maxMessageSize )
+        {
+            DiscardPending();
+        }
+
+        return std::nullopt;
+    }
+
+    // A "<" before the ">" starts a new message, so the one before it was cut short. It is
+    // discarded rather than merged into the next, which the parser could otherwise accept.
+    const auto lastStart = m_buffer.rfind( startOfMessage, end );
+    if ( lastStart != start )
+    {
+        m_discarded += lastStart - start;
+        start = lastStart;
+    }
+
+    m_pos = end + 1;
+    m_scanned = 0;
+    return std::string_view( m_buffer ).substr( start, m_pos - start );
+}
+
+std::optional<std::string_view> MessageFramer::NextBinary()
+{
+    const std::string_view buffer( m_buffer );
+    std::size_t bodyStart = m_pos;
+    const auto length = GetVarint( buffer, bodyStart );
+
+    if ( !length )
+    {
+        // A length prefix never takes more than maxVarintSize bytes.
+        if ( PendingBytes() >= maxVarintSize )
+        {
+            DiscardPending();
+        }
+
+        return std::nullopt;
+    }
+    else if ( *length > m_maxMessageSize )
+    {
+        DiscardPending();
+        return std::nullopt;
+    }
+    else if ( buffer.size() - bodyStart < *length )
+    {
+        return std::nullopt;
+    }
+
+    const auto start = m_pos;
+    m_pos = bodyStart + *length;
+    return buffer.substr( start, m_pos - start );
+}
+
+void MessageFramer::DiscardPending()
+{
+    m_discarded += PendingBytes();
+    m_pos = m_buffer.size();
+    m_scanned = 0;
+}
+
+std::size_t MessageFramer::PendingBytes() const
+{
+    return m_buffer.size() - m_pos;
+}
+
+std::size_t MessageFramer::DiscardedBytes() const
+{
+    return m_discarded;
+}
+
+} // namespace sn
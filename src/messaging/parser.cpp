@@ -1,376 +1,1007 @@
-// This is disgusting parsing code... :(
-// TODO: After cleaning up the copious amounts of vomit, also clean up this parsing mess.
-
 #include "parser.hpp"
+#include "binary_protocol.hpp"
+#include "decoder_table.hpp"
+#include "delimiter_scanner.hpp"
+#include "io_types.hpp"
 
-#include <boost/algorithm/string.hpp>
-
+#include <charconv>
+#include <optional>
 #include <stdexcept>
-#include <regex>
 
 namespace sn
 {
 
 const char startOfMsg = '<';
 const char endOfMsg = '>';
+const char fieldSeparator = '_';
 const std::size_t minMsgSize = 5;
 const std::size_t minUiMsgSize = 4;
-const std::regex msgTypeRegex( R"(<(\w)_.*>)" );
-const std::regex fullStateRegex( R"(<s(_n_\d+(_(\w{2})_(\d+)_(\d+))*)+>)" );
-const std::regex nodeRegex( R"(n_(\d+)((_\w{2}_\d+_\d+)*))" );
-const std::regex ioRegex( R"((\w{2})_(\d+)_(\d+))" );
-const std::string emptyFullStateMsg( "<s_>" );
-
-bool is_message_framed( const std::string& msg )
+const std::size_t msgTypeOffset = 1;
+const std::size_t msgBodyOffset = 3;
+const std::size_t ioTypeSize = 2;
+const std::string_view fullStateHeader( "<s" );
+const std::string_view fullStateNodeHeader( "_n_" );
+const std::string_view emptyFullStateMsg( "<s_>" );
+
+std::string_view to_string( const ParseError error )
 {
-    return msg.front() == startOfMsg && msg.back() == endOfMsg;
+    switch ( error )
+    {
+    case ParseError::TooShort:
+        return "Message is too short";
+    case ParseError::InvalidFraming:
+        return "Message is not framed correctly";
+    case ParseError::InvalidMessageType:
+        return "Invalid message type";
+    case ParseError::UnhandledMessageType:
+        return "Unhandled message type";
+    case ParseError::UnexpectedEnd:
+        return "Unexpected end of message";
+    case ParseError::LineBreak:
+        return "Line break in message";
+    case ParseError::InvalidInteger:
+        return "Invalid integer field";
+    case ParseError::InvalidNodeId:
+        return "Invalid Node ID";
+    case ParseError::InvalidUiId:
+        return "Invalid UI ID";
+    case ParseError::InvalidSegmentCount:
+        return "Invalid number of segments";
+    case ParseError::InvalidIoType:
+        return "Invalid IO type";
+    case ParseError::MissingSeparator:
+        return "Missing separator";
+    case ParseError::MissingNode:
+        return "Expected a node";
+    case ParseError::InvalidLength:
+        return "Invalid message length";
+    case ParseError::InvalidVarint:
+        return "Invalid varint";
+    case ParseError::InvalidIoCount:
+        return "Invalid IO count";
+    case ParseError::TrailingBytes:
+        return "Unexpected trailing bytes";
+    }
+
+    return "Unknown parse error";
 }
 
-MessageType get_message_type( const std::string& msg, const PeerType peerType )
+/*!
+    @brief Walks the '_' separated fields of a message body without copying them. The fields are
+           the same as those produced by splitting the body on '_', so an empty body or a trailing
+           separator yields an empty field.
+ */
+class FieldReader
 {
-    std::smatch msg_type_match;
+public:
+    /*!
+        @param[in] msg The complete message, which failures are reported relative to.
+        @param[in] body The part of the message holding the fields.
+     */
+    FieldReader( const std::string_view msg, const std::string_view body )
+        : m_msg( msg )
+        , m_body( body )
+        , m_scanner( body )
+        , m_pos( 0 )
+        , m_exhausted( false )
+    {}
+
+    /*!
+        @brief Returns the complete message the fields are read from.
+     */
+    std::string_view Message() const
+    {
+        return m_msg;
+    }
 
-    if ( std::regex_match( msg, msg_type_match, msgTypeRegex ) )
+    /*!
+        @brief Returns true if there is at least one more field to read.
+     */
+    bool HasNext() const
     {
-        const char msg_type = msg_type_match.str( 1 ).front();
-        switch ( msg_type )
+        return !m_exhausted;
+    }
+
+    /*!
+        @brief Returns the next field. Line breaks are rejected as they were never accepted by the
+               message type regex this reader replaced.
+     */
+    ParseResult<std::string_view> Next()
+    {
+        if ( m_exhausted )
         {
-        case 'c':
-            return MessageType::NodeConnect;
-        case 'u':
+            return FailAtEnd( ParseError::UnexpectedEnd );
+        }
+
+        const auto end = m_scanner.FindFieldEnd( m_pos );
+        const auto field = m_body.substr( m_pos, end - m_pos );
+
+        if ( end == m_body.size() )
         {
-            if ( peerType == PeerType::Node )
-            {
-                return MessageType::NodeUpdate;
-            }
-            else
+            m_exhausted = true;
+        }
+        else if ( m_body[end] != fieldSeparator )
+        {
+            return Fail( ParseError::LineBreak, m_body.substr( end ) );
+        }
+        else
+        {
+            m_pos = end + 1;
+        }
+
+        return field;
+    }
+
+    /*!
+        @brief Reads and discards any remaining fields.
+     */
+    std::optional<ParseFailure> Skip()
+    {
+        while ( HasNext() )
+        {
+            const auto field = Next();
+            if ( !field )
             {
-                return MessageType::UiUpdate;
+                return field.Failure();
             }
         }
-        case 'a':
-            return MessageType::Ack;
-        case 'n':
-            return MessageType::Nak;
-        case 'g':
-            return MessageType::UiConnect;
-        case 's':
-            return MessageType::FullState;
-        case 'd':
-            return MessageType::NodeDisconnect;
-        default:
-            throw std::runtime_error( "Invalid message type: " + std::to_string( msg_type ) );
-        }
+
+        return std::nullopt;
     }
-    else
+
+    /*!
+        @brief Returns a failure located at the start of the provided part of the message.
+     */
+    ParseFailure Fail( const ParseError error, const std::string_view at ) const
     {
-        throw std::runtime_error( "Failed to parse message type." );
+        return { error, static_cast<std::size_t>( at.data() - m_msg.data() ) };
     }
-}
 
-template<typename IdType>
-IdType get_id( const std::vector<std::string>& components )
+    /*!
+        @brief Returns a failure located at the first field that has not been read yet.
+     */
+    ParseFailure FailAtNext( const ParseError error ) const
+    {
+        return Fail( error, m_body.substr( m_pos ) );
+    }
+
+    /*!
+        @brief Returns a failure located at the end of the message.
+     */
+    ParseFailure FailAtEnd( const ParseError error ) const
+    {
+        return { error, m_msg.size() - 1 };
+    }
+
+private:
+    const std::string_view m_msg;
+    const std::string_view m_body;
+    DelimiterScanner m_scanner;
+    std::size_t m_pos;
+    bool m_exhausted;
+};
+
+bool is_space( const char c )
 {
-    return static_cast<IdType>( std::stoi( components.at( 1 ) ) );
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
 }
 
-ParsedMessage parse_ack( const MessageType msgType, const std::vector<std::string>& components )
+/*!
+    @brief Decodes an integer field with the same leniency as std::stoi, which the protocol was
+           originally parsed with: leading whitespace and a sign are accepted and decoding stops at
+           the first character that is not a digit.
+    @param[in] field The field to decode.
+    @returns The decoded value or an empty optional if the field does not start with an integer.
+ */
+std::optional<int> to_int( const std::string_view field )
 {
-    if ( components.size() != 2 )
+    const char* first = field.data();
+    const char* const last = field.data() + field.size();
+
+    while ( first != last && is_space( *first ) )
     {
-        throw std::runtime_error( "Invalid ACK/NAK message size." );
+        ++first;
     }
 
-    ParsedMessage parsedMsg{ msgType };
-    parsedMsg.node.id = get_id<NodeId>( components );
+    if ( first != last && *first == '+' )
+    {
+        ++first;
 
-    return parsedMsg;
+        // std::from_chars accepts a '-' here, std::stoi does not.
+        if ( first != last && *first == '-' )
+        {
+            return std::nullopt;
+        }
+    }
+
+    int value = 0;
+    const auto result = std::from_chars( first, last, value );
+
+    if ( result.ec != std::errc() )
+    {
+        return std::nullopt;
+    }
+
+    return value;
 }
 
-ParsedMessage parse_node_connect( const std::vector<std::string>& components )
+ParseResult<int> get_int( FieldReader& fields )
 {
-    if ( ( components.size() - 2 ) % 3 != 0 )
+    const auto field = fields.Next();
+    if ( !field )
     {
-        throw std::runtime_error( "Invalid number of segments for node connect message." );
+        return field.Failure();
     }
 
-    ParsedMessage parsedMsg( MessageType::NodeConnect );
-    parsedMsg.node.id = get_id<NodeId>( components );
+    const auto value = to_int( field.Value() );
+    if ( !value )
+    {
+        return fields.Fail( ParseError::InvalidInteger, field.Value() );
+    }
+
+    return *value;
+}
 
-    if ( parsedMsg.node.id == invalid_node_id )
+ParseResult<std::uint64_t> get_uint64( FieldReader& fields )
+{
+    const auto field = fields.Next();
+    if ( !field )
     {
-        throw std::runtime_error( "Invalid Node ID." );
+        return field.Failure();
     }
 
-    for ( std::size_t segmentNum = 2; segmentNum < components.size(); segmentNum += 3 )
+    const char* const first = field.Value().data();
+    const char* const last = first + field.Value().size();
+    std::uint64_t value = 0;
+
+    // Unlike the other numbers, sequence numbers and timestamps are only ever written by this
+    // library, so any whitespace or sign is rejected.
+    const auto result = std::from_chars( first, last, value );
+    if ( first == last || result.ec != std::errc() || result.ptr != last )
     {
-        const auto& ioType = components.at( segmentNum );
-        const auto ioId = static_cast<IOId>( std::stoi( components.at( segmentNum + 1 ) ) );
-        const auto value = std::stoi( components.at( segmentNum + 2 ) );
-        parsedMsg.node.io.emplace_back( ioId, ioType, value );
+        return fields.Fail( ParseError::InvalidInteger, field.Value() );
     }
 
-    return parsedMsg;
+    return value;
 }
 
-ParsedMessage parse_update( const MessageType msgType, const std::vector<std::string>& components )
+template<typename IdType>
+ParseResult<IdType> get_id( FieldReader& fields )
 {
-    if ( ( components.size() - 2 ) % 2 != 0 )
+    const auto value = get_int( fields );
+    if ( !value )
     {
-        throw std::runtime_error( "Invalid number of segments for node update message." );
+        return value.Failure();
     }
 
-    ParsedMessage parsedMsg( msgType );
-    parsedMsg.node.id = get_id<NodeId>( components );
+    return static_cast<IdType>( value.Value() );
+}
 
-    if ( parsedMsg.node.id == invalid_node_id )
+/*!
+    @brief Checks the framing of a message and returns the body that follows the "<x_" header.
+    @param[in] msg The complete message.
+    @param[in] minSize The minimum size of a valid message.
+ */
+ParseResult<std::string_view> get_message_body(
+    const std::string_view msg,
+    const std::size_t minSize )
+{
+    if ( msg.size() < minSize )
+    {
+        return ParseFailure{ ParseError::TooShort, msg.size() };
+    }
+    else if ( msg.front() != startOfMsg )
+    {
+        return ParseFailure{ ParseError::InvalidFraming, 0 };
+    }
+    else if ( msg.back() != endOfMsg )
+    {
+        return ParseFailure{ ParseError::InvalidFraming, msg.size() - 1 };
+    }
+    else if ( msg[msgBodyOffset - 1] != fieldSeparator )
     {
-        throw std::runtime_error( "Invalid Node ID." );
+        return ParseFailure{ ParseError::MissingSeparator, msgBodyOffset - 1 };
     }
 
-    for ( std::size_t segmentNum = 2; segmentNum < components.size(); segmentNum += 2 )
+    return msg.substr( msgBodyOffset, msg.size() - msgBodyOffset - 1 );
+}
+
+template<MessageType msgType>
+ParseResult<ParsedMessage> parse_ack( FieldReader& fields, std::pmr::memory_resource* )
+{
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+    else if ( fields.HasNext() )
     {
-        const auto ioId = static_cast<IOId>( std::stoi( components.at( segmentNum ) ) );
-        const auto value = std::stoi( components.at( segmentNum + 1 ) );
-        parsedMsg.node.io.emplace_back( ioId, "Existing", value );
+        return fields.FailAtNext( ParseError::InvalidSegmentCount );
     }
 
+    ParsedMessage parsedMsg{ msgType };
+    parsedMsg.node.id = nodeId.Value();
+
     return parsedMsg;
 }
 
-ParsedMessage parse_ui_connect( const std::vector<std::string>& components )
+ParseResult<Node> parse_node( FieldReader& fields, std::pmr::memory_resource* const resource )
 {
-    if ( components.size() != 2 )
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+    else if ( nodeId.Value() == invalid_node_id )
     {
-        throw std::runtime_error( "Invalid number of segments for UI connect message." );
+        return ParseFailure{ ParseError::InvalidNodeId, msgBodyOffset };
     }
 
-    ParsedMessage parsedMsg( MessageType::UiConnect );
-    parsedMsg.ui.id = get_id<UIId>( components );
+    Node node( nodeId.Value(), resource );
 
-    if ( parsedMsg.ui.id == invalid_ui_id )
+    while ( fields.HasNext() )
     {
-        throw std::runtime_error( "Invalid UI ID." );
+        const auto ioType = fields.Next();
+        if ( !ioType )
+        {
+            return ioType.Failure();
+        }
+        else if ( !fields.HasNext() )
+        {
+            return fields.FailAtEnd( ParseError::InvalidSegmentCount );
+        }
+
+        const auto ioId = get_id<IOId>( fields );
+        if ( !ioId )
+        {
+            return ioId.Failure();
+        }
+        else if ( !fields.HasNext() )
+        {
+            return fields.FailAtEnd( ParseError::InvalidSegmentCount );
+        }
+
+        const auto value = get_int( fields );
+        if ( !value )
+        {
+            return value.Failure();
+        }
+
+        const auto type = to_io_type( ioType.Value() );
+        if ( !type )
+        {
+            return fields.Fail( ParseError::InvalidIoType, ioType.Value() );
+        }
+
+        node.io.emplace_back( ioId.Value(), *type, value.Value() );
     }
 
-    return parsedMsg;
+    return node;
 }
 
-std::string remove_framing( const std::string& msg )
+ParseResult<ParsedMessage> parse_node_connect(
+    FieldReader& fields,
+    std::pmr::memory_resource* const resource )
 {
-    return msg.substr( 1, msg.size() - 2 );
+    auto node = parse_node( fields, resource );
+    if ( !node )
+    {
+        return node.Failure();
+    }
+
+    ParsedMessage parsedMsg( MessageType::NodeConnect, resource );
+    parsedMsg.node = std::move( node.Value() );
+
+    return parsedMsg;
 }
 
-ParsedMessage parse( std::string msg, const PeerType peerType )
+template<MessageType msgType>
+ParseResult<ParsedMessage> parse_update(
+    FieldReader& fields,
+    std::pmr::memory_resource* const resource )
 {
-    if ( msg.size() < minMsgSize )
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
     {
-        throw std::runtime_error( "Message is too short." );
+        return nodeId.Failure();
     }
-    else if ( !is_message_framed( msg ) )
+    else if ( nodeId.Value() == invalid_node_id )
     {
-        throw std::runtime_error( "Message is not framed correctly." );
+        return ParseFailure{ ParseError::InvalidNodeId, msgBodyOffset };
     }
-    else
-    {
-        const auto msgType = get_message_type( msg, peerType );
-        auto unframedMsg = remove_framing( msg );
-        std::vector<std::string> components;
-        boost::algorithm::split( components, unframedMsg, boost::is_any_of( "_" ) );
 
-        if ( components.empty() )
+    ParsedMessage parsedMsg( msgType, resource );
+    parsedMsg.node.id = nodeId.Value();
+
+    while ( fields.HasNext() )
+    {
+        const auto ioId = get_id<IOId>( fields );
+        if ( !ioId )
+        {
+            return ioId.Failure();
+        }
+        else if ( !fields.HasNext() )
         {
-            throw std::runtime_error( "Failed to parse message." );
+            return fields.FailAtEnd( ParseError::InvalidSegmentCount );
         }
 
-        switch ( msgType )
+        const auto value = get_int( fields );
+        if ( !value )
         {
-        case MessageType::Ack:
-        case MessageType::Nak:
-            return parse_ack( msgType, components );
-            break;
+            return value.Failure();
+        }
 
-        case MessageType::NodeConnect:
-            return parse_node_connect( components );
-            break;
+        parsedMsg.node.io.emplace_back( ioId.Value(), IOType::Existing, value.Value() );
+    }
 
-        case MessageType::NodeUpdate:
-        case MessageType::UiUpdate:
-            return parse_update( msgType, components );
-            break;
+    return parsedMsg;
+}
 
-        case MessageType::UiConnect:
-            return parse_ui_connect( components );
+ParseResult<ParsedMessage> parse_ui_connect( FieldReader& fields, std::pmr::memory_resource* )
+{
+    const auto uiId = get_id<UIId>( fields );
+    if ( !uiId )
+    {
+        return uiId.Failure();
+    }
+
+    ParsedMessage parsedMsg( MessageType::UiConnect );
+    parsedMsg.ui.id = uiId.Value();
 
-        default:
-            throw std::runtime_error( "Unhandled message type encountered." );
+    // A UI that has been connected before may follow its ID with the last change it applied.
+    if ( fields.HasNext() )
+    {
+        const auto sequence = get_uint64( fields );
+        if ( !sequence )
+        {
+            return sequence.Failure();
         }
+
+        parsedMsg.sequence = sequence.Value();
+    }
+
+    if ( fields.HasNext() )
+    {
+        return fields.FailAtNext( ParseError::InvalidSegmentCount );
     }
+    else if ( uiId.Value() == invalid_ui_id )
+    {
+        return ParseFailure{ ParseError::InvalidUiId, msgBodyOffset };
+    }
+
+    return parsedMsg;
 }
 
-std::vector<IO> parse_ios( const std::string& msg )
+ParseResult<ParsedMessage> parse_history_request(
+    FieldReader& fields,
+    std::pmr::memory_resource* )
 {
-    std::vector<IO> ioCollection;
-    std::smatch ioMatch;
-    auto mutableMsg = msg;
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+    else if ( nodeId.Value() == invalid_node_id )
+    {
+        return ParseFailure{ ParseError::InvalidNodeId, msgBodyOffset };
+    }
+
+    const auto ioId = get_id<IOId>( fields );
+    if ( !ioId )
+    {
+        return ioId.Failure();
+    }
 
-    while ( std::regex_search( mutableMsg, ioMatch, ioRegex ) )
+    const auto negativeMaxSamples = fields.FailAtNext( ParseError::InvalidInteger );
+    const auto maxSamples = get_int( fields );
+    if ( !maxSamples )
     {
-        const auto& type = ioMatch.str( 1 );
-        const auto& id = ioMatch.str( 2 );
-        const auto& value = ioMatch.str( 3 );
+        return maxSamples.Failure();
+    }
+    else if ( maxSamples.Value() < 0 )
+    {
+        return negativeMaxSamples;
+    }
 
-        const auto ioId = static_cast<IOId>( std::stoi( id ) );
-        const auto ioValue = std::stoi( value );
+    ParsedMessage parsedMsg( MessageType::HistoryRequest );
+    parsedMsg.node.id = nodeId.Value();
+    parsedMsg.history.io = ioId.Value();
+    parsedMsg.history.maxSamples = static_cast<std::uint32_t>( maxSamples.Value() );
+
+    // The time window is optional, and its end may be left out to mean the present.
+    for ( auto* const time : { &parsedMsg.history.since, &parsedMsg.history.until } )
+    {
+        if ( fields.HasNext() )
+        {
+            const auto value = get_uint64( fields );
+            if ( !value )
+            {
+                return value.Failure();
+            }
 
-        ioCollection.emplace_back( ioId, type, ioValue );
+            *time = value.Value();
+        }
+    }
 
-        mutableMsg = ioMatch.suffix();
+    if ( fields.HasNext() )
+    {
+        return fields.FailAtNext( ParseError::InvalidSegmentCount );
     }
 
-    return ioCollection;
+    return parsedMsg;
 }
 
-std::vector<Node> parse_nodes( const std::string& msg )
+ParseResult<ParsedMessage> reject_unhandled( FieldReader&, std::pmr::memory_resource* )
 {
-    std::vector<Node> nodes;
-    std::smatch nodeMatch;
-    auto mutableMsg = msg;
+    return ParseFailure{ ParseError::UnhandledMessageType, msgTypeOffset };
+}
 
-    while ( std::regex_search( mutableMsg, nodeMatch, nodeRegex ) )
+using TextDecoder = ParseResult<ParsedMessage> ( * )( FieldReader&, std::pmr::memory_resource* );
+
+// The decoders for the text messages the server receives.
+constexpr DecoderEntry<TextDecoder> textDecoderEntries[] = {
+    { 'a', &parse_ack<MessageType::Ack> },
+    { 'n', &parse_ack<MessageType::Nak> },
+    { 'c', &parse_node_connect },
+    { 'u', PeerType::Node, &parse_update<MessageType::NodeUpdate> },
+    { 'u', PeerType::UI, &parse_update<MessageType::UiUpdate> },
+    { 'g', &parse_ui_connect },
+    { 'h', PeerType::UI, &parse_history_request },
+    { 'h', PeerType::Node, &reject_unhandled },
+    { 's', &reject_unhandled },
+    { 'd', &reject_unhandled },
+    { 'q', &reject_unhandled },
+    { 'y', &reject_unhandled },
+    { 'o', &reject_unhandled } };
+
+constexpr DecoderTable<TextDecoder> textDecoders( textDecoderEntries );
+
+ParseResult<ParsedMessage> try_parse_text(
+    const std::string_view msg,
+    const PeerType peerType,
+    std::pmr::memory_resource* const resource )
+{
+    const auto body = get_message_body( msg, minMsgSize );
+    if ( !body )
     {
-        const auto& id = nodeMatch.str( 1 );
-        const auto& ioDetails = nodeMatch.str( 2 );
-
-        const auto nodeId = static_cast<NodeId>( std::stoi( id ) );
-        const auto ios = parse_ios( ioDetails );
-        nodes.emplace_back( nodeId, ios );
+        return body.Failure();
+    }
 
-        mutableMsg = nodeMatch.suffix();
+    const auto decoder = textDecoders.Find( msg[msgTypeOffset], peerType );
+    if ( decoder == nullptr )
+    {
+        return ParseFailure{ ParseError::InvalidMessageType, msgTypeOffset };
     }
 
-    return nodes;
+    FieldReader fields( msg, body.Value() );
+    return decoder( fields, resource );
 }
 
-ParsedUiMessage parse_full_state( const std::string& msg )
+bool is_digit( const char c )
 {
-    ParsedUiMessage parsedMsg{ MessageType::FullState };
-    std::smatch fullStateMatch;
+    return c >= '0' && c <= '9';
+}
 
-    if ( msg == emptyFullStateMsg )
+/*!
+    @brief Single pass reader for the body of a FullState message, which has the form
+           (_n_<id>(_<type>_<id>_<value>)*)+ where each type is one of "di", "do", "ai" or "ao".
+ */
+class FullStateReader
+{
+public:
+    /*!
+        @param[in] body The body of the message.
+        @param[in] bodyOffset The offset of the body in the message, which failures are reported
+                   relative to.
+     */
+    FullStateReader( const std::string_view body, const std::size_t bodyOffset )
+        : m_body( body )
+        , m_bodyOffset( bodyOffset )
+        , m_scanner( body )
+        , m_pos( 0 )
+    {}
+
+    bool AtEnd() const
     {
-        return parsedMsg;
+        return m_pos == m_body.size();
     }
-    else if ( std::regex_match( msg, fullStateMatch, fullStateRegex ) )
+
+    /*!
+        @brief Returns true if the reader is positioned at the start of a node.
+     */
+    bool AtNode() const
     {
-        parsedMsg.nodes = parse_nodes( msg );
-        return parsedMsg;
+        return m_body.compare( m_pos, fullStateNodeHeader.size(), fullStateNodeHeader ) == 0 &&
+               m_pos + fullStateNodeHeader.size() < m_body.size() &&
+               is_digit( m_body[m_pos + fullStateNodeHeader.size()] );
     }
-    else
+
+    /*!
+        @brief Reads the ID of the node at the current position. Must only be called if AtNode()
+               returns true.
+     */
+    ParseResult<NodeId> ReadNodeId()
     {
-        throw std::runtime_error( "Failed to parse full state message." );
+        m_pos += fullStateNodeHeader.size();
+
+        const auto id = ReadNumber();
+        if ( !id )
+        {
+            return id.Failure();
+        }
+
+        return static_cast<NodeId>( id.Value() );
     }
-}
 
-ParsedUiMessage parse_node_connect( const std::string& msg )
+    /*!
+        @brief Reads an IO and appends it to the provided node.
+     */
+    std::optional<ParseFailure> ReadIO( Node& node )
+    {
+        if ( const auto failure = ReadSeparator() )
+        {
+            return failure;
+        }
+
+        const auto type = to_io_type( m_body.substr( m_pos, ioTypeSize ) );
+        if ( !type )
+        {
+            return Fail( ParseError::InvalidIoType );
+        }
+
+        m_pos += ioTypeSize;
+
+        if ( const auto failure = ReadSeparator() )
+        {
+            return failure;
+        }
+
+        const auto id = ReadNumber();
+        if ( !id )
+        {
+            return id.Failure();
+        }
+        else if ( const auto failure = ReadSeparator() )
+        {
+            return failure;
+        }
+
+        const auto value = ReadNumber();
+        if ( !value )
+        {
+            return value.Failure();
+        }
+
+        node.io.emplace_back( static_cast<IOId>( id.Value() ), *type, value.Value() );
+        return std::nullopt;
+    }
+
+    /*!
+        @brief Returns a failure located at the current position.
+     */
+    ParseFailure Fail( const ParseError error ) const
+    {
+        return { error, m_bodyOffset + m_pos };
+    }
+
+private:
+    std::optional<ParseFailure> ReadSeparator()
+    {
+        if ( m_pos == m_body.size() || m_body[m_pos] != fieldSeparator )
+        {
+            return Fail( ParseError::MissingSeparator );
+        }
+
+        ++m_pos;
+        return std::nullopt;
+    }
+
+    ParseResult<int> ReadNumber()
+    {
+        const auto end = m_scanner.SkipDigits( m_pos );
+        const char* const first = m_body.data() + m_pos;
+        const char* const last = m_body.data() + end;
+        int value = 0;
+
+        if ( first == last || std::from_chars( first, last, value ).ec != std::errc() )
+        {
+            return Fail( ParseError::InvalidInteger );
+        }
+
+        m_pos = end;
+        return value;
+    }
+
+private:
+    const std::string_view m_body;
+    const std::size_t m_bodyOffset;
+    DelimiterScanner m_scanner;
+    std::size_t m_pos;
+};
+
+std::optional<ParseFailure> try_parse_full_state(
+    const std::string_view msg,
+    const std::function<void( Node&& )>& onNode )
 {
-    auto unframedMsg = remove_framing( msg );
-    std::vector<std::string> components;
-    boost::algorithm::split( components, unframedMsg, boost::is_any_of( "_" ) );
+    if ( msg == emptyFullStateMsg )
+    {
+        return std::nullopt;
+    }
+    else if ( msg.size() < minUiMsgSize )
+    {
+        return ParseFailure{ ParseError::TooShort, msg.size() };
+    }
+    else if ( msg.front() != startOfMsg )
+    {
+        return ParseFailure{ ParseError::InvalidFraming, 0 };
+    }
+    else if ( msg.compare( 0, fullStateHeader.size(), fullStateHeader ) != 0 )
+    {
+        return ParseFailure{ ParseError::InvalidMessageType, msgTypeOffset };
+    }
+    else if ( msg.back() != endOfMsg )
+    {
+        return ParseFailure{ ParseError::InvalidFraming, msg.size() - 1 };
+    }
 
-    if ( components.empty() )
+    FullStateReader reader(
+        msg.substr( fullStateHeader.size(), msg.size() - fullStateHeader.size() - 1 ),
+        fullStateHeader.size() );
+    if ( !reader.AtNode() )
     {
-        throw std::runtime_error( "Failed to parse message." );
+        return reader.Fail( ParseError::MissingNode );
     }
-    else if ( ( components.size() - 2 ) % 3 != 0 )
+
+    auto nodeId = reader.ReadNodeId();
+    if ( !nodeId )
     {
-        throw std::runtime_error( "Invalid number of segments for node connect message." );
+        return nodeId.Failure();
     }
 
-    ParsedUiMessage parsedMsg{ MessageType::NodeConnect };
-    Node node = Node();
-    node.id = get_id<NodeId>( components );
+    Node node( nodeId.Value() );
 
-    if ( node.id == invalid_node_id )
+    while ( !reader.AtEnd() )
     {
-        throw std::runtime_error( "Invalid Node ID." );
+        if ( reader.AtNode() )
+        {
+            onNode( std::move( node ) );
+
+            nodeId = reader.ReadNodeId();
+            if ( !nodeId )
+            {
+                return nodeId.Failure();
+            }
+
+            node = Node( nodeId.Value() );
+        }
+        else if ( const auto failure = reader.ReadIO( node ) )
+        {
+            return failure;
+        }
     }
 
-    for ( std::size_t segmentNum = 2; segmentNum < components.size(); segmentNum += 3 )
+    onNode( std::move( node ) );
+    return std::nullopt;
+}
+
+ParseResult<ParsedUiMessage> parse_node_connect_for_ui( FieldReader& fields )
+{
+    auto node = parse_node( fields, std::pmr::get_default_resource() );
+    if ( !node )
     {
-        const auto& ioType = components.at( segmentNum );
-        const auto ioId = static_cast<IOId>( std::stoi( components.at( segmentNum + 1 ) ) );
-        const auto value = std::stoi( components.at( segmentNum + 2 ) );
-        node.io.emplace_back( ioId, ioType, value );
+        return node.Failure();
     }
 
-    parsedMsg.nodes.push_back( node );
-    return parsedMsg;
+    return ParsedUiMessage{ MessageType::NodeConnect, { std::move( node.Value() ) } };
 }
 
-ParsedUiMessage parse_node_disconnect( const std::string& msg )
+template<MessageType msgType>
+ParseResult<ParsedUiMessage> parse_node_id_message( FieldReader& fields )
 {
-    auto unframedMsg = remove_framing( msg );
-    std::vector<std::string> components;
-    boost::algorithm::split( components, unframedMsg, boost::is_any_of( "_" ) );
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
+    {
+        return nodeId.Failure();
+    }
+    else if ( const auto failure = fields.Skip() )
+    {
+        return *failure;
+    }
 
-    if ( components.empty() )
+    return ParsedUiMessage{ msgType, { Node{ nodeId.Value() } } };
+}
+
+ParseResult<ParsedUiMessage> parse_node_update_for_ui( FieldReader& fields )
+{
+    auto parsedNodeMsg =
+        parse_update<MessageType::NodeUpdate>( fields, std::pmr::get_default_resource() );
+    if ( !parsedNodeMsg )
     {
-        throw std::runtime_error( "Failed to parse message." );
+        return parsedNodeMsg.Failure();
     }
 
-    return { MessageType::NodeDisconnect, { Node{ get_id<NodeId>( components ) } } };
+    return ParsedUiMessage{ MessageType::NodeUpdate, { std::move( parsedNodeMsg.Value().node ) } };
 }
 
-ParsedUiMessage parse_node_update_for_ui( const std::string& msg )
+ParseResult<ParsedUiMessage> parse_full_state_for_ui( FieldReader& fields )
 {
-    auto unframedMsg = remove_framing( msg );
-    std::vector<std::string> components;
-    boost::algorithm::split( components, unframedMsg, boost::is_any_of( "_" ) );
+    ParsedUiMessage parsedMsg{ MessageType::FullState, {} };
+    const auto failure = try_parse_full_state(
+        fields.Message(),
+        [&parsedMsg]( Node&& node ) { parsedMsg.nodes.push_back( std::move( node ) ); } );
 
-    if ( components.empty() )
+    if ( failure )
     {
-        throw std::runtime_error( "Failed to parse message." );
+        return *failure;
     }
 
-    const auto parsedNodeMsg = parse_update( MessageType::NodeUpdate, components );
-    return { MessageType::NodeUpdate, { parsedNodeMsg.node } };
+    return parsedMsg;
 }
 
-ParsedUiMessage parse_ui_message( std::string msg )
+ParseResult<ParsedUiMessage> parse_sequence_for_ui( FieldReader& fields )
 {
-    if ( msg.size() < minUiMsgSize )
+    const auto sequence = get_uint64( fields );
+    if ( !sequence )
     {
-        throw std::runtime_error( "Message is too short." );
+        return sequence.Failure();
     }
-    else if ( !is_message_framed( msg ) )
+    else if ( fields.HasNext() )
     {
-        throw std::runtime_error( "Message is not framed correctly." );
+        return fields.FailAtNext( ParseError::InvalidSegmentCount );
     }
-    else
+
+    ParsedUiMessage parsedMsg{ MessageType::Sequence, {} };
+    parsedMsg.sequence = sequence.Value();
+    return parsedMsg;
+}
+
+ParseResult<ParsedUiMessage> parse_history( FieldReader& fields )
+{
+    const auto nodeId = get_id<NodeId>( fields );
+    if ( !nodeId )
     {
-        const auto msgType = get_message_type( msg, PeerType::Node );
+        return nodeId.Failure();
+    }
 
-        if ( msgType == MessageType::FullState )
-        {
-            return parse_full_state( msg );
-        }
-        else if ( msgType == MessageType::NodeConnect )
-        {
-            return parse_node_connect( msg );
-        }
-        else if ( msgType == MessageType::NodeDisconnect )
+    const auto ioId = get_id<IOId>( fields );
+    if ( !ioId )
+    {
+        return ioId.Failure();
+    }
+
+    ParsedUiMessage parsedMsg{ MessageType::History, { Node{ nodeId.Value() } } };
+    parsedMsg.historyIO = ioId.Value();
+
+    while ( fields.HasNext() )
+    {
+        const auto time = get_uint64( fields );
+        if ( !time )
         {
-            return parse_node_disconnect( msg );
+            return time.Failure();
         }
-        else if ( msgType == MessageType::NodeUpdate )
+        else if ( !fields.HasNext() )
         {
-            return parse_node_update_for_ui( msg );
+            return fields.FailAtEnd( ParseError::InvalidSegmentCount );
         }
-        else
+
+        const auto value = get_int( fields );
+        if ( !value )
         {
-            throw std::runtime_error( "Unhandled message type encountered." );
+            return value.Failure();
         }
+
+        parsedMsg.history.push_back( HistorySample{ time.Value(), value.Value() } );
+    }
+
+    return parsedMsg;
+}
+
+ParseResult<ParsedUiMessage> reject_unhandled_for_ui( FieldReader& )
+{
+    return ParseFailure{ ParseError::UnhandledMessageType, msgTypeOffset };
+}
+
+using UiTextDecoder = ParseResult<ParsedUiMessage> ( * )( FieldReader& );
+
+// The decoders for the text messages the server sends to UIs.
+constexpr DecoderEntry<UiTextDecoder> uiTextDecoderEntries[] = {
+    { 's', &parse_full_state_for_ui },
+    { 'c', &parse_node_connect_for_ui },
+    { 'd', &parse_node_id_message<MessageType::NodeDisconnect> },
+    { 'o', &parse_node_id_message<MessageType::NodeStale> },
+    { 'u', &parse_node_update_for_ui },
+    { 'q', &parse_sequence_for_ui },
+    { 'y', &parse_history },
+    { 'a', &reject_unhandled_for_ui },
+    { 'n', &reject_unhandled_for_ui },
+    { 'g', &reject_unhandled_for_ui },
+    { 'h', &reject_unhandled_for_ui } };
+
+constexpr DecoderTable<UiTextDecoder> uiTextDecoders( uiTextDecoderEntries );
+
+ParseResult<ParsedUiMessage> try_parse_text_ui_message( const std::string_view msg )
+{
+    const auto body = get_message_body( msg, minUiMsgSize );
+    if ( !body )
+    {
+        return body.Failure();
+    }
+
+    const auto decoder = uiTextDecoders.Find( msg[msgTypeOffset], PeerType::Node );
+    if ( decoder == nullptr )
+    {
+        return ParseFailure{ ParseError::InvalidMessageType, msgTypeOffset };
+    }
+
+    FieldReader fields( msg, body.Value() );
+    return decoder( fields );
+}
+
+ParseResult<ParsedMessage> try_parse(
+    const std::string_view msg,
+    const PeerType peerType,
+    const WireFormat format,
+    std::pmr::memory_resource* const resource )
+{
+    return format == WireFormat::Binary ? try_parse_binary( msg, peerType, resource )
+                                        : try_parse_text( msg, peerType, resource );
+}
+
+ParseResult<ParsedUiMessage> try_parse_ui_message(
+    const std::string_view msg,
+    const WireFormat format )
+{
+    return format == WireFormat::Binary ? try_parse_binary_ui_message( msg )
+                                        : try_parse_text_ui_message( msg );
+}
+
+[[noreturn]] void throw_parse_failure( const ParseFailure& failure )
+{
+    throw std::runtime_error(
+        std::string( to_string( failure.error ) ) + " at byte " +
+        std::to_string( failure.offset ) + '.' );
+}
+
+/*!
+    @brief Unwraps the result of one of the non-throwing parse functions.
+    @throws std::runtime_error describing the failure if parsing failed.
+ */
+template<typename T>
+T value_or_throw( ParseResult<T>&& result )
+{
+    if ( !result )
+    {
+        throw_parse_failure( result.Failure() );
+    }
+
+    return std::move( result.Value() );
+}
+
+ParsedMessage parse( const std::string_view msg, const PeerType peerType )
+{
+    return value_or_throw( try_parse( msg, peerType ) );
+}
+
+ParsedUiMessage parse_ui_message( const std::string_view msg )
+{
+    return value_or_throw( try_parse_ui_message( msg ) );
+}
+
+ParsedMessage parse( const std::string_view msg, const PeerType peerType, const WireFormat format )
+{
+    return value_or_throw( try_parse( msg, peerType, format ) );
+}
+
+ParsedUiMessage parse_ui_message( const std::string_view msg, const WireFormat format )
+{
+    return value_or_throw( try_parse_ui_message( msg, format ) );
+}
+
+void parse_full_state( const std::string_view msg, const std::function<void( Node&& )>& onNode )
+{
+    if ( const auto failure = try_parse_full_state( msg, onNode ) )
+    {
+        throw_parse_failure( *failure );
     }
 }
 
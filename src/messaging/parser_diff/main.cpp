@@ -0,0 +1,259 @@
+#include "message_generator.hpp"
+#include "regex_parser.hpp"
+#include "io_types.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace
+{
+
+const std::size_t defaultMessageCount = 200000;
+
+using Description = std::optional<std::string>;
+
+std::string DescribeType( const std::string& type )
+{
+    return type;
+}
+
+std::string DescribeType( const sn::IOType type )
+{
+    return std::string( sn::to_string( type ) );
+}
+
+/*!
+    @brief Describes a node decoded by either parser the same way, so that the two can be compared.
+ */
+template<typename NodeType>
+std::string DescribeNode( const NodeType& node )
+{
+    std::string description = std::to_string( static_cast<int>( node.id ) ) + "[";
+    for ( const auto& io : node.io )
+    {
+        description += std::to_string( static_cast<int>( io.id ) ) + ":" +
+                       DescribeType( io.type ) + ":" + std::to_string( io.value ) + ",";
+    }
+
+    return description + "]";
+}
+
+/*!
+    @brief Returns true if the regex parser accepted IO types that the text parser rejects, as it
+           accepted any two or more characters. Updates mark their IOs as Existing.
+ */
+template<typename NodeType>
+bool HasUnknownIOTypes( const NodeType& node, const bool isUpdate )
+{
+    return std::any_of( node.io.begin(), node.io.end(), [isUpdate]( const auto& io ) {
+        return io.type != "di" && io.type != "do" && io.type != "ai" && io.type != "ao" &&
+               !( isUpdate && io.type == "Existing" );
+    } );
+}
+
+Description ParseWithRegex( const std::string& msg, const sn::PeerType peerType )
+{
+    try
+    {
+        const auto parsed = sn::parser_diff::regex_parser::parse( msg, peerType );
+        const auto isUpdate = parsed.type == sn::MessageType::NodeUpdate ||
+                              parsed.type == sn::MessageType::UiUpdate;
+        if ( HasUnknownIOTypes( parsed.node, isUpdate ) )
+        {
+            return std::nullopt;
+        }
+
+        return static_cast<char>( parsed.type ) + DescribeNode( parsed.node ) + "/" +
+               std::to_string( static_cast<int>( parsed.ui ) );
+    }
+    catch ( const std::exception& )
+    {
+        return std::nullopt;
+    }
+}
+
+Description ParseWithText( const std::string& msg, const sn::PeerType peerType )
+{
+    const auto result = sn::try_parse( msg, peerType );
+    if ( !result )
+    {
+        return std::nullopt;
+    }
+
+    // The regex parser predates HistoryRequests and the sequence number of a UiConnect, so it
+    // rejects them.
+    const auto& parsed = result.Value();
+    if ( parsed.type == sn::MessageType::HistoryRequest ||
+         ( parsed.type == sn::MessageType::UiConnect &&
+           std::count( msg.begin(), msg.end(), '_' ) > 1 ) )
+    {
+        return std::nullopt;
+    }
+
+    return static_cast<char>( parsed.type ) + DescribeNode( parsed.node ) + "/" +
+           std::to_string( static_cast<int>( parsed.ui.id ) );
+}
+
+Description ParseUiWithRegex( const std::string& msg )
+{
+    try
+    {
+        const auto parsed = sn::parser_diff::regex_parser::parse_ui_message( msg );
+        std::string description( 1, static_cast<char>( parsed.type ) );
+        for ( const auto& node : parsed.nodes )
+        {
+            if ( HasUnknownIOTypes( node, parsed.type == sn::MessageType::NodeUpdate ) )
+            {
+                return std::nullopt;
+            }
+
+            description += DescribeNode( node );
+        }
+
+        return description;
+    }
+    catch ( const std::exception& )
+    {
+        return std::nullopt;
+    }
+}
+
+Description ParseUiWithText( const std::string& msg )
+{
+    const auto result = sn::try_parse_ui_message( msg );
+
+    // The regex parser predates Sequences, Histories and NodeStales, so it rejects them.
+    if ( !result || result.Value().type == sn::MessageType::Sequence ||
+         result.Value().type == sn::MessageType::History ||
+         result.Value().type == sn::MessageType::NodeStale )
+    {
+        return std::nullopt;
+    }
+
+    std::string description( 1, static_cast<char>( result.Value().type ) );
+    for ( const auto& node : result.Value().nodes )
+    {
+        description += DescribeNode( node );
+    }
+
+    return description;
+}
+
+/*!
+    @brief Prints a message the parsers disagree on, escaping any character that is not printable.
+ */
+void PrintMismatch(
+    const std::string& parser,
+    const std::string& msg,
+    const Description& text,
+    const Description& regex )
+{
+    std::cout << "Mismatch in " << parser << " for \"";
+    for ( const auto c : msg )
+    {
+        if ( c >= ' ' && c <= '~' )
+        {
+            std::cout << c;
+        }
+        else
+        {
+            std::cout << "\\x" << std::hex << static_cast<int>( static_cast<unsigned char>( c ) )
+                      << std::dec;
+        }
+    }
+
+    std::cout << "\"\n  text:  " << text.value_or( "rejected" )
+              << "\n  regex: " << regex.value_or( "rejected" ) << '\n';
+}
+
+void PrintUsage()
+{
+    std::cout << "Usage: parser_diff [--messages <count>] [--seed <seed>]\n"
+              << "  Checks that the text parser decodes generated messages exactly as the regex\n"
+              << "  parser it replaced did, and rejects the same ones.\n"
+              << "  --messages  How many messages to generate. Defaults to "
+              << defaultMessageCount << ".\n"
+              << "  --seed      Seeds the generator. Defaults to 1.\n";
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+    std::size_t messageCount = defaultMessageCount;
+    std::uint32_t seed = 1;
+
+    for ( int index = 1; index < argc; ++index )
+    {
+        const std::string arg( argv[index] );
+
+        if ( arg == "--messages" && index + 1 < argc )
+        {
+            messageCount = std::strtoul( argv[++index], nullptr, 10 );
+        }
+        else if ( arg == "--seed" && index + 1 < argc )
+        {
+            seed = static_cast<std::uint32_t>( std::strtoul( argv[++index], nullptr, 10 ) );
+        }
+        else
+        {
+            PrintUsage();
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    sn::parser_diff::MessageGenerator generator( seed );
+    std::size_t accepted = 0;
+    std::size_t acceptedByUi = 0;
+
+    for ( std::size_t count = 0; count < messageCount; ++count )
+    {
+        const auto msg = generator.Next();
+
+        for ( const auto peerType : { sn::PeerType::Node, sn::PeerType::UI } )
+        {
+            const auto text = ParseWithText( msg, peerType );
+            const auto regex = ParseWithRegex( msg, peerType );
+            if ( text != regex )
+            {
+                PrintMismatch(
+                    peerType == sn::PeerType::Node ? "parse() from a node" : "parse() from a UI",
+                    msg,
+                    text,
+                    regex );
+                return EXIT_FAILURE;
+            }
+
+            if ( text )
+            {
+                ++accepted;
+            }
+        }
+
+        const auto text = ParseUiWithText( msg );
+        const auto regex = ParseUiWithRegex( msg );
+        if ( text != regex )
+        {
+            PrintMismatch( "parse_ui_message()", msg, text, regex );
+            return EXIT_FAILURE;
+        }
+
+        if ( text )
+        {
+            ++acceptedByUi;
+        }
+    }
+
+    std::cout << "The parsers agree on " << messageCount << " messages, of which parse() accepted "
+              << accepted << " from nodes and UIs and parse_ui_message() accepted "
+              << acceptedByUi << ".\n";
+
+    return EXIT_SUCCESS;
+}
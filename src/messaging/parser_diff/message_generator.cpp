@@ -0,0 +1,204 @@
+#include "message_generator.hpp"
+
+#include <array>
+#include <iterator>
+
+namespace sn::parser_diff
+{
+
+namespace
+{
+
+// Fields that either parser may decode differently: signs, whitespace and trailing junk that
+// std::stoi skips or stops at, values at and past the limits of an int, and characters the
+// framing or the regexes treat specially.
+const std::array<const char*, 31> fields{
+    "0", "1", "7", "42", "-3", "+5", " 9", "\t4", "12abc", "x", "", "+", " ", "+-1", "--1",
+    "++1", "99999999999", "2147483647", "-2147483648", "2147483648", "di", "do", "ai", "ao",
+    "n", "s", "u", "\n1", "1\r", "\v2", "\x80" };
+
+const std::array<const char*, 7> connectIOTypes{ "di", "do", "ai", "ao", "x", "", "Existing" };
+
+const std::array<const char*, 10> fullStateIOTypes{
+    "di", "do", "ai", "ao", "n_", "_a", "xn", "12", "__", "a" };
+
+const std::string structuredTypes( "cuagnd" );
+const std::string anyTypes( "cuagnsdvx_1<>" );
+const std::string mutations( "<>_n\n0-" );
+
+} // namespace
+
+MessageGenerator::MessageGenerator( const std::uint32_t seed )
+    : m_random( seed )
+{}
+
+std::string MessageGenerator::Next()
+{
+    auto msg = Random( 2 ) == 0 ? MakeStructured() : MakeFields();
+    if ( Random( 4 ) == 0 )
+    {
+        Mutate( msg );
+    }
+
+    return msg;
+}
+
+int MessageGenerator::Random( const int count )
+{
+    return std::uniform_int_distribution<int>( 0, count - 1 )( m_random );
+}
+
+template<typename Container>
+auto MessageGenerator::Pick( const Container& items )
+{
+    return items[static_cast<std::size_t>( Random( static_cast<int>( std::size( items ) ) ) )];
+}
+
+std::string MessageGenerator::MakeField()
+{
+    return Pick( fields );
+}
+
+std::string MessageGenerator::MakeNumber()
+{
+    return Random( 8 ) == 0 ? MakeField() : std::to_string( Random( 2000 ) );
+}
+
+std::string MessageGenerator::MakeStructured()
+{
+    const auto type = Pick( structuredTypes );
+
+    std::string msg = "<";
+    msg += type;
+    msg += "_" + MakeNumber();
+
+    const auto ioCount = Random( 6 );
+    for ( int index = 0; index < ioCount; ++index )
+    {
+        if ( type == 'c' || type == 'd' )
+        {
+            msg += "_";
+            msg += Pick( connectIOTypes );
+        }
+
+        msg += "_" + MakeNumber();
+        if ( Random( 10 ) != 0 )
+        {
+            msg += "_" + MakeNumber();
+        }
+    }
+
+    if ( Random( 15 ) == 0 )
+    {
+        msg += "_";
+    }
+
+    return msg + ">";
+}
+
+std::string MessageGenerator::MakeFullState()
+{
+    std::string msg = "<s";
+    const auto nodeCount = Random( 4 );
+    if ( nodeCount == 0 && Random( 2 ) == 0 )
+    {
+        msg += "_";
+    }
+
+    for ( int node = 0; node < nodeCount; ++node )
+    {
+        msg += "_n_" + std::to_string( Random( 5 ) );
+
+        const auto ioCount = Random( 4 );
+        for ( int io = 0; io < ioCount; ++io )
+        {
+            msg += "_";
+            msg += Pick( fullStateIOTypes );
+            msg += "_" + ( Random( 10 ) == 0 ? MakeField() : std::to_string( Random( 300 ) ) );
+            msg += "_" + ( Random( 10 ) == 0 ? MakeField() : std::to_string( Random( 300 ) ) );
+        }
+    }
+
+    if ( Random( 20 ) == 0 )
+    {
+        msg += MakeField();
+    }
+
+    return msg + ">";
+}
+
+std::string MessageGenerator::MakeFields()
+{
+    std::string msg;
+    if ( Random( 20 ) != 0 )
+    {
+        msg += '<';
+    }
+
+    msg += Pick( anyTypes );
+    if ( msg == "<s" && Random( 2 ) == 0 )
+    {
+        return MakeFullState();
+    }
+
+    if ( Random( 20 ) != 0 )
+    {
+        msg += '_';
+    }
+
+    const auto fieldCount = Random( 3 ) == 0 ? Random( 3 ) : Random( 12 );
+    for ( int index = 0; index < fieldCount; ++index )
+    {
+        if ( index != 0 )
+        {
+            msg += Random( 30 ) != 0 ? "_" : ( Random( 2 ) == 0 ? "__" : "" );
+        }
+
+        msg += MakeField();
+    }
+
+    if ( Random( 20 ) != 0 )
+    {
+        msg += '>';
+    }
+
+    return msg;
+}
+
+void MessageGenerator::Mutate( std::string& msg )
+{
+    const auto editCount = 1 + Random( 3 );
+    for ( int edit = 0; edit < editCount; ++edit )
+    {
+        const auto at = static_cast<std::size_t>( Random( static_cast<int>( msg.size() ) + 1 ) );
+        const auto c = Pick( mutations );
+
+        switch ( Random( 4 ) )
+        {
+        case 0:
+            msg.insert( msg.begin() + static_cast<std::ptrdiff_t>( at ), c );
+            break;
+
+        case 1:
+            if ( at < msg.size() )
+            {
+                msg.erase( at, 1 );
+            }
+            break;
+
+        case 2:
+            if ( at < msg.size() )
+            {
+                msg[at] = c;
+            }
+            break;
+
+        default:
+            // Repeats a few characters, e.g. a field and the separator after it.
+            msg.insert( at, msg.substr( at, static_cast<std::size_t>( Random( 6 ) ) ) );
+            break;
+        }
+    }
+}
+
+} // namespace sn::parser_diff
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace sn::parser_diff
+{
+
+/*!
+    @brief Generates reproducible text messages to feed both parsers. Most are close to messages
+           the parsers accept, with fields that test the edges of integer decoding, and the rest
+           are mutated or made up of arbitrary fields.
+ */
+class MessageGenerator final
+{
+public:
+    explicit MessageGenerator( const std::uint32_t seed );
+
+    /*!
+        @brief Generates the next message.
+     */
+    std::string Next();
+
+private:
+    //! Returns a number in [0, count).
+    int Random( const int count );
+
+    //! Returns one of the items at random.
+    template<typename Container>
+    auto Pick( const Container& items );
+
+    //! Returns one of the fields listed, many of which are malformed.
+    std::string MakeField();
+
+    //! Returns a well formed number most of the time, otherwise any field.
+    std::string MakeNumber();
+
+    //! Returns a NodeConnect, NodeUpdate, Ack, UiConnect, Nak or NodeDisconnect.
+    std::string MakeStructured();
+
+    //! Returns a FullState of up to a few nodes.
+    std::string MakeFullState();
+
+    //! Returns a message of arbitrary fields, mostly framed.
+    std::string MakeFields();
+
+    //! Inserts, removes, replaces or repeats a few characters of the message.
+    void Mutate( std::string& msg );
+
+private:
+    std::mt19937 m_random;
+};
+
+} // namespace sn::parser_diff
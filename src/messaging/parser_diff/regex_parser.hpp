@@ -0,0 +1,56 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+#include "messages.hpp"
+
+#include <string>
+#include <vector>
+
+/*!
+    @brief The regex based text parser that the single pass parser replaced, kept as the reference
+           it is checked against. Only the types it decodes into differ from the original: IO
+           types are kept as the text that appeared in the message, since it accepted any.
+ */
+namespace sn::parser_diff::regex_parser
+{
+
+struct IO
+{
+    IOId id;
+    std::string type;
+    int value;
+};
+
+struct Node
+{
+    NodeId id = invalid_node_id;
+    std::vector<IO> io;
+};
+
+struct ParsedMessage
+{
+    MessageType type;
+    Node node;
+    UIId ui = invalid_ui_id;
+};
+
+struct ParsedUiMessage
+{
+    MessageType type;
+    std::vector<Node> nodes;
+};
+
+/*!
+    @brief Decodes a message received by the server.
+    @throws std::exception if the message is rejected.
+ */
+ParsedMessage parse( const std::string& msg, const PeerType peerType );
+
+/*!
+    @brief Decodes a message received by a UI.
+    @throws std::exception if the message is rejected.
+ */
+ParsedUiMessage parse_ui_message( const std::string& msg );
+
+} // namespace sn::parser_diff::regex_parser
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sn
+{
+
+const std::size_t maxVarintSize = 5;
+const std::size_t maxVarint64Size = 10;
+
+/*!
+    @brief Appends an unsigned LEB128 encoding of the value.
+ */
+inline void PutVarint( std::string& out, std::uint32_t value )
+{
+    while ( value >= 0x80 )
+    {
+        out.push_back( static_cast<char>( ( value & 0x7F ) | 0x80 ) );
+        value >>= 7;
+    }
+
+    out.push_back( static_cast<char>( value ) );
+}
+
+/*!
+    @brief Returns the number of bytes PutVarint() writes for the value.
+ */
+inline std::size_t VarintSize( std::uint32_t value )
+{
+    std::size_t size = 1;
+    while ( value >= 0x80 )
+    {
+        value >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+/*!
+    @brief The 64-bit equivalents of PutVarint() and VarintSize(), for sequence numbers.
+ */
+inline void PutVarint64( std::string& out, std::uint64_t value )
+{
+    while ( value >= 0x80 )
+    {
+        out.push_back( static_cast<char>( ( value & 0x7F ) | 0x80 ) );
+        value >>= 7;
+    }
+
+    out.push_back( static_cast<char>( value ) );
+}
+
+inline std::size_t VarintSize64( std::uint64_t value )
+{
+    std::size_t size = 1;
+    while ( value >= 0x80 )
+    {
+        value >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+/*!
+    @brief Decodes an unsigned LEB128 value starting at pos and advances pos past it.
+    @returns An empty optional if the data ends before the value does or the value does not fit in
+             32 bits.
+ */
+inline std::optional<std::uint32_t> GetVarint( const std::string_view data, std::size_t& pos )
+{
+    std::uint32_t value = 0;
+
+    for ( std::size_t index = 0; index < maxVarintSize && pos + index < data.size(); ++index )
+    {
+        const auto byte = static_cast<std::uint8_t>( data[pos + index] );
+
+        // The fifth byte may only carry the top four bits of a 32-bit value.
+        if ( index == maxVarintSize - 1 && byte > 0x0F )
+        {
+            return std::nullopt;
+        }
+
+        value |= static_cast<std::uint32_t>( byte & 0x7F ) << ( 7 * index );
+
+        if ( ( byte & 0x80 ) == 0 )
+        {
+            pos += index + 1;
+            return value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+/*!
+    @brief The 64-bit equivalent of GetVarint().
+    @returns An empty optional if the data ends before the value does or the value does not fit in
+             64 bits.
+ */
+inline std::optional<std::uint64_t> GetVarint64( const std::string_view data, std::size_t& pos )
+{
+    std::uint64_t value = 0;
+
+    for ( std::size_t index = 0; index < maxVarint64Size && pos + index < data.size(); ++index )
+    {
+        const auto byte = static_cast<std::uint8_t>( data[pos + index] );
+
+        // The tenth byte may only carry the top bit of a 64-bit value.
+        if ( index == maxVarint64Size - 1 && byte > 0x01 )
+        {
+            return std::nullopt;
+        }
+
+        value |= static_cast<std::uint64_t>( byte & 0x7F ) << ( 7 * index );
+
+        if ( ( byte & 0x80 ) == 0 )
+        {
+            pos += index + 1;
+            return value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+/*!
+    @brief Maps signed values onto unsigned ones so that small negative numbers stay small.
+ */
+inline std::uint32_t ZigZagEncode( const int value )
+{
+    return ( static_cast<std::uint32_t>( value ) << 1 ) ^ static_cast<std::uint32_t>( value >> 31 );
+}
+
+inline int ZigZagDecode( const std::uint32_t value )
+{
+    return static_cast<int>( ( value >> 1 ) ^ ( ~( value & 1 ) + 1 ) );
+}
+
+} // namespace sn
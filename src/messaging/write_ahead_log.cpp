@@ -0,0 +1,207 @@
+#include "write_ahead_log.hpp"
+#include "binary_protocol.hpp"
+
+#include <array>
+#include <cstring>
+#include <optional>
+
+namespace sn
+{
+
+constexpr std::array<char, 8> walMagic = { 'S', 'N', 'W', 'A', 'L', '\0', '\0', '\0' };
+constexpr std::uint32_t walLayoutVersion = 1;
+
+// The length and checksum that precede the body of every record.
+constexpr std::size_t walRecordPrefixSize = 8;
+
+// The time and source at the start of the body of every record.
+constexpr std::size_t walRecordFieldsSize = 9;
+
+constexpr std::array<std::uint32_t, 256> MakeCrcTable()
+{
+    std::array<std::uint32_t, 256> table{};
+    for ( std::uint32_t index = 0; index < table.size(); ++index )
+    {
+        auto crc = index;
+        for ( int bit = 0; bit < 8; ++bit )
+        {
+            crc = ( crc & 1 ) != 0 ? 0xEDB88320u ^ ( crc >> 1 ) : crc >> 1;
+        }
+
+        table[index] = crc;
+    }
+
+    return table;
+}
+
+constexpr auto crcTable = MakeCrcTable();
+
+/*!
+    @brief Returns the CRC-32 of the data, as used by zlib and PNG.
+ */
+std::uint32_t Crc32( const std::string_view data )
+{
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for ( const auto c : data )
+    {
+        crc = crcTable[( crc ^ static_cast<std::uint8_t>( c ) ) & 0xFFu] ^ ( crc >> 8 );
+    }
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template<typename Number>
+void PutNumber( std::string& out, const Number value )
+{
+    char bytes[sizeof( Number )];
+    std::memcpy( bytes, &value, sizeof( Number ) );
+    out.append( bytes, sizeof( Number ) );
+}
+
+template<typename Number>
+void SetNumber( std::string& out, const std::size_t offset, const Number value )
+{
+    std::memcpy( out.data() + offset, &value, sizeof( Number ) );
+}
+
+template<typename Number>
+Number GetNumber( const std::string_view data, const std::size_t offset )
+{
+    Number value;
+    std::memcpy( &value, data.data() + offset, sizeof( Number ) );
+    return value;
+}
+
+void WriteWalHeader( std::string& out )
+{
+    out.append( walMagic.data(), walMagic.size() );
+    PutNumber( out, walLayoutVersion );
+    PutNumber( out, std::uint32_t{ 0 } );
+}
+
+bool IsWalHeader( const std::string_view data )
+{
+    return data.size() >= walHeaderSize &&
+           data.compare( 0, walMagic.size(), walMagic.data(), walMagic.size() ) == 0 &&
+           GetNumber<std::uint32_t>( data, walMagic.size() ) == walLayoutVersion;
+}
+
+void AppendWalRecord( std::string& out, const ParsedMessage& msg, const Timestamp time )
+{
+    // UiUpdate has the same encoding as NodeUpdate, so the source tells them apart.
+    const auto source = msg.type == MessageType::UiUpdate ? PeerType::UI : PeerType::Node;
+
+    const auto start = out.size();
+    out.append( walRecordPrefixSize, '\0' );
+    PutNumber( out, time );
+    out.push_back( static_cast<char>( source ) );
+
+    try
+    {
+        WriteBinary( out, msg );
+    }
+    catch ( ... )
+    {
+        out.resize( start );
+        throw;
+    }
+
+    const auto body = std::string_view( out ).substr( start + walRecordPrefixSize );
+    SetNumber( out, start, static_cast<std::uint32_t>( body.size() ) );
+    SetNumber( out, start + 4, Crc32( body ) );
+}
+
+WalReader::WalReader( const std::string_view log, const std::size_t offset )
+    : m_log( log )
+    , m_pos( offset )
+{}
+
+/*!
+    @brief Decodes the message of a record. Disconnects are only ever sent to UIs, so they are
+           decoded as one.
+ */
+std::optional<ParsedMessage> DecodeWalMessage(
+    const std::string_view encoded,
+    const PeerType source )
+{
+    if ( const auto msg = try_parse_binary( encoded, source ) )
+    {
+        return msg.Value();
+    }
+
+    const auto uiMsg = try_parse_binary_ui_message( encoded );
+    if ( uiMsg && uiMsg.Value().type == MessageType::NodeDisconnect )
+    {
+        ParsedMessage disconnect( MessageType::NodeDisconnect );
+        disconnect.node.id = uiMsg.Value().nodes.front().id;
+        return disconnect;
+    }
+
+    return std::nullopt;
+}
+
+WalStatus WalReader::NextBody( std::string_view& body ) const
+{
+    if ( m_pos == m_log.size() )
+    {
+        return WalStatus::End;
+    }
+    else if ( m_log.size() - m_pos < walRecordPrefixSize )
+    {
+        return WalStatus::Truncated;
+    }
+
+    const auto length = GetNumber<std::uint32_t>( m_log, m_pos );
+    const auto checksum = GetNumber<std::uint32_t>( m_log, m_pos + 4 );
+
+    if ( m_log.size() - m_pos - walRecordPrefixSize < length )
+    {
+        return WalStatus::Truncated;
+    }
+
+    body = m_log.substr( m_pos + walRecordPrefixSize, length );
+    if ( length < walRecordFieldsSize || Crc32( body ) != checksum ||
+         static_cast<std::uint8_t>( body[8] ) > static_cast<std::uint8_t>( PeerType::UI ) )
+    {
+        return WalStatus::Corrupt;
+    }
+
+    return WalStatus::Record;
+}
+
+WalStatus WalReader::Next( WalRecord& record )
+{
+    std::string_view body;
+    const auto status = NextBody( body );
+    if ( status != WalStatus::Record )
+    {
+        return status;
+    }
+
+    const auto source = static_cast<PeerType>( body[8] );
+    auto msg = DecodeWalMessage( body.substr( walRecordFieldsSize ), source );
+    if ( !msg )
+    {
+        return WalStatus::Corrupt;
+    }
+
+    record.time = GetNumber<Timestamp>( body, 0 );
+    record.message = std::move( *msg );
+    m_pos += walRecordPrefixSize + body.size();
+
+    return WalStatus::Record;
+}
+
+WalStatus WalReader::Skip()
+{
+    std::string_view body;
+    const auto status = NextBody( body );
+    if ( status == WalStatus::Record )
+    {
+        m_pos += walRecordPrefixSize + body.size();
+    }
+
+    return status;
+}
+
+} // namespace sn
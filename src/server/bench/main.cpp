@@ -0,0 +1,363 @@
+#include "binary_protocol.hpp"
+#include "listener.hpp"
+#include "logger.hpp"
+#include "message_builder.hpp"
+#include "message_engine.hpp"
+#include "sharded_engine.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using WebSocket = boost::beast::websocket::stream<boost::asio::ip::tcp::socket>;
+
+const std::string programName( "server_bench" );
+const std::size_t defaultNodeCount = 64;
+const std::size_t defaultUpdatesPerNode = 2000;
+const std::size_t iosPerNode = 8;
+const auto roundTimeout = std::chrono::seconds( 60 );
+
+void PrintUsage()
+{
+    std::cout << "Usage: " << programName
+              << " [--max-threads N] [--nodes N] [--updates N] [--shards N]\n"
+              << "    Connects the nodes to an in-process server, has each of them send the same\n"
+              << "    number of updates as fast as the server will take them, and reports how\n"
+              << "    many updates the server handles per second with 1, 2, 4, ... io threads.\n"
+              << "    With more than one shard, the server splits its nodes between that many\n"
+              << "    engines.\n";
+}
+
+std::string FormatName( const sn::WireFormat format )
+{
+    return format == sn::WireFormat::Binary ? "binary" : "text";
+}
+
+/*!
+    @brief Appends the message to the buffer as the websocket frame a client would send. The
+           masking key is zero, so the payload is sent as it is.
+ */
+void AppendClientFrame( std::string& out, const std::string& payload, const sn::WireFormat format )
+{
+    const auto size = payload.size();
+
+    out.push_back( static_cast<char>( format == sn::WireFormat::Binary ? 0x82 : 0x81 ) );
+    if ( size < 126 )
+    {
+        out.push_back( static_cast<char>( 0x80 | size ) );
+    }
+    else if ( size < 65536 )
+    {
+        out.push_back( static_cast<char>( 0x80 | 126 ) );
+        out.push_back( static_cast<char>( size >> 8 ) );
+        out.push_back( static_cast<char>( size & 0xFF ) );
+    }
+    else
+    {
+        out.push_back( static_cast<char>( 0x80 | 127 ) );
+        for ( int shift = 56; shift >= 0; shift -= 8 )
+        {
+            out.push_back( static_cast<char>( ( size >> shift ) & 0xFF ) );
+        }
+    }
+
+    out.append( 4, '\0' );
+    out.append( payload );
+}
+
+/*!
+    @brief Returns every update the node sends, as one buffer of frames. The nth update sets every
+           IO of the node to n, so the server has handled them all once every value is updates.
+ */
+std::string BuildUpdateFrames(
+    const sn::NodeId nodeId,
+    const std::size_t updates,
+    const sn::WireFormat format )
+{
+    std::string frames;
+    sn::ParsedMessage update( sn::MessageType::NodeUpdate );
+    update.node.id = nodeId;
+
+    for ( std::size_t count = 1; count <= updates; ++count )
+    {
+        update.node.io.clear();
+        for ( std::size_t io = 1; io <= iosPerNode; ++io )
+        {
+            update.node.io.emplace_back(
+                sn::IOId( static_cast<unsigned>( io ) ),
+                sn::IOType::AnalogueInput,
+                static_cast<int>( count ) );
+        }
+
+        AppendClientFrame( frames, sn::EncodeMessage( update, format ), format );
+    }
+
+    return frames;
+}
+
+/*!
+    @brief Connects a node to the server and waits for its NodeConnect to be acknowledged.
+ */
+std::unique_ptr<WebSocket> ConnectNode(
+    boost::asio::io_context& ioc,
+    const boost::asio::ip::tcp::endpoint& endpoint,
+    const sn::NodeId nodeId,
+    const sn::WireFormat format )
+{
+    auto pWs = std::make_unique<WebSocket>( ioc );
+    pWs->next_layer().connect( endpoint );
+
+    if ( format == sn::WireFormat::Binary )
+    {
+        pWs->set_option( boost::beast::websocket::stream_base::decorator(
+            []( boost::beast::websocket::request_type& req ) {
+                req.set(
+                    boost::beast::http::field::sec_websocket_protocol,
+                    std::string( sn::binarySubprotocol ) );
+            } ) );
+        pWs->binary( true );
+    }
+
+    pWs->handshake( endpoint.address().to_string(), "/" );
+
+    sn::ParsedMessage connect( sn::MessageType::NodeConnect );
+    connect.node.id = nodeId;
+    for ( std::size_t io = 1; io <= iosPerNode; ++io )
+    {
+        connect.node.io.emplace_back(
+            sn::IOId( static_cast<unsigned>( io ) ),
+            sn::IOType::AnalogueInput,
+            0 );
+    }
+
+    pWs->write( boost::asio::buffer( sn::EncodeMessage( connect, format ) ) );
+
+    boost::beast::flat_buffer ack;
+    pWs->read( ack );
+
+    return pWs;
+}
+
+/*!
+    @brief Returns true once the server has applied the last update of every node.
+ */
+bool AllUpdatesApplied(
+    const std::vector<std::shared_ptr<const sn::MessageEngine>>& engines,
+    const std::size_t nodeCount,
+    const std::size_t updates )
+{
+    bool applied = true;
+    std::size_t appliedNodes = 0;
+
+    for ( const auto& pEngine : engines )
+    {
+        const auto snapshot = pEngine->AcquireNodeStates();
+        if ( !snapshot )
+        {
+            return false;
+        }
+
+        appliedNodes += snapshot->Size();
+        snapshot->ForEachNode( [&applied, updates]( const sn::NodeStateSnapshot::NodeView& node ) {
+            for ( std::size_t index = 0; index < node.ioCount; ++index )
+            {
+                applied = applied && node.io[index].value == static_cast<int>( updates );
+            }
+        } );
+    }
+
+    return applied && appliedNodes == nodeCount;
+}
+
+/*!
+    @brief Runs a server with the given number of io threads and returns how long it took to
+           handle every update of every node.
+ */
+std::chrono::nanoseconds RunRound(
+    const unsigned ioThreadCount,
+    const std::size_t shardCount,
+    const std::size_t nodeCount,
+    const std::size_t updates,
+    const sn::WireFormat format )
+{
+    boost::asio::io_context ioc;
+    std::shared_ptr<sn::MessageHandler> pMsgHandler;
+    std::shared_ptr<sn::ShardedEngine> pShardedEngine;
+    std::vector<std::shared_ptr<const sn::MessageEngine>> engines;
+
+    if ( shardCount == 1 )
+    {
+        const auto pEngine = std::make_shared<sn::MessageEngine>();
+        pMsgHandler = pEngine;
+        engines.push_back( pEngine );
+    }
+    else
+    {
+        pShardedEngine = std::make_shared<sn::ShardedEngine>(
+            shardCount,
+            sn::MessageEngine::defaultHistoryDepth );
+        pMsgHandler = pShardedEngine;
+        engines = pShardedEngine->Engines();
+    }
+
+    const auto pListener = std::make_shared<sn::Listener>( ioc, programName, pMsgHandler );
+    pListener->Listen(
+        boost::asio::ip::tcp::endpoint( boost::asio::ip::make_address( "127.0.0.1" ), 0 ) );
+    pListener->Run();
+
+    std::vector<std::thread> ioThreads;
+    for ( unsigned index = 0; index < ioThreadCount; ++index )
+    {
+        ioThreads.emplace_back( [&ioc]() { ioc.run(); } );
+    }
+
+    boost::asio::io_context clientIoc;
+    std::vector<std::unique_ptr<WebSocket>> nodes;
+    std::vector<std::string> frames;
+    for ( std::size_t index = 0; index < nodeCount; ++index )
+    {
+        const auto nodeId = sn::NodeId( static_cast<unsigned>( index + 1 ) );
+        nodes.push_back( ConnectNode( clientIoc, pListener->LocalEndpoint(), nodeId, format ) );
+        frames.push_back( BuildUpdateFrames( nodeId, updates, format ) );
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> writers;
+    for ( std::size_t index = 0; index < nodeCount; ++index )
+    {
+        writers.emplace_back( [&socket = nodes[index]->next_layer(), &buffer = frames[index]]() {
+            boost::asio::write( socket, boost::asio::buffer( buffer ) );
+        } );
+    }
+
+    for ( auto& writer : writers )
+    {
+        writer.join();
+    }
+
+    while ( !AllUpdatesApplied( engines, nodeCount, updates ) )
+    {
+        if ( std::chrono::steady_clock::now() - start > roundTimeout )
+        {
+            throw std::runtime_error( "Timed out waiting for the server to handle the updates" );
+        }
+
+        std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    for ( auto& pNode : nodes )
+    {
+        pNode->next_layer().close();
+    }
+
+    ioc.stop();
+    for ( auto& ioThread : ioThreads )
+    {
+        ioThread.join();
+    }
+
+    if ( pShardedEngine )
+    {
+        pShardedEngine->Stop();
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed );
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+    unsigned maxThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::size_t nodeCount = defaultNodeCount;
+    std::size_t updates = defaultUpdatesPerNode;
+    std::size_t shardCount = 1;
+
+    for ( int index = 1; index < argc; ++index )
+    {
+        const std::string arg( argv[index] );
+
+        if ( arg == "--max-threads" && index + 1 < argc )
+        {
+            maxThreads = static_cast<unsigned>( std::strtoul( argv[++index], nullptr, 10 ) );
+        }
+        else if ( arg == "--nodes" && index + 1 < argc )
+        {
+            nodeCount = std::strtoul( argv[++index], nullptr, 10 );
+        }
+        else if ( arg == "--updates" && index + 1 < argc )
+        {
+            updates = std::strtoul( argv[++index], nullptr, 10 );
+        }
+        else if ( arg == "--shards" && index + 1 < argc )
+        {
+            shardCount = std::strtoul( argv[++index], nullptr, 10 );
+        }
+        else
+        {
+            PrintUsage();
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if ( maxThreads == 0 || nodeCount == 0 || updates == 0 || shardCount == 0 )
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    // The server logs and prints every node that connects or disconnects, which would drown out the
+    // results.
+    spdlog::create<spdlog::sinks::null_sink_mt>( sn::loggerName )->set_level( spdlog::level::off );
+
+    std::cout << std::left << std::setw( 10 ) << "format" << std::right << std::setw( 12 )
+              << "io threads" << std::setw( 16 ) << "updates/s" << std::setw( 12 ) << "speedup"
+              << '\n';
+
+    for ( const auto format : { sn::WireFormat::Text, sn::WireFormat::Binary } )
+    {
+        double baseline = 0.0;
+
+        for ( unsigned threads = 1; threads <= maxThreads; threads *= 2 )
+        {
+            std::cout.setstate( std::ios::failbit );
+            const auto elapsed = RunRound( threads, shardCount, nodeCount, updates, format );
+            std::cout.clear();
+
+            const auto seconds = std::chrono::duration<double>( elapsed ).count();
+            const auto rate = static_cast<double>( nodeCount * updates ) / seconds;
+            baseline = threads == 1 ? rate : baseline;
+
+            std::cout << std::left << std::setw( 10 ) << FormatName( format ) << std::right
+                      << std::setw( 12 ) << threads << std::fixed << std::setprecision( 0 )
+                      << std::setw( 16 ) << rate << std::setprecision( 2 ) << std::setw( 11 )
+                      << rate / baseline << "x" << std::endl;
+        }
+    }
+
+    spdlog::drop_all();
+    return EXIT_SUCCESS;
+}
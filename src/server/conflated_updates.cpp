@@ -0,0 +1,59 @@
+#include "conflated_updates.hpp"
+#include "message_builder.hpp"
+
+namespace sn
+{
+
+void ConflatedUpdates::Merge( const Node& update, const SequenceNumber sequence )
+{
+    const auto [existing, added] = m_nodeIndices.emplace( update.id, m_nodes.size() );
+    if ( added )
+    {
+        m_nodes.emplace_back( update.id );
+    }
+
+    auto& ios = m_nodes[existing->second].io;
+    for ( const auto& io : update.io )
+    {
+        const auto [held, heldAdded] = m_ioIndices.emplace( IOKey( update.id, io.id ), ios.size() );
+        if ( heldAdded )
+        {
+            ios.push_back( io );
+        }
+        else
+        {
+            ios[held->second].value = io.value;
+        }
+    }
+
+    ++m_count;
+    m_lastSequence = sequence;
+}
+
+std::uint64_t ConflatedUpdates::IOKey( const NodeId nodeId, const IOId ioId )
+{
+    return static_cast<std::uint64_t>( static_cast<std::uint32_t>( nodeId ) ) << 32 |
+           static_cast<std::uint32_t>( ioId );
+}
+
+std::size_t ConflatedUpdates::Count() const
+{
+    return m_count;
+}
+
+void ConflatedUpdates::Write( std::string& out, const WireFormat format ) const
+{
+    for ( const auto& node : m_nodes )
+    {
+        WriteUpdateMessage( out, node.id, node.io, format );
+    }
+
+    if ( m_lastSequence != 0 )
+    {
+        ParsedMessage sequence( MessageType::Sequence );
+        sequence.sequence = m_lastSequence;
+        WriteMessage( out, sequence, format );
+    }
+}
+
+} // namespace sn
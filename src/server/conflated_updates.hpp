@@ -0,0 +1,62 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+#include "messages.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief NodeUpdates queued to a UI that is not keeping up, merged so that only the newest value
+           of each IO is sent. However fast the nodes update, it never holds more than one value
+           for each IO updated.
+ */
+class ConflatedUpdates final
+{
+public:
+    /*!
+        @brief Merges a NodeUpdate in, replacing the values of any of its IOs already held.
+        @param[in] update The node and the IOs it updated.
+        @param[in] sequence The change the update was recorded as, or zero if the UI is not told
+                   which change it is up to.
+     */
+    void Merge( const Node& update, const SequenceNumber sequence );
+
+    /*!
+        @brief Returns the number of NodeUpdates merged in.
+     */
+    std::size_t Count() const;
+
+    /*!
+        @brief Writes a NodeUpdate for each node with the newest values of its IOs, in the order the
+               nodes were first updated, followed by a Sequence of the last update merged unless it
+               has none. A UI counts each NodeUpdate as a change, so it needs telling which change
+               it is up to once several have been merged into one.
+        @param[out] out The string to append the messages to.
+        @param[in] format The protocol the UI uses.
+     */
+    void Write( std::string& out, const WireFormat format ) const;
+
+private:
+    //! Returns the key of an IO in m_ioIndices.
+    static std::uint64_t IOKey( const NodeId nodeId, const IOId ioId );
+
+private:
+    std::vector<Node> m_nodes;
+    std::unordered_map<NodeId, std::size_t> m_nodeIndices;
+
+    // Where each IO held is in the IOs of its node, so that merging an update takes time in
+    // proportion to the IOs it updates, however many are held.
+    std::unordered_map<std::uint64_t, std::size_t> m_ioIndices;
+    std::size_t m_count = 0;
+    SequenceNumber m_lastSequence = 0;
+};
+
+} // namespace sn
@@ -1,44 +1,114 @@
 #pragma once
 
+#include "id_registry.hpp"
+
+#include <cstddef>
 #include <memory>
-#include <type_traits>
+#include <vector>
 
 namespace sn
 {
 
 class Session;
 
-// clang-format off
-template<
-    typename T,
-    typename = std::enable_if<std::is_integral_v<T>>>
-// clang-format on
-class Connection final
+/*!
+    @brief The sessions of the connected peers of one kind. Each peer is given a slot when it
+           connects, and its session is kept in an array indexed by that slot, so only the ID a
+           message arrives with is ever looked up.
+ */
+template<typename Id>
+class Connections final
 {
 public:
-    Connection( const T& id, std::weak_ptr<sn::Session> pSession )
-        : m_id( id )
-        , m_pSession( std::move( pSession ) )
-    {}
+    /*!
+        @brief Adds the session of a peer that has connected.
+        @returns False if a peer with the ID is already connected, in which case nothing changes.
+     */
+    bool Add( const Id id, std::weak_ptr<Session> pSession )
+    {
+        if ( m_ids.Contains( id ) )
+        {
+            return false;
+        }
+
+        const auto slot = m_ids.Register( id );
+        if ( slot == m_sessions.size() )
+        {
+            m_sessions.emplace_back();
+        }
+
+        m_sessions[slot] = std::move( pSession );
+        return true;
+    }
+
+    /*!
+        @brief Removes the peer with the ID.
+        @returns False if no peer with the ID is connected.
+     */
+    bool Remove( const Id id )
+    {
+        const auto slot = m_ids.Release( id );
+        if ( !slot )
+        {
+            return false;
+        }
+
+        m_sessions[*slot].reset();
+        return true;
+    }
+
+    /*!
+        @brief Removes every peer whose session no longer exists.
+     */
+    void RemoveExpired()
+    {
+        for ( std::size_t slot = 0; slot < m_sessions.size(); ++slot )
+        {
+            if ( m_ids.InUse( slot ) && m_sessions[slot].expired() )
+            {
+                Remove( m_ids.IdAt( slot ) );
+            }
+        }
+    }
+
+    bool Contains( const Id id ) const
+    {
+        return m_ids.Contains( id );
+    }
 
-    const T& Id() const
+    /*!
+        @brief Returns true if the peer with the ID is connected on the provided session.
+     */
+    bool Holds( const Id id, const std::shared_ptr<Session>& pSession ) const
     {
-        return m_id;
+        const auto slot = m_ids.Find( id );
+        return slot && m_sessions[*slot].lock() == pSession;
     }
 
-    const std::weak_ptr<sn::Session>& Session() const
+    /*!
+        @brief Returns the session of the peer with the ID, or null if it is not connected or its
+               session no longer exists.
+     */
+    std::shared_ptr<Session> Lock( const Id id ) const
     {
-        return m_pSession;
+        const auto slot = m_ids.Find( id );
+        return slot ? m_sessions[*slot].lock() : nullptr;
     }
 
-    bool operator<( const Connection& rhs ) const
+    /*!
+        @brief Calls the callback with the ID and session of every connected peer.
+     */
+    template<typename Callback>
+    void ForEach( Callback&& callback ) const
     {
-        return m_id < rhs.m_id;
+        m_ids.ForEach( [this, &callback]( const std::size_t slot, const Id id ) {
+            callback( id, m_sessions[slot] );
+        } );
     }
 
 private:
-    const T m_id;
-    const std::weak_ptr<sn::Session> m_pSession;
+    IdRegistry<Id> m_ids;
+    std::vector<std::weak_ptr<Session>> m_sessions;
 };
 
 } // namespace sn
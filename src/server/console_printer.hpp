@@ -2,10 +2,20 @@
 
 #include <rang.hpp>
 
+#include <mutex>
 #include <ostream>
 
 namespace sn
 {
+
+/*!
+    @brief Returns the mutex that stops lines printed on different io threads from interleaving.
+ */
+inline std::mutex& ConsoleMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
 /*!
     @brief Prints a warning message to the console.
     @param[in] items The items to print with warning styling.
@@ -13,6 +23,7 @@ namespace sn
 template<typename... T>
 void PrintWarning( T&&... items )
 {
+    const std::lock_guard lock( ConsoleMutex() );
     ( ( std::cout << rang::fg::yellow << "[WARNING] " ) << ... << items )
         << rang::fg::reset << '\n';
 }
@@ -24,6 +35,7 @@ void PrintWarning( T&&... items )
 template<typename... T>
 void PrintError( T&&... items )
 {
+    const std::lock_guard lock( ConsoleMutex() );
     ( ( std::cout << rang::fg::red << "[ERROR] " ) << ... << items ) << rang::fg::reset << '\n';
 }
 
@@ -34,6 +46,7 @@ void PrintError( T&&... items )
 template<typename... T>
 void PrintInfo( T&&... items )
 {
+    const std::lock_guard lock( ConsoleMutex() );
     ( ( std::cout << rang::fg::cyan << "[INFO] " ) << ... << items ) << rang::fg::reset << '\n';
 }
 
@@ -44,6 +57,7 @@ void PrintInfo( T&&... items )
 template<typename... T>
 void PrintDebug( T&&... items )
 {
+    const std::lock_guard lock( ConsoleMutex() );
     ( ( std::cout << "[DEBUG] " ) << ... << items ) << '\n';
 }
 
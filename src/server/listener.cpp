@@ -15,11 +15,11 @@ namespace sn
 Listener::Listener(
     boost::asio::io_context& ioc,
     const std::string& serverName,
-    const std::shared_ptr<MessageEngine>& pMsgEngine )
+    const std::shared_ptr<MessageHandler>& pMsgHandler )
     : m_ioc( ioc )
     , m_acceptor( ioc )
     , m_serverName( serverName )
-    , m_pMsgEngine( pMsgEngine )
+    , m_pMsgHandler( pMsgHandler )
 {}
 
 void Listener::Listen( const boost::asio::ip::tcp::endpoint& endpoint )
@@ -64,6 +64,11 @@ void Listener::Run()
     DoAccept();
 }
 
+boost::asio::ip::tcp::endpoint Listener::LocalEndpoint() const
+{
+    return m_acceptor.local_endpoint();
+}
+
 void Listener::DoAccept()
 {
     // The new connection gets its own strand
@@ -88,7 +93,7 @@ void Listener::OnAccept( boost::beast::error_code ec, boost::asio::ip::tcp::sock
              socket.local_endpoint().port() );
 
         // Create the session and run it
-        std::make_shared<Session>( std::move( socket ), m_serverName, m_pMsgEngine )->Run();
+        std::make_shared<Session>( std::move( socket ), m_serverName, m_pMsgHandler )->Run();
     }
 
     // Accept another connection
@@ -22,7 +22,7 @@
 namespace sn
 {
 
-class MessageEngine;
+class MessageHandler;
 
 // Accepts incoming connections and launches the sessions
 class Listener : public std::enable_shared_from_this<Listener>
@@ -31,7 +31,7 @@ public:
     Listener(
         boost::asio::io_context& ioc,
         const std::string& serverName,
-        const std::shared_ptr<MessageEngine>& pMsgEngine );
+        const std::shared_ptr<MessageHandler>& pMsgHandler );
 
     /*!
         @brief Start listening for incoming connections on the provided
@@ -45,6 +45,12 @@ public:
      */
     void Run();
 
+    /*!
+        @brief Returns the endpoint being listened on, e.g. to find the port chosen when listening
+               on port 0.
+     */
+    boost::asio::ip::tcp::endpoint LocalEndpoint() const;
+
 private: // methods
     void DoAccept();
 
@@ -54,7 +60,7 @@ private: // data
     boost::asio::io_context& m_ioc;
     boost::asio::ip::tcp::acceptor m_acceptor;
     const std::string m_serverName;
-    const std::shared_ptr<MessageEngine> m_pMsgEngine;
+    const std::shared_ptr<MessageHandler> m_pMsgHandler;
 };
 
 } // namespace sn
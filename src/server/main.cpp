@@ -3,6 +3,10 @@
 #include "console_printer.hpp"
 #include "message_engine.hpp"
 #include "logger.hpp"
+#include "sharded_engine.hpp"
+#include "snapshot_file.hpp"
+#include "state_persister.hpp"
+#include "wal_writer.hpp"
 
 #include <boost/beast/core.hpp>
 #include <boost/asio/ip/address.hpp>
@@ -21,6 +25,8 @@
 #include <thread>
 #include <chrono>
 #include <condition_variable>
+#include <algorithm>
+#include <vector>
 
 //------------------------------------------------------------------------------
 const std::string programName( "smartnode-server" );
@@ -28,6 +34,10 @@ constexpr auto maxLogSize_bytes = 1024 * 1024 * 5; // 5 MiB
 const auto numLogFiles = 20;
 const bool rotateOnAppStart = true;
 const std::string exitMessage( "Ctrl-C caught, exiting program." );
+const std::string snapshotPath( "state/node_states.snapshot" );
+constexpr std::chrono::seconds snapshotInterval( 5 );
+const std::string walPath( "wal/changes.wal" );
+constexpr std::chrono::milliseconds defaultWalSyncInterval( 1000 );
 std::atomic<bool> shouldKeepRunning = true;
 std::mutex cvMutex;
 std::condition_variable cv;
@@ -84,15 +94,21 @@ int main( int argc, char* argv[] )
 
     std::string addressStr;
     std::string portStr;
+    auto historyDepth = sn::MessageEngine::defaultHistoryDepth;
+    auto walSyncInterval = defaultWalSyncInterval;
+    auto ioThreadCount = std::max( 1u, std::thread::hardware_concurrency() );
+    std::size_t shardCount = 1;
 
     // Check command line arguments.
-    if ( argc != 3 )
+    if ( argc < 3 || argc > 7 )
     {
         // clang-format off
         sn::PrintInfo(
-            "Usage: ", programName, " <address> <port>\n",
+            "Usage: ", programName,
+            " <address> <port> [history depth] [WAL sync interval ms] [io threads]",
+            " [engine shards]\n",
             "Example:\n",
-            "    ", programName, " 127.0.0.1 8080\n" );
+            "    ", programName, " 127.0.0.1 8080 256 1000 4 1\n" );
         // clang-format on
 
         addressStr = "127.0.0.1";
@@ -104,6 +120,54 @@ int main( int argc, char* argv[] )
     {
         addressStr = argv[1];
         portStr = argv[2];
+
+        if ( argc >= 4 )
+        {
+            const auto depth = std::atoi( argv[3] );
+            if ( depth <= 0 )
+            {
+                sn::PrintError( "History depth must be a positive number of samples." );
+                return EXIT_FAILURE;
+            }
+
+            historyDepth = static_cast<std::size_t>( depth );
+        }
+
+        if ( argc >= 5 )
+        {
+            const auto interval = std::atoi( argv[4] );
+            if ( interval < 0 )
+            {
+                sn::PrintError( "WAL sync interval must not be negative." );
+                return EXIT_FAILURE;
+            }
+
+            walSyncInterval = std::chrono::milliseconds( interval );
+        }
+
+        if ( argc >= 6 )
+        {
+            const auto threads = std::atoi( argv[5] );
+            if ( threads <= 0 )
+            {
+                sn::PrintError( "The number of io threads must be positive." );
+                return EXIT_FAILURE;
+            }
+
+            ioThreadCount = static_cast<unsigned>( threads );
+        }
+
+        if ( argc == 7 )
+        {
+            const auto shards = std::atoi( argv[6] );
+            if ( shards <= 0 )
+            {
+                sn::PrintError( "The number of engine shards must be positive." );
+                return EXIT_FAILURE;
+            }
+
+            shardCount = static_cast<std::size_t>( shards );
+        }
     }
 
     boost::system::error_code ec;
@@ -119,18 +183,108 @@ int main( int argc, char* argv[] )
     // The io_context is required for all I/O
     boost::asio::io_context ioc;
 
+    // One engine handles every message unless it is split into shards, each of which handles the
+    // messages of its own nodes on a thread of its own.
+    std::shared_ptr<sn::MessageEngine> pMsgEngine;
+    std::shared_ptr<sn::ShardedEngine> pShardedEngine;
+    std::shared_ptr<sn::MessageHandler> pMsgHandler;
+    std::vector<std::shared_ptr<const sn::MessageEngine>> msgEngines;
+
+    if ( shardCount == 1 )
+    {
+        pMsgEngine = std::make_shared<sn::MessageEngine>( historyDepth );
+        pMsgHandler = pMsgEngine;
+        msgEngines.push_back( pMsgEngine );
+    }
+    else
+    {
+        pShardedEngine = std::make_shared<sn::ShardedEngine>( shardCount, historyDepth );
+        pMsgHandler = pShardedEngine;
+        msgEngines = pShardedEngine->Engines();
+    }
+
+    const auto setWriteAheadLog = [&pMsgEngine,
+                                   &pShardedEngine]( std::shared_ptr<sn::WalWriter> pWal ) {
+        if ( pMsgEngine )
+        {
+            pMsgEngine->SetWriteAheadLog( std::move( pWal ) );
+        }
+        else
+        {
+            pShardedEngine->SetWriteAheadLog( std::move( pWal ) );
+        }
+    };
+
+    // Restore the node states saved before the server last stopped, so that UIs see the last known
+    // values until the nodes reconnect.
+    try
+    {
+        if ( const auto contents = sn::ReadSnapshotFile( snapshotPath ) )
+        {
+            if ( pMsgEngine )
+            {
+                pMsgEngine->RestoreNodeStates( contents->nodes );
+            }
+            else
+            {
+                pShardedEngine->RestoreNodeStates( contents->nodes );
+            }
+
+            sn::Log( spdlog::level::info,
+                     "Restored {} node(s) from {}",
+                     contents->nodes.size(),
+                     snapshotPath );
+            sn::PrintInfo(
+                "Restored ",
+                contents->nodes.size(),
+                " stale node(s) from ",
+                snapshotPath );
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        sn::Log( spdlog::level::warn, "Failed to restore node states: {}", e.what() );
+        sn::PrintWarning( "Failed to restore node states: ", e.what() );
+    }
+
+    // Every change is logged from here on. A log that cannot be appended to is moved aside for a
+    // new one, and the server still runs if no log can be opened at all.
+    std::shared_ptr<sn::WalWriter> pWal;
+    try
+    {
+        pWal = std::make_shared<sn::WalWriter>( walPath, walSyncInterval );
+        setWriteAheadLog( pWal );
+    }
+    catch ( const std::exception& e )
+    {
+        sn::Log( spdlog::level::err, "Failed to open write-ahead log: {}", e.what() );
+        sn::PrintError( "Failed to open write-ahead log: ", e.what() );
+    }
+
+    auto pPersister = std::make_unique<sn::StatePersister>(
+        msgEngines,
+        snapshotPath,
+        std::chrono::duration_cast<std::chrono::milliseconds>( snapshotInterval ) );
+
     // Create and launch a listening port
-    const auto pListener =
-        std::make_shared<sn::Listener>( ioc, programName, std::make_shared<sn::MessageEngine>() );
+    const auto pListener = std::make_shared<sn::Listener>( ioc, programName, pMsgHandler );
     pListener->Listen( boost::asio::ip::tcp::endpoint{ address, port } );
     pListener->Run();
 
-    // Run the I/O service on a single thread (this one).
+    // Run the I/O service on a pool of threads. Each session runs on its own strand, and the
+    // message engine, or each of its shards, serialises the handling of messages itself.
     sn::Log( spdlog::level::debug, "Starting with address {} and port {}", addressStr, portStr );
+    sn::Log( spdlog::level::debug, "Keeping {} sample(s) of history per IO", historyDepth );
+    sn::Log( spdlog::level::debug, "Running {} io thread(s)", ioThreadCount );
+    sn::Log( spdlog::level::debug, "Running {} engine shard(s)", shardCount );
     sn::PrintInfo( "Starting websocket server on ", address, ':', port );
     sn::PrintInfo( "Press CTRL+C to exit" );
 
-    std::thread serverThread( [&ioc]() { ioc.run(); } );
+    std::vector<std::thread> ioThreads;
+    for ( unsigned index = 0; index < ioThreadCount; ++index )
+    {
+        ioThreads.emplace_back( [&ioc]() { ioc.run(); } );
+    }
 
     std::unique_lock exitLock( cvMutex );
     while ( shouldKeepRunning )
@@ -141,11 +295,22 @@ int main( int argc, char* argv[] )
 
     ioc.stop();
 
-    if ( serverThread.joinable() )
+    for ( auto& ioThread : ioThreads )
     {
-        serverThread.join();
+        ioThread.join();
     }
 
+    if ( pShardedEngine )
+    {
+        pShardedEngine->Stop();
+    }
+
+    // Saves the node states and commits the log one last time now that no more messages will be
+    // handled, while the logger is still there to report failures.
+    pPersister.reset();
+    setWriteAheadLog( nullptr );
+    pWal.reset();
+
     sn::Log( spdlog::level::debug, "Exiting ", programName );
     spdlog::drop_all();
     spdlog::shutdown();
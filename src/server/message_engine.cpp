@@ -5,78 +5,125 @@
 #include "logger.hpp"
 #include "parser.hpp"
 #include "message_builder.hpp"
-
-#include <set>
+#include "outbound_message.hpp"
+#include "wal_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory_resource>
 #include <variant>
+#include <vector>
 
 namespace sn
 {
 
+template<typename T, typename U>
+void RemoveDisconnectedPeer( T& connections, const U id )
+{
+    if ( connections.Remove( id ) )
+    {
+        PrintInfo( id, " disconnected." );
+    }
+}
+
 /*!
-    @brief Removes any expired sessions from the provided container.
-    @param[in] container The container from which to remove expired sessions.
+    @brief Returns true if the node lists any of its IOs more than once.
  */
-template<typename T>
-void RemoveExpiredSessions( T& container )
+bool HasDuplicateIOs( const Node& node )
 {
-    auto it = container.begin();
-    while ( it != container.end() )
+    std::vector<IOId> ids;
+    ids.reserve( node.io.size() );
+    for ( const auto& io : node.io )
     {
-        if ( ( *it ).Session().expired() )
-        {
-            it = container.erase( it );
-        }
-        else
-        {
-            ++it;
-        }
+        ids.push_back( io.id );
     }
+
+    std::sort( ids.begin(), ids.end() );
+    return std::adjacent_find( ids.begin(), ids.end() ) != ids.end();
 }
 
-template<typename T, typename U>
-void RemoveDisconnectedPeer( T& container, const U id )
+bool MessageEngine::PeerConnected( const std::shared_ptr<Session>& pSession ) const
 {
-    for ( const auto& element : container )
+    const auto peerId = pSession->GetPeerId();
+    if ( std::holds_alternative<UIId>( peerId ) )
     {
-        if ( element.Id() == id )
-        {
-            container.erase( element );
-            PrintInfo( id, " disconnected." );
-            return;
-        }
+        return m_uiConnections.Holds( std::get<UIId>( peerId ), pSession );
     }
+
+    return m_nodeConnections.Holds( std::get<NodeId>( peerId ), pSession );
 }
 
-template<typename T>
-bool SessionInContainer( const std::shared_ptr<Session>& pSession, const T& container )
+MessageEngine::MessageEngine( const std::size_t historyDepth )
+    : m_history( historyDepth )
+{}
+
+/*!
+    @brief Returns the arena that messages received on the calling thread are parsed into. Messages
+           that fit in its buffer are parsed without calling the global allocator, and each io
+           thread has its own so that parsing needs no lock.
+ */
+std::pmr::monotonic_buffer_resource& ThreadParseArena()
 {
-    return std::find_if(
-               container.cbegin(),
-               container.cend(),
-               [&pSession]( const auto& connection ) {
-                   return connection.Session().lock() == pSession;
-               } ) != container.cend();
+    static constexpr std::size_t parseArenaSize = 64 * 1024;
+    thread_local std::array<std::byte, parseArenaSize> buffer;
+    thread_local std::pmr::monotonic_buffer_resource arena( buffer.data(), buffer.size() );
+    return arena;
 }
 
-bool MessageEngine::PeerConnected( const std::shared_ptr<Session>& pSession ) const
+void MessageEngine::MessageReceived(
+    std::weak_ptr<Session>&& pSession, const std::string_view message )
 {
-    return SessionInContainer( pSession, m_uiConnections ) ||
-           SessionInContainer( pSession, m_nodeConnections );
+    const auto pLockedSession = pSession.lock();
+    if ( pLockedSession == nullptr )
+    {
+        return;
+    }
+
+    auto& arena = ThreadParseArena();
+    m_pendingMessages.fetch_add( 1, std::memory_order_relaxed );
+
+    {
+        // The peer type of a session only changes while a message from that session is handled,
+        // and its messages are handled one at a time, so it can be read without the lock.
+        const auto result = try_parse(
+            message,
+            pLockedSession->GetPeerType(),
+            pLockedSession->GetWireFormat(),
+            &arena );
+
+        const std::lock_guard lock( m_mutex );
+        HandleMessage( std::move( pSession ), pLockedSession, result, message );
+        m_pendingMessages.fetch_sub( 1, std::memory_order_relaxed );
+        PublishNodeStates();
+    }
+
+    // Nothing parsed from the message outlives HandleMessage(), so the arena can be reused.
+    arena.release();
 }
 
-void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const std::string& message )
+void MessageEngine::HandleMessage(
+    std::weak_ptr<Session>&& pSession,
+    const std::shared_ptr<Session>& pLockedSession,
+    const ParseResult<ParsedMessage>& result,
+    const std::string_view message )
 {
     try
     {
-        const auto pLockedSession = pSession.lock();
-        const auto msg = parse( message, pLockedSession->GetPeerType() );
-        Log( spdlog::level::debug, "Message Type is {}", msg.type );
-
-        if ( pLockedSession == nullptr )
+        const auto format = pLockedSession->GetWireFormat();
+        if ( !result )
         {
+            pLockedSession->ReportMalformedMessage( result.Failure() );
             return;
         }
 
+        const auto& msg = result.Value();
+        Log( spdlog::level::debug, "Message Type is {}", msg.type );
+
+        // Peers using the other protocol get the message re-encoded once, not once each.
+        OutboundMessage outbound( msg, m_encodeBuffers, format, message );
+
         switch ( msg.type )
         {
 
@@ -87,7 +134,7 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
 
             if ( PeerConnected( pLockedSession ) )
             {
-                pLockedSession->SendMessage( BuildNak( msg ) );
+                Reply( *pLockedSession, MessageType::Nak, msg );
                 const auto peerId = pLockedSession->PeerIdAsString();
 
                 Log( spdlog::level::warn, "{} attempting to connect as {}", peerId, nodeIdStr );
@@ -95,11 +142,22 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
             }
             else if ( IsNodeConnected( nodeId ) )
             {
-                pLockedSession->SendMessage( BuildNak( msg ) );
+                Reply( *pLockedSession, MessageType::Nak, msg );
 
                 Log( spdlog::level::warn, "New Node attempting to connect as {}", nodeIdStr );
                 PrintWarning( "New Node attempting to connect as ", nodeIdStr );
             }
+            else if ( HasDuplicateIOs( msg.node ) )
+            {
+                // The node cache holds one value per IO ID, so a node whose IOs share an ID
+                // could not be updated consistently.
+                Reply( *pLockedSession, MessageType::Nak, msg );
+
+                Log( spdlog::level::warn,
+                     "{} attempting to connect with duplicate IOs",
+                     nodeIdStr );
+                PrintWarning( nodeIdStr, " attempting to connect with duplicate IOs" );
+            }
             else
             {
                 pLockedSession->SetPeerId( nodeId );
@@ -108,10 +166,16 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
                 Log( spdlog::level::info, "{} connected", nodeIdStr );
                 PrintInfo( nodeIdStr, " connected" );
 
-                m_nodeStates.push_back( msg.node );
+                m_nodeCache.Add( msg.node );
+                m_fullState.NodeChanged( nodeId );
+                m_snapshots.NodesAddedOrRemoved();
+                m_history.AddNode( msg.node, Now() );
+                m_staleNodes.erase( nodeId );
+                m_changeLog.Record( msg );
+                AppendToWriteAheadLog( msg );
 
-                pLockedSession->SendMessage( BuildAck( msg ) );
-                ForwardMessageToUIs( message );
+                Reply( *pLockedSession, MessageType::Ack, msg );
+                ForwardMessageToUIs( outbound );
             }
         }
         break;
@@ -126,15 +190,17 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
                 // TODO: Check that IO exists on the Node.
                 // TODO: Check that each updated IO is an input.
 
+                // Updates outnumber every other message by far, so they are not printed, and only
+                // logged at debug level. Either would otherwise take a lock shared by every shard.
                 for ( const auto& io : msg.node.io )
                 {
                     UpdateIOCache( nodeId, io.id, io.value );
-
-                    Log( spdlog::level::info, "{} updated {} to {}", nodeIdStr, io.id, io.value );
-                    PrintInfo( nodeIdStr, " updated ", io.id, " to ", io.value );
+                    Log( spdlog::level::debug, "{} updated {} to {}", nodeIdStr, io.id, io.value );
                 }
 
-                ForwardMessageToUIs( message );
+                m_changeLog.Record( msg );
+                AppendToWriteAheadLog( msg );
+                ForwardUpdateToUIs( outbound, msg.node );
             }
             else
             {
@@ -167,7 +233,7 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
 
             if ( PeerConnected( pLockedSession ) )
             {
-                pLockedSession->SendMessage( BuildNak( msg ) );
+                Reply( *pLockedSession, MessageType::Nak, msg );
 
                 Log( spdlog::level::warn,
                      "{} attempting to connect as {}",
@@ -186,7 +252,7 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
                 Log( spdlog::level::info, "{} connected", uiIdStr );
                 PrintInfo( uiIdStr, " connected" );
 
-                pLockedSession->SendMessage( BuildFullState( m_nodeStates ) );
+                SendNodeStates( *pLockedSession, msg.sequence, format );
             }
         }
         break;
@@ -210,12 +276,30 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
                 PrintInfo( uiId, " updated ", io.id, " to ", io.value, " on ", nodeIdStr );
             }
 
-            SendMessageToNode( nodeId, message );
+            AppendToWriteAheadLog( msg );
+            SendMessageToNode( nodeId, outbound );
 
             // TODO: Do not send the message back to the UI that originally sent it.
             // TODO: Check that IO exists on the Node.
             // TODO: Check that each IO is an output.
-            // ForwardMessageToUIs( message );
+            // ForwardMessageToUIs( outbound );
+
+            // As long as UI updates are not forwarded to UIs, they are not recorded in the change
+            // log either, so that the sequence numbers UIs count match the server's.
+        }
+        break;
+
+        case MessageType::HistoryRequest:
+        {
+            if ( PeerConnected( pLockedSession ) )
+            {
+                SendHistory( *pLockedSession, msg.node.id, msg.history, format );
+            }
+            else
+            {
+                Log( spdlog::level::warn, "Ignoring history request from non-connected peer" );
+                PrintWarning( "Ignoring history request from non-connected peer" );
+            }
         }
         break;
 
@@ -229,44 +313,301 @@ void MessageEngine::MessageReceived( std::weak_ptr<Session>&& pSession, const st
     }
     catch ( const std::exception& e )
     {
-        PrintWarning( "Failed to parse incoming message: ", e.what() );
+        PrintWarning( "Failed to handle incoming message: ", e.what() );
         PrintDebug( "Message: \n", message );
     }
 }
 
+void MessageEngine::SendNodeStates(
+    Session& session,
+    const SequenceNumber lastSequence,
+    const WireFormat format )
+{
+    m_replyBuffer.clear();
+
+    if ( lastSequence != 0 && m_changeLog.Covers( lastSequence ) )
+    {
+        const auto uiIdStr = session.PeerIdAsString();
+        const auto missed = m_changeLog.LastSequence() - lastSequence;
+        Log( spdlog::level::info, "{} resynced with {} change(s)", uiIdStr, missed );
+        PrintInfo( uiIdStr, " resynced with ", missed, " change(s)" );
+
+        m_changeLog.WriteSince( m_replyBuffer, lastSequence, format );
+    }
+    else
+    {
+        m_fullState.Write( m_replyBuffer, m_nodeCache, format );
+
+        ParsedMessage stale( MessageType::NodeStale );
+        for ( const auto nodeId : m_staleNodes )
+        {
+            stale.node.id = nodeId;
+            WriteMessage( m_replyBuffer, stale, format );
+        }
+    }
+
+    ParsedMessage sequence( MessageType::Sequence );
+    sequence.sequence = m_changeLog.LastSequence();
+    WriteMessage( m_replyBuffer, sequence, format );
+
+    session.SendMessage( m_replyBuffer );
+}
+
+void MessageEngine::SendHistory(
+    Session& session,
+    const NodeId nodeId,
+    const HistoryQuery& query,
+    const WireFormat format )
+{
+    m_historySamples.clear();
+    m_history.Query(
+        nodeId,
+        query.io,
+        query.maxSamples,
+        query.since,
+        query.until,
+        m_historySamples );
+
+    Log( spdlog::level::debug,
+         "{} requested {} history, sending {} sample(s)",
+         session.PeerIdAsString(),
+         to_string( nodeId ),
+         m_historySamples.size() );
+
+    // An IO that is not tracked gets an empty History rather than a NAK.
+    m_replyBuffer.clear();
+    WriteHistory( m_replyBuffer, nodeId, query.io, m_historySamples, format );
+    session.SendMessage( m_replyBuffer );
+}
+
+bool MessageEngine::BatchReceived()
+{
+    if ( !m_snapshotStale.load( std::memory_order_acquire ) )
+    {
+        return false;
+    }
+
+    const std::lock_guard lock( m_mutex );
+
+    // A message that is still waiting for the lock ends a batch of its own once it is handled.
+    if ( m_pendingMessages.load( std::memory_order_relaxed ) != 0 || !m_snapshots.HasChanges() )
+    {
+        return false;
+    }
+
+    // Publishing for every batch nobody reads would cost about as much as for every message.
+    const auto now = std::chrono::steady_clock::now();
+    if ( m_snapshotRequested.load( std::memory_order_relaxed ) ||
+         now - m_lastSnapshot >= busySnapshotInterval )
+    {
+        PublishSnapshot( now );
+        return false;
+    }
+
+    return true;
+}
+
+NodeStateSnapshotRef MessageEngine::AcquireNodeStates() const
+{
+    m_snapshotRequested.store( true, std::memory_order_relaxed );
+    return m_snapshots.Acquire();
+}
+
+void MessageEngine::SetWriteAheadLog( std::shared_ptr<WalWriter> pWal )
+{
+    const std::lock_guard lock( m_mutex );
+    m_pWal = std::move( pWal );
+}
+
+void MessageEngine::OmitSequenceNumbers()
+{
+    const std::lock_guard lock( m_mutex );
+    m_sendSequences = false;
+}
+
+void MessageEngine::AppendToWriteAheadLog( const ParsedMessage& msg )
+{
+    if ( m_pWal )
+    {
+        m_pWal->Append( msg, Now() );
+    }
+}
+
+void MessageEngine::RestoreNodeStates( const std::vector<Node>& nodes )
+{
+    const std::lock_guard lock( m_mutex );
+    for ( const auto& node : nodes )
+    {
+        m_nodeCache.Add( node );
+        m_fullState.NodeChanged( node.id );
+        m_staleNodes.insert( node.id );
+    }
+
+    m_snapshots.NodesAddedOrRemoved();
+    PublishNodeStates();
+    PublishSnapshot( std::chrono::steady_clock::now() );
+}
+
+void MessageEngine::PublishNodeStates()
+{
+    // Only the FullState segments and snapshot chunks of nodes whose values changed are rebuilt.
+    m_nodeCache.SweepChanges( [this]( const NodeId changedNodeId, const IO& ) {
+        m_fullState.NodeChanged( changedNodeId );
+        m_snapshots.NodeChanged( changedNodeId );
+    } );
+
+    if ( !m_snapshots.HasChanges() )
+    {
+        return;
+    }
+
+    // Publishing copies the chunk list and every changed chunk, which is too much to do for each
+    // message, so a busy engine only publishes now and then, and only for readers.
+    m_snapshotStale.store( true, std::memory_order_release );
+    if ( m_snapshotRequested.load( std::memory_order_relaxed ) )
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if ( now - m_lastSnapshot >= busySnapshotInterval )
+        {
+            PublishSnapshot( now );
+        }
+    }
+}
+
+void MessageEngine::PublishNodeStatesIfIdle()
+{
+    if ( m_pendingMessages.load( std::memory_order_relaxed ) == 0 && m_snapshots.HasChanges() )
+    {
+        PublishSnapshot( std::chrono::steady_clock::now() );
+    }
+}
+
+void MessageEngine::PublishSnapshot( const std::chrono::steady_clock::time_point now )
+{
+    m_snapshotRequested.store( false, std::memory_order_relaxed );
+    m_snapshotStale.store( false, std::memory_order_relaxed );
+    m_snapshots.Publish( m_nodeCache );
+    m_lastSnapshot = now;
+}
+
+Timestamp MessageEngine::Now()
+{
+    const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<Timestamp>(
+        std::chrono::duration_cast<std::chrono::milliseconds>( sinceEpoch ).count() );
+}
+
+SequenceNumber MessageEngine::InitialSequence()
+{
+    const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<SequenceNumber>(
+        std::chrono::duration_cast<std::chrono::microseconds>( sinceEpoch ).count() );
+}
+
 void MessageEngine::PeerDisconnected( std::weak_ptr<Session>&& pSession )
 {
+    const std::lock_guard lock( m_mutex );
     const auto pLockedSession = pSession.lock();
     if ( pLockedSession )
     {
         const auto peerId = pLockedSession->GetPeerId();
 
+        // Only the session a peer connected on removes it, not one whose connect was refused.
         if ( std::holds_alternative<UIId>( peerId ) )
         {
             const auto id = std::get<UIId>( peerId );
-            RemoveDisconnectedPeer( m_uiConnections, id );
+            if ( m_uiConnections.Holds( id, pLockedSession ) )
+            {
+                RemoveDisconnectedPeer( m_uiConnections, id );
+            }
         }
-        else if ( std::holds_alternative<NodeId>( peerId ) )
+        else if ( m_nodeConnections.Holds( std::get<NodeId>( peerId ), pLockedSession ) )
         {
             const auto id = std::get<NodeId>( peerId );
             RemoveDisconnectedPeer( m_nodeConnections, id );
             RemoveNodeFromCache( id );
 
-            ForwardMessageToUIs( BuildNodeDisconnect( id ) );
+            ParsedMessage disconnect( MessageType::NodeDisconnect );
+            disconnect.node.id = id;
+            m_changeLog.Record( disconnect );
+            AppendToWriteAheadLog( disconnect );
+
+            OutboundMessage outbound( disconnect, m_encodeBuffers );
+            ForwardMessageToUIs( outbound );
+            PublishNodeStates();
+            PublishNodeStatesIfIdle();
         }
     }
 
     PrintConnections();
 }
 
+void MessageEngine::AttachUI( std::weak_ptr<Session>&& pSession, const UIId id )
+{
+    const std::lock_guard lock( m_mutex );
+    const auto pLockedSession = pSession.lock();
+    if ( pLockedSession == nullptr )
+    {
+        return;
+    }
+
+    m_uiConnections.RemoveExpired();
+    m_uiConnections.Add( id, std::move( pSession ) );
+
+    const auto format = pLockedSession->GetWireFormat();
+    m_replyBuffer.clear();
+
+    ParsedMessage connect( MessageType::NodeConnect );
+    m_nodeCache.ForEachNode( [this, &connect, format]( const NodeCache::NodeView& node ) {
+        connect.node.id = node.id;
+        connect.node.io.clear();
+        for ( std::size_t index = 0; index < node.ioCount; ++index )
+        {
+            connect.node.io.push_back( node.IOAt( index ) );
+        }
+
+        WriteMessage( m_replyBuffer, connect, format );
+    } );
+
+    ParsedMessage stale( MessageType::NodeStale );
+    for ( const auto nodeId : m_staleNodes )
+    {
+        stale.node.id = nodeId;
+        WriteMessage( m_replyBuffer, stale, format );
+    }
+
+    if ( !m_replyBuffer.empty() )
+    {
+        pLockedSession->SendMessage( m_replyBuffer );
+    }
+}
+
+void MessageEngine::DetachUI( const std::shared_ptr<Session>& pSession, const UIId id )
+{
+    const std::lock_guard lock( m_mutex );
+    if ( m_uiConnections.Holds( id, pSession ) )
+    {
+        m_uiConnections.Remove( id );
+    }
+}
+
 template<typename T>
 void PrintContainer(
     std::ostringstream& oss, const T& container, const std::string& prefix, const char suffix )
 {
-    for ( const auto& item : container )
-    {
-        oss << prefix << to_string( item.Id() ) << suffix;
-    }
+    container.ForEach( [&]( const auto id, const std::weak_ptr<Session>& pWeak ) {
+        oss << prefix << to_string( id );
+
+        // Messages still queued to a peer are a sign that it cannot keep up.
+        const auto pSession = pWeak.lock();
+        if ( pSession && pSession->QueuedMessages() > 0 )
+        {
+            oss << " (" << pSession->QueuedMessages() << " message(s), "
+                << pSession->QueuedBytes() << " byte(s) queued)";
+        }
+
+        oss << suffix;
+    } );
 }
 
 void MessageEngine::PrintConnections() const
@@ -282,30 +623,14 @@ void MessageEngine::PrintConnections() const
 
 bool MessageEngine::IsNodeConnected( const NodeId id ) const
 {
-    return std::find_if(
-               m_nodeConnections.cbegin(),
-               m_nodeConnections.cend(),
-               [id]( const auto& connection ) { return connection.Id() == id; } ) !=
-           m_nodeConnections.cend();
+    return m_nodeConnections.Contains( id );
 }
 
-void MessageEngine::SendMessageToNode( const NodeId nodeId, const std::string& message )
+void MessageEngine::SendMessageToNode( const NodeId nodeId, OutboundMessage& message )
 {
-    const auto nodeConnection = std::find_if(
-        m_nodeConnections.cbegin(),
-        m_nodeConnections.cend(),
-        [nodeId]( const auto& connection ) { return connection.Id() == nodeId; } );
-
-    if ( nodeConnection != m_nodeConnections.cend() )
+    if ( const auto pLockedSession = m_nodeConnections.Lock( nodeId ) )
     {
-        if ( const auto pLockedSession = ( *nodeConnection ).Session().lock() )
-        {
-            pLockedSession->SendMessage( message );
-        }
-        else
-        {
-            PrintWarning( nodeId, " is not connected" );
-        }
+        pLockedSession->SendMessage( message.Shared( pLockedSession->GetWireFormat() ) );
     }
     else
     {
@@ -315,61 +640,84 @@ void MessageEngine::SendMessageToNode( const NodeId nodeId, const std::string& m
 
 void MessageEngine::AddConnection( std::weak_ptr<Session>&& pSession, const UIId id )
 {
-    RemoveExpiredSessions( m_uiConnections );
-    m_uiConnections.emplace( id, std::move( pSession ) );
+    m_uiConnections.RemoveExpired();
+    m_uiConnections.Add( id, std::move( pSession ) );
 
     PrintConnections();
 }
 
 void MessageEngine::AddConnection( std::weak_ptr<Session>&& pSession, const NodeId id )
 {
-    RemoveExpiredSessions( m_nodeConnections );
-    m_nodeConnections.emplace( id, std::move( pSession ) );
+    m_nodeConnections.RemoveExpired();
+    m_nodeConnections.Add( id, std::move( pSession ) );
 
     PrintConnections();
 }
 
-void MessageEngine::ForwardMessageToUIs( const std::string& message )
+void MessageEngine::ForwardMessageToUIs( OutboundMessage& message )
 {
-    for ( const auto& connection : m_uiConnections )
-    {
-        const auto pSession = connection.Session().lock();
-        if ( pSession )
+    m_uiConnections.ForEach( [&message]( const UIId, const std::weak_ptr<Session>& pWeak ) {
+        if ( const auto pSession = pWeak.lock() )
         {
-            pSession->SendMessage( message );
+            pSession->SendMessage( message.Shared( pSession->GetWireFormat() ) );
         }
-    }
+    } );
 }
 
-template<typename T>
-void MessageEngine::UpdateIOCache( const NodeId nodeId, const IOId ioId, const T newValue )
+void MessageEngine::ForwardUpdateToUIs( OutboundMessage& message, const Node& update )
 {
-    for ( auto& node : m_nodeStates )
-    {
-        if ( node.id == nodeId )
-        {
-            for ( auto& ioItem : node.io )
+    // Updates sent without a sequence number are merged without a Sequence.
+    const auto sequence = m_sendSequences ? m_changeLog.LastSequence() : SequenceNumber( 0 );
+
+    // The update is parsed into an arena that is reset once it is handled, so it is copied out
+    // once for every UI that is behind to share, and not at all while they all keep up.
+    std::shared_ptr<const Node> pUpdate;
+    m_uiConnections.ForEach(
+        [&message, &update, &pUpdate, sequence](
+            const UIId, const std::weak_ptr<Session>& pWeak ) {
+            const auto pSession = pWeak.lock();
+            if ( pSession == nullptr )
             {
-                if ( ioItem.id == ioId )
-                {
-                    ioItem.value = newValue;
-                }
+                return;
             }
-        }
-    }
+
+            const bool behind = pSession->QueuedMessages() != 0;
+            if ( behind && pUpdate == nullptr )
+            {
+                pUpdate = std::make_shared<const Node>( update );
+            }
+
+            pSession->SendUpdate(
+                message.Shared( pSession->GetWireFormat() ),
+                behind ? pUpdate : nullptr,
+                sequence );
+        } );
 }
 
-void MessageEngine::RemoveNodeFromCache( const NodeId nodeId )
+void MessageEngine::Reply( Session& session, const MessageType type, const ParsedMessage& msg )
 {
-    auto nodeIter = std::find_if(
-        begin( m_nodeStates ),
-        end( m_nodeStates ),
-        [nodeId]( const auto& existingNode ) { return nodeId == existingNode.id; } );
+    ParsedMessage reply( type );
+    reply.node.id = msg.node.id;
+    reply.ui = msg.ui;
 
-    if ( nodeIter != end( m_nodeStates ) )
-    {
-        m_nodeStates.erase( nodeIter );
-    }
+    m_replyBuffer.clear();
+    WriteMessage( m_replyBuffer, reply, session.GetWireFormat() );
+    session.SendMessage( m_replyBuffer );
+}
+
+template<typename T>
+void MessageEngine::UpdateIOCache( const NodeId nodeId, const IOId ioId, const T newValue )
+{
+    m_nodeCache.UpdateValue( nodeId, ioId, newValue );
+    m_history.Record( nodeId, ioId, newValue, Now() );
+}
+
+void MessageEngine::RemoveNodeFromCache( const NodeId nodeId )
+{
+    m_nodeCache.Remove( nodeId );
+    m_fullState.NodeRemoved( nodeId );
+    m_snapshots.NodesAddedOrRemoved();
+    m_history.RemoveNode( nodeId );
 }
 
 } // namespace sn
@@ -1,25 +1,53 @@
 #pragma once
 
+#include "change_log.hpp"
 #include "connection.hpp"
+#include "full_state_cache.hpp"
+#include "io_history.hpp"
+#include "message_handler.hpp"
 #include "messages.hpp"
+#include "node_cache.hpp"
+#include "node_state_snapshot.hpp"
+#include "outbound_message.hpp"
+#include "parse_result.hpp"
 
-#include <set>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_set>
+#include <vector>
 
 namespace sn
 {
 
 class Session;
+class WalWriter;
 enum class UIId;
 enum class NodeId;
 enum class IOId;
 
-class MessageEngine final
+/*!
+    @brief Keeps the state of every node and passes messages between nodes and UIs. Sessions on
+           any number of io threads may call MessageReceived() and PeerDisconnected() at once:
+           each message is parsed on the thread it arrived on, and only acting on it is
+           serialised, under a mutex that guards all of the state below.
+ */
+class MessageEngine final : public MessageHandler
 {
 public:
-    MessageEngine() = default;
+    //! The number of samples kept for each IO unless configured otherwise.
+    static constexpr std::size_t defaultHistoryDepth = 256;
+
+    /*!
+        @param[in] historyDepth The number of samples kept for each IO of every connected node.
+                   Must not be zero.
+     */
+    explicit MessageEngine( const std::size_t historyDepth = defaultHistoryDepth );
 
     /*!
         @brief Indicates that a message has been received from a remote peer.
@@ -27,15 +55,92 @@ public:
                    moved.
         @param[in] message The message that has been received.
      */
-    void MessageReceived( std::weak_ptr<Session>&& pSession, const std::string& message );
+    void MessageReceived(
+        std::weak_ptr<Session>&& pSession,
+        const std::string_view message ) override;
+
+    /*!
+        @brief Publishes a snapshot of the node states if they have changed, no other message is
+               being handled, and a reader has asked for one or the last is older than
+               busySnapshotInterval, see AcquireNodeStates().
+        @returns True if the snapshot was put off for being too recent.
+     */
+    bool BatchReceived() override;
 
     /*!
         @brief Indicates that the supplied peer has disconnected from the server.
         @param[in] pSession The session that is now disconnected.
      */
-    void PeerDisconnected( std::weak_ptr<Session>&& pSession );
+    void PeerDisconnected( std::weak_ptr<Session>&& pSession ) override;
+
+    /*!
+        @brief Starts forwarding changes to a UI whose UiConnect was handled elsewhere, e.g. by the
+               ShardedEngine this engine is a shard of, and sends it a NodeConnect for each node
+               and a NodeStale for each stale node. The UI is expected to have been sent a
+               FullState already, so the nodes are added to what it has.
+        @param[in] pSession The session of the UI. This value will be moved.
+        @param[in] id The ID the UI connected as.
+     */
+    void AttachUI( std::weak_ptr<Session>&& pSession, const UIId id );
+
+    /*!
+        @brief Stops forwarding changes to a UI attached with AttachUI().
+        @param[in] pSession The session of the UI, which is only detached if it is still the one
+                   attached with the ID.
+        @param[in] id The ID the UI connected as.
+     */
+    void DetachUI( const std::shared_ptr<Session>& pSession, const UIId id );
+
+    /*!
+        @brief Returns the latest snapshot of the state of every node. Unlike every other method,
+               this may be called from any thread, and it takes no lock. Snapshots are published
+               by the engine rather than here, when it ends a batch of messages or at most every
+               busySnapshotInterval while it stays busy, so the states returned may be a little
+               older than the last message handled. Calling this asks for a newer snapshot.
+     */
+    NodeStateSnapshotRef AcquireNodeStates() const;
+
+    /*!
+        @brief Restores the last known states of nodes, e.g. from before the server restarted. The
+               nodes are sent to UIs like any other, but marked stale until they connect again.
+               Must be called before any message is handled.
+        @param[in] nodes The nodes to restore.
+     */
+    void RestoreNodeStates( const std::vector<Node>& nodes );
+
+    /*!
+        @brief Sets the write-ahead log that every NodeConnect, NodeUpdate, UiUpdate and node
+               disconnect is appended to. Must be called before any message is handled.
+     */
+    void SetWriteAheadLog( std::shared_ptr<WalWriter> pWal );
+
+    /*!
+        @brief Stops the engine telling UIs which change they are up to when it merges updates
+               queued to them, as a shard does, since it numbers only the changes of its own nodes.
+               Must be called before any message is handled.
+     */
+    void OmitSequenceNumbers();
+
+    /*!
+        @brief Returns the current time, which history samples and snapshots are stamped with.
+     */
+    static Timestamp Now();
 
 private: // methods
+    /*!
+        @brief Acts on a message received from a remote peer. Must be called with m_mutex held.
+        @param[in] pSession The session from which the message was received. This value will be
+                   moved.
+        @param[in] pLockedSession The same session, locked.
+        @param[in] result The message parsed, which must not be kept once this returns.
+        @param[in] message The message that has been received.
+     */
+    void HandleMessage(
+        std::weak_ptr<Session>&& pSession,
+        const std::shared_ptr<Session>& pLockedSession,
+        const ParseResult<ParsedMessage>& result,
+        const std::string_view message );
+
     /*!
         @brief Returns true if the provided session represents a peer that has already
                sent a connect message (either UI or node).
@@ -60,10 +165,88 @@ private: // methods
     void AddConnection( std::weak_ptr<Session>&& pSession, const NodeId id );
 
     /*!
-        @brief Synchronously forwards the provided message to all connected UIs.
+        @brief Synchronously forwards the provided message to all connected UIs, in the protocol
+               each of them uses.
         @param[in] message The message to be forwarded.
      */
-    void ForwardMessageToUIs( const std::string& message );
+    void ForwardMessageToUIs( OutboundMessage& message );
+
+    /*!
+        @brief Forwards a NodeUpdate to all connected UIs like ForwardMessageToUIs(), letting the
+               session of a UI that is behind merge it with the updates it has not sent yet. Must
+               be called once the update has been recorded in the change log.
+        @param[in] message The NodeUpdate to be forwarded.
+        @param[in] update The node and the IOs it updated, which are copied for the sessions that
+                   are behind, so that they need not parse the message again.
+     */
+    void ForwardUpdateToUIs( OutboundMessage& message, const Node& update );
+
+    /*!
+        @brief Sends an ACK or NAK for a received message back to the peer that sent it.
+        @param[in] session The session the message was received on.
+        @param[in] type Either MessageType::Ack or MessageType::Nak.
+        @param[in] msg The message being acknowledged.
+     */
+    void Reply( Session& session, const MessageType type, const ParsedMessage& msg );
+
+    /*!
+        @brief Brings a UI that has just connected up to date. A UI that has been connected before
+               is sent the changes it missed if they are all still in the change log, otherwise
+               it is sent a FullState and told which of its nodes are stale. Either way, it is
+               then told the latest sequence number.
+        @param[in] session The session of the UI.
+        @param[in] lastSequence The last change the UI applied, or zero if it has none.
+        @param[in] format The protocol the UI uses.
+     */
+    void SendNodeStates(
+        Session& session,
+        const SequenceNumber lastSequence,
+        const WireFormat format );
+
+    /*!
+        @brief Answers a HistoryRequest with the samples of the requested IO.
+        @param[in] session The session of the UI that sent the request.
+        @param[in] nodeId The node the IO belongs to.
+        @param[in] query The IO and the samples requested.
+        @param[in] format The protocol the UI uses.
+     */
+    void SendHistory(
+        Session& session,
+        const NodeId nodeId,
+        const HistoryQuery& query,
+        const WireFormat format );
+
+    /*!
+        @brief Appends a change to the write-ahead log, if there is one.
+     */
+    void AppendToWriteAheadLog( const ParsedMessage& msg );
+
+    /*!
+        @brief Passes the nodes whose values changed since the last call on to the FullState cache
+               and the snapshot publisher, and publishes a new snapshot of the node states if a
+               reader has asked for one and the last is older than busySnapshotInterval.
+     */
+    void PublishNodeStates();
+
+    /*!
+        @brief Publishes a snapshot of the node states if they have changed since the last one and
+               no message is waiting to be handled.
+     */
+    void PublishNodeStatesIfIdle();
+
+    /*!
+        @brief Publishes a snapshot of the node states.
+        @param[in] now The time it is published at.
+     */
+    void PublishSnapshot( const std::chrono::steady_clock::time_point now );
+
+    /*!
+        @brief Returns the number the first change is stamped with after, which is the time the
+               server started in microseconds. A UI that last connected to a previous run of the
+               server therefore asks for changes from before the start of the log and is sent a
+               FullState, unless that run averaged more than a million changes a second.
+     */
+    static SequenceNumber InitialSequence();
 
     /*!
         @brief Prints all the active UI and Node connections to the console.
@@ -96,12 +279,49 @@ private: // methods
         @param[in] nodeId The node to which the message should be sent.
         @param[in] message The message to send.
      */
-    void SendMessageToNode( const NodeId nodeId, const std::string& message );
+    void SendMessageToNode( const NodeId nodeId, OutboundMessage& message );
 
 private: // data
-    std::set<Connection<UIId>> m_uiConnections;
-    std::set<Connection<NodeId>> m_nodeConnections;
-    std::vector<Node> m_nodeStates;
+    //! How old the last snapshot must be for the next to be published while the engine is busy,
+    //! or while nobody has asked for one.
+    static constexpr std::chrono::milliseconds busySnapshotInterval{ 100 };
+
+    // Guards everything below except the atomics. Readers acquire snapshots from m_snapshots
+    // without it.
+    mutable std::mutex m_mutex;
+
+    Connections<UIId> m_uiConnections;
+    Connections<NodeId> m_nodeConnections;
+    NodeCache m_nodeCache;
+    FullStateCache m_fullState;
+    NodeStatePublisher m_snapshots;
+    std::chrono::steady_clock::time_point m_lastSnapshot;
+
+    // Set by readers, for a busy engine to publish a snapshot for them.
+    mutable std::atomic<bool> m_snapshotRequested{ false };
+
+    // Set while the node states have changed since the last snapshot, so that the end of a batch
+    // only takes the lock if there is something to publish.
+    std::atomic<bool> m_snapshotStale{ false };
+
+    // The number of messages received and not yet handled.
+    std::atomic<std::size_t> m_pendingMessages{ 0 };
+    IOHistory m_history;
+
+    // Nodes restored from before a restart that have not connected since.
+    std::unordered_set<NodeId> m_staleNodes;
+
+    std::shared_ptr<WalWriter> m_pWal;
+    std::vector<HistorySample> m_historySamples;
+
+    static constexpr std::size_t changeLogCapacity = 4096;
+    ChangeLog m_changeLog{ changeLogCapacity, InitialSequence() };
+    bool m_sendSequences = true;
+
+    // Messages are encoded into these rather than into new strings. Sessions copy what they are
+    // sent before SendMessage() returns, so each buffer is free again once a send returns.
+    EncodeBuffers m_encodeBuffers;
+    std::string m_replyBuffer;
 };
 
 } // namespace sn
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+
+namespace sn
+{
+
+class Session;
+
+/*!
+    @brief What a session tells about its peer: the messages it receives and when it disconnects.
+           Sessions on any number of io threads may call both methods at once.
+ */
+class MessageHandler
+{
+public:
+    //! How long after a batch that put off work the handler should be called again.
+    static constexpr std::chrono::milliseconds batchRetryDelay{ 100 };
+
+    virtual ~MessageHandler() = default;
+
+    /*!
+        @brief Indicates that a message has been received from a remote peer.
+        @param[in] pSession The session from which the message was received. This value will be
+                   moved.
+        @param[in] message The message that has been received, which is only valid until this
+                   returns.
+     */
+    virtual void MessageReceived(
+        std::weak_ptr<Session>&& pSession,
+        const std::string_view message ) = 0;
+
+    /*!
+        @brief Indicates that a batch of messages, such as every message of one read, has been
+               passed to MessageReceived(), so that work put off until then can be done.
+        @returns True if some of that work is still put off, in which case this should be called
+                 again after batchRetryDelay if no other batch is received.
+     */
+    virtual bool BatchReceived() = 0;
+
+    /*!
+        @brief Indicates that the supplied peer has disconnected from the server.
+        @param[in] pSession The session that is now disconnected.
+     */
+    virtual void PeerDisconnected( std::weak_ptr<Session>&& pSession ) = 0;
+};
+
+} // namespace sn
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace sn
+{
+
+/*!
+    @brief A bounded queue that any number of threads may push to without a lock, and one thread
+           pops from. Values live in a ring of slots allocated up front, and are written over the
+           value last held by their slot, so a queue of values that own memory, such as strings,
+           stops allocating once each slot has held one large enough.
+
+           Each slot has a sequence number that tells whose turn it is: a producer claims the
+           slot at the back of the queue by moving the back on with a compare-and-swap, writes
+           its value, then hands the slot to the consumer by bumping its sequence, and the
+           consumer hands it back to the producers of the next lap the same way. Producers wait
+           while the queue is full.
+
+           Between claiming a slot and handing it over, the values pushed after it cannot be
+           reached yet, so Pop() may briefly report the queue empty while a push is still in
+           progress. A consumer that is told of each push once it returns, as ShardedEngine does,
+           never misses one.
+ */
+template<typename T>
+class MpscQueue final
+{
+public:
+    /*!
+        @param[in] capacity The most values the queue holds, rounded up to a power of two.
+     */
+    explicit MpscQueue( const std::size_t capacity )
+        : m_slots( RoundUpToPowerOfTwo( capacity ) )
+        , m_mask( m_slots.size() - 1 )
+    {
+        for ( std::size_t index = 0; index < m_slots.size(); ++index )
+        {
+            m_slots[index].sequence.store( index, std::memory_order_relaxed );
+        }
+    }
+
+    MpscQueue( const MpscQueue& ) = delete;
+    MpscQueue& operator=( const MpscQueue& ) = delete;
+
+    /*!
+        @brief Adds a value to the back of the queue, waiting while it is full. May be called from
+               any thread.
+        @param[in] fill Called with the slot's value, which holds whatever was last popped from
+                   it, to write the new value over it.
+     */
+    template<typename Fill>
+    void Push( Fill&& fill )
+    {
+        auto back = m_back.load( std::memory_order_relaxed );
+        while ( true )
+        {
+            auto& slot = m_slots[back & m_mask];
+            const auto sequence = slot.sequence.load( std::memory_order_acquire );
+
+            if ( sequence == back )
+            {
+                if ( m_back.compare_exchange_weak( back, back + 1, std::memory_order_relaxed ) )
+                {
+                    fill( slot.value );
+                    slot.sequence.store( back + 1, std::memory_order_release );
+                    return;
+                }
+            }
+            else
+            {
+                // The slot still holds a value from the last lap if the queue is full, or was
+                // claimed by another producer since back was read.
+                if ( sequence + m_slots.size() == back + 1 )
+                {
+                    std::this_thread::yield();
+                }
+
+                back = m_back.load( std::memory_order_relaxed );
+            }
+        }
+    }
+
+    /*!
+        @brief Passes the value at the front of the queue to use, then frees its slot. Must only
+               be called from the consumer thread.
+        @param[in] use Called with the value, which it may move from or leave for the next push
+                   to the slot to write over.
+        @returns False if the queue is empty.
+     */
+    template<typename Use>
+    bool Pop( Use&& use )
+    {
+        auto& slot = m_slots[m_front & m_mask];
+        if ( slot.sequence.load( std::memory_order_acquire ) != m_front + 1 )
+        {
+            return false;
+        }
+
+        use( slot.value );
+        slot.sequence.store( m_front + m_slots.size(), std::memory_order_release );
+        ++m_front;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        //! Equal to the position a producer may claim the slot at, or one past the position the
+        //! consumer may take its value at.
+        std::atomic<std::size_t> sequence{ 0 };
+        T value{};
+    };
+
+    static std::size_t RoundUpToPowerOfTwo( const std::size_t count )
+    {
+        std::size_t rounded = 1;
+        while ( rounded < count )
+        {
+            rounded *= 2;
+        }
+
+        return rounded;
+    }
+
+    std::vector<Slot> m_slots;
+    const std::size_t m_mask;
+
+    //! The position the next push claims.
+    alignas( 64 ) std::atomic<std::size_t> m_back{ 0 };
+
+    //! The position the next pop takes. Only used by the consumer.
+    alignas( 64 ) std::size_t m_front = 0;
+};
+
+} // namespace sn
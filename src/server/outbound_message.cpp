@@ -0,0 +1,55 @@
+#include "outbound_message.hpp"
+#include "message_builder.hpp"
+
+namespace sn
+{
+
+std::size_t FormatIndex( const WireFormat format )
+{
+    return static_cast<std::size_t>( format );
+}
+
+OutboundMessage::OutboundMessage( const ParsedMessage& msg, EncodeBuffers& buffers )
+    : m_msg( msg )
+    , m_encoded()
+    , m_shared()
+    , m_buffers( buffers )
+{}
+
+OutboundMessage::OutboundMessage(
+    const ParsedMessage& msg,
+    EncodeBuffers& buffers,
+    const WireFormat format,
+    const std::string_view encoded )
+    : OutboundMessage( msg, buffers )
+{
+    m_encoded[FormatIndex( format )] = encoded;
+}
+
+std::string_view OutboundMessage::Encoded( const WireFormat format )
+{
+    const auto index = FormatIndex( format );
+
+    if ( !m_encoded[index] )
+    {
+        auto& buffer = m_buffers[index];
+        buffer.clear();
+        WriteMessage( buffer, m_msg, format );
+        m_encoded[index] = buffer;
+    }
+
+    return *m_encoded[index];
+}
+
+SharedBuffer OutboundMessage::Shared( const WireFormat format )
+{
+    auto& shared = m_shared[FormatIndex( format )];
+    if ( shared.Size() == 0 )
+    {
+        shared = SharedBuffer( Encoded( format ) );
+    }
+
+    return shared;
+}
+
+} // namespace sn
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "messages.hpp"
+#include "shared_buffer.hpp"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace sn
+{
+
+/*!
+    @brief Reusable buffers that an OutboundMessage encodes into, one for each WireFormat. Reusing
+           them across messages means encoding does not allocate once they have grown large
+           enough.
+ */
+using EncodeBuffers = std::array<std::string, 2>;
+
+/*!
+    @brief A message that is about to be sent to one or more peers. The message is held in its
+           decoded form and is encoded at most once for each protocol, the first time a recipient
+           using that protocol needs it, so forwarding does not re-encode per recipient. Likewise
+           it is copied into at most one SharedBuffer for each protocol, which every recipient's
+           send queue shares.
+ */
+class OutboundMessage final
+{
+public:
+    /*!
+        @param[in] msg The decoded message. Must outlive this object.
+        @param[in] buffers The buffers to encode into. Their contents are overwritten, and they
+                   must not be used by anything else while this object is alive.
+     */
+    OutboundMessage( const ParsedMessage& msg, EncodeBuffers& buffers );
+
+    /*!
+        @param[in] msg The decoded message. Must outlive this object.
+        @param[in] buffers The buffers to encode into, as above.
+        @param[in] format The protocol the message was received in.
+        @param[in] encoded The message as it was received. Must outlive this object.
+     */
+    OutboundMessage(
+        const ParsedMessage& msg,
+        EncodeBuffers& buffers,
+        const WireFormat format,
+        const std::string_view encoded );
+
+    /*!
+        @brief Returns the message encoded in the requested protocol.
+     */
+    std::string_view Encoded( const WireFormat format );
+
+    /*!
+        @brief Returns the message encoded in the requested protocol, as a buffer that can be
+               queued to any number of sessions.
+     */
+    SharedBuffer Shared( const WireFormat format );
+
+private:
+    const ParsedMessage& m_msg;
+    std::array<std::optional<std::string_view>, 2> m_encoded;
+    std::array<SharedBuffer, 2> m_shared;
+    EncodeBuffers& m_buffers;
+};
+
+} // namespace sn
@@ -1,10 +1,15 @@
 #include "session.hpp"
 #include "console_printer.hpp"
-#include "message_engine.hpp"
+#include "message_handler.hpp"
 #include "id_types.hpp"
 #include "logger.hpp"
 #include "data_types.hpp"
+#include "binary_protocol.hpp"
 
+#include <boost/asio/dispatch.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
 #include <sstream>
 
 namespace sn
@@ -13,83 +18,334 @@ namespace sn
 Session::Session(
     boost::asio::ip::tcp::socket&& socket,
     const std::string& serverName,
-    const std::shared_ptr<MessageEngine>& pMsgEngine )
+    const std::shared_ptr<MessageHandler>& pMsgHandler )
     : m_ws( std::move( socket ) )
     , m_buffer()
+    , m_upgradeRequest()
+    , m_wireFormat( WireFormat::Text )
+    , m_framer()
+    , m_batchTimer( m_ws.get_executor() )
+    , m_batchTimerArmed( false )
     , m_serverName( serverName )
-    , m_pMsgEngine( pMsgEngine )
+    , m_pMsgHandler( pMsgHandler )
     , m_peerAddress()
     , m_peerPort()
+    , m_peerId( PackPeerId( UIId() ) )
+    , m_malformedMessages( 0 )
+    , m_sendQueue()
+    , m_writeFailed( false )
+    , m_queuedMessages( 0 )
+    , m_queuedBytes( 0 )
 {
     // Nothing to do here.
 }
 
+/*!
+    @brief Returns true if the WebSocket upgrade request offers the provided subprotocol.
+ */
+bool OffersSubprotocol(
+    const boost::beast::http::request<boost::beast::http::string_body>& request,
+    const std::string_view subprotocol )
+{
+    const auto offered = request[boost::beast::http::field::sec_websocket_protocol];
+    std::string_view remaining( offered.data(), offered.size() );
+
+    while ( !remaining.empty() )
+    {
+        const auto separator = remaining.find( ',' );
+        const auto token = remaining.substr( 0, separator );
+        const auto first = token.find_first_not_of( " \t" );
+
+        if ( first != std::string_view::npos &&
+             token.substr( first, token.find_last_not_of( " \t" ) - first + 1 ) == subprotocol )
+        {
+            return true;
+        }
+
+        remaining = separator == std::string_view::npos ? std::string_view()
+                                                        : remaining.substr( separator + 1 );
+    }
+
+    return false;
+}
+
 void Session::Run()
 {
+    // Read the upgrade request ourselves so that the subprotocol can be negotiated.
+    boost::beast::get_lowest_layer( m_ws ).expires_after( std::chrono::seconds( 30 ) );
+    boost::beast::http::async_read(
+        m_ws.next_layer(),
+        m_buffer,
+        m_upgradeRequest,
+        boost::beast::bind_front_handler( &Session::OnUpgradeRequest, shared_from_this() ) );
+}
+
+void Session::OnUpgradeRequest( boost::beast::error_code ec, std::size_t )
+{
+    if ( ec )
+    {
+        Log( spdlog::level::err, "Failed to read upgrade request: {}", ec.message() );
+        return PrintError( "OnUpgradeRequest: ", ec.message() );
+    }
+
+    // The websocket stream has its own timeout system.
+    boost::beast::get_lowest_layer( m_ws ).expires_never();
+    m_buffer.consume( m_buffer.size() );
+
+    if ( OffersSubprotocol( m_upgradeRequest, binarySubprotocol ) )
+    {
+        m_wireFormat = WireFormat::Binary;
+        m_framer = MessageFramer( WireFormat::Binary );
+        m_ws.binary( true );
+    }
+
     // Set suggested timeout settings for the websocket
     m_ws.set_option( boost::beast::websocket::stream_base::timeout::suggested(
         boost::beast::role_type::server ) );
 
-    // Set a decorator to change the Server of the handshake
+    // Set a decorator to change the Server of the handshake and confirm the subprotocol
     const std::string serverName( m_serverName );
+    const bool isBinary = m_wireFormat == WireFormat::Binary;
     m_ws.set_option( boost::beast::websocket::stream_base::decorator(
-        [serverName]( boost::beast::websocket::response_type& res ) {
+        [serverName, isBinary]( boost::beast::websocket::response_type& res ) {
             res.set(
                 boost::beast::http::field::server,
                 std::string( BOOST_BEAST_VERSION_STRING ) + " " + serverName );
+
+            if ( isBinary )
+            {
+                res.set(
+                    boost::beast::http::field::sec_websocket_protocol,
+                    std::string( binarySubprotocol ) );
+            }
         } ) );
 
     // Accept the websocket handshake
-    m_ws.async_accept( boost::beast::bind_front_handler( &Session::OnAccept, shared_from_this() ) );
+    m_ws.async_accept(
+        m_upgradeRequest,
+        boost::beast::bind_front_handler( &Session::OnAccept, shared_from_this() ) );
 }
 
-void Session::SendMessage( const std::string& message )
+void Session::SendMessage( const std::string_view message )
 {
-    boost::beast::error_code ec;
-    m_ws.write( boost::asio::buffer( message ), ec );
+    SendMessage( SharedBuffer( message ) );
+}
 
-    if ( ec )
+void Session::SendMessage( SharedBuffer message )
+{
+    m_queuedMessages.fetch_add( 1, std::memory_order_relaxed );
+    m_queuedBytes.fetch_add( message.Size(), std::memory_order_relaxed );
+
+    // Runs straight away if called on the strand of this session, e.g. to reply to the peer,
+    // otherwise once the strand is free.
+    boost::asio::dispatch(
+        m_ws.get_executor(),
+        [pSelf = shared_from_this(), queued = std::move( message )]() mutable {
+            pSelf->QueueMessage( std::move( queued ) );
+        } );
+}
+
+void Session::SendUpdate(
+    SharedBuffer message,
+    std::shared_ptr<const Node> pUpdate,
+    const SequenceNumber sequence )
+{
+    m_queuedMessages.fetch_add( 1, std::memory_order_relaxed );
+    m_queuedBytes.fetch_add( message.Size(), std::memory_order_relaxed );
+
+    boost::asio::dispatch(
+        m_ws.get_executor(),
+        [pSelf = shared_from_this(),
+         queued = std::move( message ),
+         pQueuedUpdate = std::move( pUpdate ),
+         sequence]() mutable {
+            pSelf->QueueUpdate( std::move( queued ), std::move( pQueuedUpdate ), sequence );
+        } );
+}
+
+std::size_t Session::QueuedMessages() const
+{
+    return m_queuedMessages.load( std::memory_order_relaxed );
+}
+
+std::size_t Session::QueuedBytes() const
+{
+    return m_queuedBytes.load( std::memory_order_relaxed );
+}
+
+void Session::QueueMessage( SharedBuffer&& message )
+{
+    if ( m_writeFailed )
+    {
+        // The connection is broken, and the failure has already been reported.
+        MessageDequeued( message.Size() );
+        return;
+    }
+
+    m_sendQueue.push_back( QueuedMessage{ std::move( message ), nullptr } );
+    if ( m_sendQueue.size() == 1 )
     {
-        Log( spdlog::level::err, "Failed to write message: {}", message );
-        PrintError( "Failed to write message:\n", message, "\n\n" );
+        DoWrite();
     }
 }
 
-std::variant<UIId, NodeId> Session::GetPeerId() const
+void Session::QueueUpdate(
+    SharedBuffer&& message,
+    std::shared_ptr<const Node>&& pUpdate,
+    const SequenceNumber sequence )
 {
-    return m_peerId;
+    // Only a UI that is behind has its updates merged, so one that keeps up never pays for it.
+    if ( m_writeFailed || m_sendQueue.empty() || pUpdate == nullptr )
+    {
+        return QueueMessage( std::move( message ) );
+    }
+
+    auto& back = m_sendQueue.back();
+    const bool canMerge = m_sendQueue.size() > 1 && back.pUpdates != nullptr;
+
+    const auto& update = *pUpdate;
+    if ( canMerge )
+    {
+        back.pUpdates->Merge( update, sequence );
+        MessageDequeued( message.Size() );
+        return;
+    }
+
+    // Until another update is merged in, the message is sent as it is.
+    auto pUpdates = std::make_unique<ConflatedUpdates>();
+    pUpdates->Merge( update, sequence );
+    m_sendQueue.push_back( QueuedMessage{ std::move( message ), std::move( pUpdates ) } );
 }
 
-std::string Session::PeerIdAsString() const
+void Session::DoWrite()
 {
-    std::ostringstream oss;
-
-    if ( std::holds_alternative<UIId>( m_peerId ) )
+    auto& front = m_sendQueue.front();
+    if ( front.pUpdates && front.pUpdates->Count() > 1 )
     {
-        oss << std::get<UIId>( m_peerId );
-        return oss.str();
+        std::string merged;
+        front.pUpdates->Write( merged, m_wireFormat );
+
+        m_queuedBytes.fetch_add( merged.size(), std::memory_order_relaxed );
+        m_queuedBytes.fetch_sub( front.message.Size(), std::memory_order_relaxed );
+        front.message = SharedBuffer( merged );
     }
-    else if ( std::holds_alternative<NodeId>( m_peerId ) )
+
+    front.pUpdates.reset();
+
+    const auto message = front.message.View();
+    m_ws.async_write(
+        boost::asio::buffer( message.data(), message.size() ),
+        boost::beast::bind_front_handler( &Session::OnWrite, shared_from_this() ) );
+}
+
+void Session::OnWrite( boost::beast::error_code ec, std::size_t )
+{
+    if ( ec )
     {
-        oss << std::get<NodeId>( m_peerId );
-        return oss.str();
+        const auto peerId = PeerIdAsString();
+        Log( spdlog::level::err,
+             "Failed to write to {}, dropping {} queued message(s): {}",
+             peerId,
+             m_sendQueue.size(),
+             ec.message() );
+        PrintError( "OnWrite: ", peerId, ": ", ec.message() );
+
+        m_writeFailed = true;
+        for ( const auto& queued : m_sendQueue )
+        {
+            MessageDequeued( queued.message.Size() );
+        }
+
+        m_sendQueue.clear();
+        return;
     }
-    else
+
+    MessageDequeued( m_sendQueue.front().message.Size() );
+    m_sendQueue.pop_front();
+
+    if ( !m_sendQueue.empty() )
     {
-        return "[No peer ID set]";
+        DoWrite();
     }
 }
 
-PeerType Session::GetPeerType() const
+void Session::MessageDequeued( const std::size_t size )
 {
-    if ( std::holds_alternative<UIId>( m_peerId ) )
+    m_queuedMessages.fetch_sub( 1, std::memory_order_relaxed );
+    m_queuedBytes.fetch_sub( size, std::memory_order_relaxed );
+}
+
+// Set once a node has connected on the session.
+constexpr std::uint64_t nodePeerFlag = std::uint64_t( 1 ) << 32;
+
+std::uint64_t Session::PackPeerId( const UIId id )
+{
+    return static_cast<std::uint32_t>( id );
+}
+
+std::uint64_t Session::PackPeerId( const NodeId id )
+{
+    return nodePeerFlag | static_cast<std::uint32_t>( id );
+}
+
+std::variant<UIId, NodeId> Session::GetPeerId() const
+{
+    const auto packed = m_peerId.load( std::memory_order_acquire );
+    const auto id = static_cast<std::uint32_t>( packed );
+
+    if ( ( packed & nodePeerFlag ) != 0 )
     {
-        return PeerType::UI;
+        return static_cast<NodeId>( id );
     }
-    else
+
+    return static_cast<UIId>( id );
+}
+
+std::string Session::PeerIdAsString() const
+{
+    std::ostringstream oss;
+    std::visit( [&oss]( const auto id ) { oss << id; }, GetPeerId() );
+    return oss.str();
+}
+
+WireFormat Session::GetWireFormat() const
+{
+    return m_wireFormat;
+}
+
+void Session::ReportMalformedMessage( const ParseFailure& failure )
+{
+    // A peer that floods garbage would otherwise stall every other peer while the console catches
+    // up, so only the 1st, 2nd, 4th, 8th, ... malformed message from each session is reported.
+    const auto count = m_malformedMessages.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    if ( ( count & ( count - 1 ) ) != 0 )
     {
-        return PeerType::Node;
+        return;
     }
+
+    const auto peerId = PeerIdAsString();
+    const auto error = to_string( failure.error );
+
+    Log( spdlog::level::warn,
+         "{} malformed message(s) from {}, latest: {} at byte {}",
+         count,
+         peerId,
+         error,
+         failure.offset );
+    PrintWarning(
+        count,
+        " malformed message(s) from ",
+        peerId,
+        ", latest: ",
+        error,
+        " at byte ",
+        failure.offset );
+}
+
+PeerType Session::GetPeerType() const
+{
+    const auto packed = m_peerId.load( std::memory_order_acquire );
+    return ( packed & nodePeerFlag ) != 0 ? PeerType::Node : PeerType::UI;
 }
 
 void Session::OnAccept( boost::beast::error_code ec )
@@ -120,7 +376,7 @@ void Session::OnRead( boost::beast::error_code ec, std::size_t bytes_transferred
     // This indicates that the session was closed
     if ( ec == boost::beast::websocket::error::closed )
     {
-        m_pMsgEngine->PeerDisconnected( shared_from_this() );
+        m_pMsgHandler->PeerDisconnected( shared_from_this() );
 
         Log( spdlog::level::debug, "{}:{} disconnected", m_peerAddress.to_string(), m_peerPort );
         return;
@@ -134,16 +390,50 @@ void Session::OnRead( boost::beast::error_code ec, std::size_t bytes_transferred
     {
         Log( spdlog::level::debug, "Received {} bytes", bytes_transferred );
 
-        std::stringstream ss;
-        ss << boost::beast::make_printable( m_buffer.data() );
-        m_pMsgEngine->MessageReceived( weak_from_this(), ss.str() );
+        // A single read may hold several messages, or only part of one.
+        const auto data = m_buffer.data();
+        m_framer.Append( std::string_view( static_cast<const char*>( data.data() ), data.size() ) );
 
         // Clear the buffer
         m_buffer.consume( m_buffer.size() );
 
+        const auto discardedBefore = m_framer.DiscardedBytes();
+        while ( const auto message = m_framer.Next() )
+        {
+            m_pMsgHandler->MessageReceived( weak_from_this(), *message );
+        }
+
+        EndBatch();
+
+        // Bytes that were not part of a complete message never reach the handler, so they are
+        // reported here, as one malformed message per read.
+        if ( m_framer.DiscardedBytes() != discardedBefore )
+        {
+            ReportMalformedMessage( ParseFailure{ ParseError::InvalidFraming, 0 } );
+        }
+
         // Queue up another read
         DoRead();
     }
 }
 
+void Session::EndBatch()
+{
+    // Only one retry is waited for at a time, as a batch ended while it is armed ends with it.
+    if ( !m_pMsgHandler->BatchReceived() || m_batchTimerArmed )
+    {
+        return;
+    }
+
+    m_batchTimerArmed = true;
+    m_batchTimer.expires_after( MessageHandler::batchRetryDelay );
+    m_batchTimer.async_wait( [pSelf = shared_from_this()]( boost::beast::error_code ec ) {
+        pSelf->m_batchTimerArmed = false;
+        if ( !ec )
+        {
+            pSelf->EndBatch();
+        }
+    } );
+}
+
 } // namespace sn
@@ -9,23 +9,33 @@
 #pragma warning( disable : 4265 )
 #endif
 
+#include <boost/asio/steady_timer.hpp>
 #include <boost/beast/core.hpp>
+#include <boost/beast/http/string_body.hpp>
 #include <boost/beast/websocket.hpp>
 
 #ifdef _MSC_VER
 #pragma warning( pop )
 #endif
 
+#include "conflated_updates.hpp"
+#include "message_framer.hpp"
+#include "messages.hpp"
+#include "parse_result.hpp"
+#include "shared_buffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <variant>
 
 namespace sn
 {
 
-class MessageEngine;
-enum class UIId;
-enum class NodeId;
-enum class PeerType;
+class MessageHandler;
 
 class Session final : public std::enable_shared_from_this<Session>
 {
@@ -34,16 +44,55 @@ public:
     Session(
         boost::asio::ip::tcp::socket&& socket,
         const std::string& serverName,
-        const std::shared_ptr<MessageEngine>& pMsgEngine );
+        const std::shared_ptr<MessageHandler>& pMsgHandler );
 
     // Start the asynchronous operation
     void Run();
 
     /*!
-        @brief Synchronously send the provided message to the remote peer.
+        @brief Queues the provided message to be sent to the remote peer and returns without
+               waiting for it to be written. Messages are written one at a time, in the order they
+               were queued, on the strand of the session.
+        @param[in] message The message to be sent to the remote peer. It is copied, so the caller
+                   may reuse its buffer as soon as this returns.
+     */
+    void SendMessage( const std::string_view message );
+
+    /*!
+        @brief Queues the provided message as above, without copying it. Sending one message to
+               many peers this way shares a single buffer between their queues.
         @param[in] message The message to be sent to the remote peer.
      */
-    void SendMessage( const std::string& message );
+    void SendMessage( SharedBuffer message );
+
+    /*!
+        @brief Queues a NodeUpdate to be sent to a UI. While messages before it are still queued,
+               it is merged with the NodeUpdates queued since the last message of any other kind,
+               so a UI that cannot keep up is only sent the newest value of each IO, once the
+               socket is ready for it.
+        @param[in] message The NodeUpdate, in the protocol of the peer.
+        @param[in] pUpdate The node and the IOs the message updates, which can be shared with the
+                   other UIs sent it, or null if the UI was keeping up, in which case the message
+                   is only queued as it is.
+        @param[in] sequence The change the update was recorded as, or zero for merged updates to be
+                   sent without a Sequence.
+     */
+    void SendUpdate(
+        SharedBuffer message,
+        std::shared_ptr<const Node> pUpdate,
+        const SequenceNumber sequence );
+
+    /*!
+        @brief Returns the number of messages queued to the peer that have not been written yet.
+               May be called from any thread.
+     */
+    std::size_t QueuedMessages() const;
+
+    /*!
+        @brief Returns the total size of the messages queued to the peer that have not been
+               written yet. May be called from any thread.
+     */
+    std::size_t QueuedBytes() const;
 
     /*!
         @brief Sets the ID of the connected peer represented by this session.
@@ -52,7 +101,7 @@ public:
     template<typename T>
     void SetPeerId( const T id )
     {
-        m_peerId = id;
+        m_peerId.store( PackPeerId( id ), std::memory_order_release );
     }
 
     /*!
@@ -70,21 +119,96 @@ public:
      */
     PeerType GetPeerType() const;
 
+    /*!
+        @brief Returns the protocol negotiated with the peer during the handshake.
+     */
+    WireFormat GetWireFormat() const;
+
+    /*!
+        @brief Reports a message from the peer that could not be parsed, throttled so that a peer
+               sending a stream of malformed messages cannot flood the console. May be called from
+               any thread.
+        @param[in] failure Why the message was rejected.
+     */
+    void ReportMalformedMessage( const ParseFailure& failure );
+
 private:
+    void OnUpgradeRequest( boost::beast::error_code ec, std::size_t bytes_transferred );
+
     void OnAccept( boost::beast::error_code ec );
 
     void DoRead();
 
     void OnRead( boost::beast::error_code ec, std::size_t bytes_transferred );
 
+    /*!
+        @brief Ends a batch of messages passed to the handler, and if it puts off work, calls it
+               again once the retry delay has passed.
+     */
+    void EndBatch();
+
+    /*!
+        @brief Adds a message to the send queue, starting a write if none is in progress. Must be
+               called on the strand of the session.
+     */
+    void QueueMessage( SharedBuffer&& message );
+
+    /*!
+        @brief Adds a NodeUpdate to the send queue like QueueMessage(), merging it into the
+               updates at the back of the queue if they have not started being written. Must be
+               called on the strand of the session.
+     */
+    void QueueUpdate(
+        SharedBuffer&& message,
+        std::shared_ptr<const Node>&& pUpdate,
+        const SequenceNumber sequence );
+
+    void DoWrite();
+
+    void OnWrite( boost::beast::error_code ec, std::size_t bytes_transferred );
+
+    /*!
+        @brief Removes a message from the queue counts once it has been written or dropped.
+     */
+    void MessageDequeued( const std::size_t size );
+
+    static std::uint64_t PackPeerId( const UIId id );
+
+    static std::uint64_t PackPeerId( const NodeId id );
+
 private:
     boost::beast::websocket::stream<boost::beast::tcp_stream> m_ws;
-    boost::beast::multi_buffer m_buffer;
+    boost::beast::flat_buffer m_buffer;
+    boost::beast::http::request<boost::beast::http::string_body> m_upgradeRequest;
+    WireFormat m_wireFormat;
+    MessageFramer m_framer;
+    boost::asio::steady_timer m_batchTimer;
+    bool m_batchTimerArmed;
     const std::string m_serverName;
-    const std::shared_ptr<MessageEngine> m_pMsgEngine;
+    const std::shared_ptr<MessageHandler> m_pMsgHandler;
     boost::asio::ip::address m_peerAddress;
     unsigned short m_peerPort;
-    std::variant<UIId, NodeId> m_peerId;
+    // Whether the peer is a node in the high half and its ID in the low half, so that the peer
+    // can be identified on one thread while messages from it are read on another.
+    std::atomic<std::uint64_t> m_peerId;
+    std::atomic<std::size_t> m_malformedMessages;
+
+    struct QueuedMessage
+    {
+        SharedBuffer message;
+
+        // Set for NodeUpdates that were merged, which are only encoded, replacing the message
+        // they were merged into, once they reach the front of the queue.
+        std::unique_ptr<ConflatedUpdates> pUpdates;
+    };
+
+    // Only used on the strand of the session. The message at the front is being written.
+    std::deque<QueuedMessage> m_sendQueue;
+    bool m_writeFailed;
+
+    // Counted from the moment a message is handed to SendMessage() until it is written.
+    std::atomic<std::size_t> m_queuedMessages;
+    std::atomic<std::size_t> m_queuedBytes;
 };
 
 } // namespace sn
@@ -0,0 +1,405 @@
+#include "sharded_engine.hpp"
+#include "console_printer.hpp"
+#include "id_types.hpp"
+#include "logger.hpp"
+#include "message_builder.hpp"
+#include "message_engine.hpp"
+#include "mpsc_queue.hpp"
+#include "parser.hpp"
+#include "session.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+
+namespace sn
+{
+
+/*!
+    @brief Something for a shard to do on its own thread.
+ */
+struct ShardedEngine::Task
+{
+    enum class Kind
+    {
+        Message,
+        Disconnect,
+        AttachUI,
+        DetachUI
+    };
+
+    Kind kind = Kind::Message;
+
+    // Held until the task has been done, so that a session that disconnects is still there for
+    // the shard to remove.
+    std::shared_ptr<Session> pSession;
+
+    // Kept once the task is done, so that the next task queued to its slot reuses its memory.
+    std::string message;
+    UIId uiId;
+};
+
+/*!
+    @brief A message engine with a thread that does the tasks queued to it, in order.
+ */
+class ShardedEngine::Shard final
+{
+public:
+    explicit Shard( const std::size_t historyDepth )
+        : m_pEngine( std::make_shared<MessageEngine>( historyDepth ) )
+        , m_tasks( queueCapacity )
+        , m_thread( [this]() { Run(); } )
+    {
+        // The thread only uses the engine for tasks, which are all pushed after this.
+        m_pEngine->OmitSequenceNumbers();
+    }
+
+    ~Shard()
+    {
+        Stop();
+    }
+
+    /*!
+        @brief Queues a task, waiting while the queue is full. May be called from any thread.
+     */
+    void Push(
+        const Task::Kind kind,
+        std::shared_ptr<Session> pSession,
+        const std::string_view message,
+        const UIId uiId )
+    {
+        m_tasks.Push( [&]( Task& task ) {
+            task.kind = kind;
+            task.pSession = std::move( pSession );
+            task.message.assign( message );
+            task.uiId = uiId;
+        } );
+
+        // The thread only waits once it has done every task counted, so it only needs waking for
+        // the first task queued after that.
+        if ( m_queued.fetch_add( 1, std::memory_order_acq_rel ) == 0 )
+        {
+            std::lock_guard lock( m_mutex );
+            m_cv.notify_one();
+        }
+    }
+
+    /*!
+        @brief Does every task queued so far and stops the thread.
+     */
+    void Stop()
+    {
+        {
+            std::lock_guard lock( m_mutex );
+            m_stopping = true;
+        }
+
+        m_cv.notify_one();
+        if ( m_thread.joinable() )
+        {
+            m_thread.join();
+        }
+    }
+
+    MessageEngine& Engine()
+    {
+        return *m_pEngine;
+    }
+
+    std::shared_ptr<const MessageEngine> SharedEngine() const
+    {
+        return m_pEngine;
+    }
+
+private:
+    void Run()
+    {
+        // Set while the engine has work put off, for which it is woken up again even if nothing
+        // is queued.
+        bool batchPutOff = false;
+
+        while ( true )
+        {
+            bool stopping = false;
+            {
+                const auto ready = [this]() {
+                    return m_stopping || m_queued.load( std::memory_order_acquire ) != 0;
+                };
+
+                std::unique_lock lock( m_mutex );
+                if ( batchPutOff )
+                {
+                    m_cv.wait_for( lock, MessageHandler::batchRetryDelay, ready );
+                }
+                else
+                {
+                    m_cv.wait( lock, ready );
+                }
+
+                stopping = m_stopping;
+            }
+
+            std::size_t done = 0;
+            while ( m_tasks.Pop( [this]( Task& task ) { Do( task ); } ) )
+            {
+                ++done;
+            }
+
+            batchPutOff = m_pEngine->BatchReceived();
+
+            // A task may be done before it is counted, in which case the count briefly wraps
+            // around until the push that queued it catches up.
+            m_queued.fetch_sub( done, std::memory_order_acq_rel );
+
+            if ( stopping && m_queued.load( std::memory_order_acquire ) == 0 )
+            {
+                return;
+            }
+        }
+    }
+
+    void Do( Task& task )
+    {
+        // The session is let go of once the task is done, and the message kept for the next task
+        // queued to the slot unless it was unusually long.
+        const auto pSession = std::move( task.pSession );
+
+        switch ( task.kind )
+        {
+        case Task::Kind::Message:
+            m_pEngine->MessageReceived( pSession, task.message );
+            break;
+
+        case Task::Kind::Disconnect:
+            m_pEngine->PeerDisconnected( pSession );
+            break;
+
+        case Task::Kind::AttachUI:
+            m_pEngine->AttachUI( pSession, task.uiId );
+            break;
+
+        case Task::Kind::DetachUI:
+            m_pEngine->DetachUI( pSession, task.uiId );
+            break;
+        }
+
+        if ( task.message.capacity() > retainedMessageCapacity )
+        {
+            task.message = std::string();
+        }
+    }
+
+private:
+    const std::shared_ptr<MessageEngine> m_pEngine;
+
+    //! How many tasks may be queued before pushing waits for the thread to catch up.
+    static constexpr std::size_t queueCapacity = 4096;
+
+    //! The longest message whose memory a queue slot keeps for the next.
+    static constexpr std::size_t retainedMessageCapacity = 1024;
+
+    MpscQueue<Task> m_tasks;
+
+    // The number of tasks pushed and not yet done.
+    std::atomic<std::size_t> m_queued{ 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping = false;
+
+    std::thread m_thread;
+};
+
+ShardedEngine::ShardedEngine( const std::size_t shardCount, const std::size_t historyDepth )
+{
+    for ( std::size_t index = 0; index < shardCount; ++index )
+    {
+        m_shards.push_back( std::make_unique<Shard>( historyDepth ) );
+    }
+}
+
+ShardedEngine::~ShardedEngine()
+{
+    Stop();
+}
+
+void ShardedEngine::Stop()
+{
+    for ( auto& pShard : m_shards )
+    {
+        pShard->Stop();
+    }
+}
+
+std::size_t ShardedEngine::ShardOf( const NodeId id ) const
+{
+    return static_cast<std::size_t>( static_cast<unsigned>( id ) ) % m_shards.size();
+}
+
+void ShardedEngine::MessageReceived(
+    std::weak_ptr<Session>&& pSession, const std::string_view message )
+{
+    auto pLockedSession = pSession.lock();
+    if ( pLockedSession == nullptr )
+    {
+        return;
+    }
+
+    const auto peerId = pLockedSession->GetPeerId();
+    std::size_t shard = 0;
+
+    if ( std::holds_alternative<NodeId>( peerId ) )
+    {
+        shard = ShardOf( std::get<NodeId>( peerId ) );
+    }
+    else
+    {
+        // Messages from UIs are parsed twice, once here to find the node they are for, but they
+        // are few next to those from nodes. A node whose NodeConnect is still queued is taken for
+        // a UI, which parses its updates as UI updates of the same node, so they are queued
+        // behind its NodeConnect all the same. Messages that cannot be parsed are reported by the
+        // first shard.
+        const auto result =
+            try_parse( message, PeerType::UI, pLockedSession->GetWireFormat() );
+
+        if ( result && result.Value().type == MessageType::UiConnect )
+        {
+            return ConnectUI( pLockedSession, result.Value() );
+        }
+        else if ( result )
+        {
+            shard = ShardOf( result.Value().node.id );
+        }
+    }
+
+    m_shards[shard]->Push( Task::Kind::Message, std::move( pLockedSession ), message, UIId() );
+}
+
+bool ShardedEngine::BatchReceived()
+{
+    return false;
+}
+
+void ShardedEngine::ConnectUI(
+    const std::shared_ptr<Session>& pSession, const ParsedMessage& msg )
+{
+    const auto uiId = msg.ui.id;
+    const auto uiIdStr = to_string( uiId );
+    const auto format = pSession->GetWireFormat();
+    std::string reply;
+
+    const std::lock_guard lock( m_uiMutex );
+
+    if ( m_uiConnections.Holds( std::get<UIId>( pSession->GetPeerId() ), pSession ) )
+    {
+        ParsedMessage nak( MessageType::Nak );
+        nak.node.id = msg.node.id;
+        nak.ui = msg.ui;
+        WriteMessage( reply, nak, format );
+        pSession->SendMessage( reply );
+
+        Log( spdlog::level::warn,
+             "{} attempting to connect as {}",
+             pSession->PeerIdAsString(),
+             uiIdStr );
+        PrintWarning( pSession->PeerIdAsString(), " attempting to connect as ", uiIdStr );
+        return;
+    }
+
+    pSession->SetPeerId( uiId );
+    m_uiConnections.RemoveExpired();
+    m_uiConnections.Add( uiId, pSession );
+
+    Log( spdlog::level::info, "{} connected", uiIdStr );
+    PrintInfo( uiIdStr, " connected" );
+
+    // Each shard sends the nodes it owns once it has attached the UI, so the UI starts from an
+    // empty FullState that is queued to it before any of them.
+    WriteFullState( reply, Span<const Node>(), format );
+    pSession->SendMessage( reply );
+
+    for ( auto& pShard : m_shards )
+    {
+        pShard->Push( Task::Kind::AttachUI, pSession, std::string_view(), uiId );
+    }
+}
+
+void ShardedEngine::PeerDisconnected( std::weak_ptr<Session>&& pSession )
+{
+    const auto pLockedSession = pSession.lock();
+    if ( pLockedSession == nullptr )
+    {
+        return;
+    }
+
+    const auto peerId = pLockedSession->GetPeerId();
+    if ( std::holds_alternative<NodeId>( peerId ) )
+    {
+        m_shards[ShardOf( std::get<NodeId>( peerId ) )]->Push(
+            Task::Kind::Disconnect,
+            pLockedSession,
+            std::string_view(),
+            UIId() );
+        return;
+    }
+
+    const auto uiId = std::get<UIId>( peerId );
+    bool wasConnected = false;
+    {
+        const std::lock_guard lock( m_uiMutex );
+        wasConnected = m_uiConnections.Holds( uiId, pLockedSession ) &&
+                       m_uiConnections.Remove( uiId );
+    }
+
+    if ( wasConnected )
+    {
+        Log( spdlog::level::info, "{} disconnected", to_string( uiId ) );
+        PrintInfo( uiId, " disconnected." );
+    }
+
+    // A session that never connected as a UI may be a node whose NodeConnect is still queued, so
+    // every shard checks once it has handled what is queued before.
+    const auto kind = wasConnected ? Task::Kind::DetachUI : Task::Kind::Disconnect;
+    for ( auto& pShard : m_shards )
+    {
+        pShard->Push( kind, pLockedSession, std::string_view(), uiId );
+    }
+}
+
+void ShardedEngine::RestoreNodeStates( const std::vector<Node>& nodes )
+{
+    std::vector<std::vector<Node>> nodesByShard( m_shards.size() );
+    for ( const auto& node : nodes )
+    {
+        nodesByShard[ShardOf( node.id )].push_back( node );
+    }
+
+    for ( std::size_t index = 0; index < m_shards.size(); ++index )
+    {
+        m_shards[index]->Engine().RestoreNodeStates( nodesByShard[index] );
+    }
+}
+
+void ShardedEngine::SetWriteAheadLog( std::shared_ptr<WalWriter> pWal )
+{
+    for ( auto& pShard : m_shards )
+    {
+        pShard->Engine().SetWriteAheadLog( pWal );
+    }
+}
+
+std::vector<std::shared_ptr<const MessageEngine>> ShardedEngine::Engines() const
+{
+    std::vector<std::shared_ptr<const MessageEngine>> engines;
+    for ( const auto& pShard : m_shards )
+    {
+        engines.push_back( pShard->SharedEngine() );
+    }
+
+    return engines;
+}
+
+} // namespace sn
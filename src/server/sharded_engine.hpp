@@ -0,0 +1,116 @@
+#pragma once
+
+#include "connection.hpp"
+#include "message_handler.hpp"
+#include "messages.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace sn
+{
+
+class MessageEngine;
+class WalWriter;
+enum class UIId;
+enum class NodeId;
+
+/*!
+    @brief Splits the nodes between a number of message engines, or shards, each of which handles
+           the messages of the nodes it owns on a thread of its own. The updates of nodes on
+           different shards are therefore handled in parallel, however many io threads receive
+           them. Besides the write-ahead log, shards only share the console and the logger, which
+           updates are not written to unless debug logging is on.
+
+           A node belongs to the shard its ID selects. Io threads only route each message to the
+           lock-free queue of the shard it is for: a message from a connected node goes to the
+           shard of that node, and a message from anyone else to the shard of the node it names.
+           A UI is attached to every shard, so each shard forwards the changes of its own nodes to
+           it, and a UI update is handled by the shard of the node it updates.
+
+           UIs are always sent the state of every node when they connect, rather than the changes
+           they missed, as each shard numbers its changes separately. For the same reason UIs are
+           never sent a Sequence.
+ */
+class ShardedEngine final : public MessageHandler
+{
+public:
+    /*!
+        @param[in] shardCount The number of shards. Must not be zero.
+        @param[in] historyDepth The number of samples each shard keeps for each IO of its nodes.
+     */
+    ShardedEngine( const std::size_t shardCount, const std::size_t historyDepth );
+
+    ShardedEngine( const ShardedEngine& ) = delete;
+    ShardedEngine& operator=( const ShardedEngine& ) = delete;
+
+    /*!
+        @brief Stops the shards, see Stop().
+     */
+    ~ShardedEngine() override;
+
+    void MessageReceived(
+        std::weak_ptr<Session>&& pSession,
+        const std::string_view message ) override;
+
+    /*!
+        @brief Does nothing, as each shard ends a batch whenever it has handled every message
+               queued to it.
+     */
+    bool BatchReceived() override;
+
+    void PeerDisconnected( std::weak_ptr<Session>&& pSession ) override;
+
+    /*!
+        @brief Restores the last known states of nodes on the shards that own them. Must be called
+               before any message is handled.
+        @param[in] nodes The nodes to restore.
+     */
+    void RestoreNodeStates( const std::vector<Node>& nodes );
+
+    /*!
+        @brief Sets the write-ahead log that every shard appends its changes to. Must be called
+               before any message is handled.
+     */
+    void SetWriteAheadLog( std::shared_ptr<WalWriter> pWal );
+
+    /*!
+        @brief Returns the engine of every shard, e.g. to save the states of their nodes.
+     */
+    std::vector<std::shared_ptr<const MessageEngine>> Engines() const;
+
+    /*!
+        @brief Handles every message still queued and stops the threads of the shards. No message
+               may be received once this has been called.
+     */
+    void Stop();
+
+private: // types
+    struct Task;
+    class Shard;
+
+private: // methods
+    /*!
+        @brief Returns the index of the shard that owns the node.
+     */
+    std::size_t ShardOf( const NodeId id ) const;
+
+    /*!
+        @brief Connects a UI and attaches it to every shard.
+        @param[in] pSession The session the UiConnect was received on.
+        @param[in] msg The UiConnect.
+     */
+    void ConnectUI( const std::shared_ptr<Session>& pSession, const ParsedMessage& msg );
+
+private: // data
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    // UIs connect and disconnect here rather than on any one shard.
+    std::mutex m_uiMutex;
+    Connections<UIId> m_uiConnections;
+};
+
+} // namespace sn
@@ -0,0 +1,84 @@
+#include "shared_buffer.hpp"
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace sn
+{
+
+SharedBuffer::SharedBuffer( const std::string_view contents )
+    : m_pHeader( new ( ::operator new( sizeof( Header ) + contents.size() ) )
+                     Header{ { 1 }, contents.size() } )
+{
+    std::memcpy( reinterpret_cast<char*>( m_pHeader + 1 ), contents.data(), contents.size() );
+}
+
+SharedBuffer::SharedBuffer( const SharedBuffer& other )
+    : m_pHeader( other.m_pHeader )
+{
+    if ( m_pHeader != nullptr )
+    {
+        m_pHeader->refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+}
+
+SharedBuffer::SharedBuffer( SharedBuffer&& other ) noexcept
+    : m_pHeader( std::exchange( other.m_pHeader, nullptr ) )
+{}
+
+SharedBuffer& SharedBuffer::operator=( const SharedBuffer& other )
+{
+    if ( this != &other )
+    {
+        SharedBuffer copy( other );
+        std::swap( m_pHeader, copy.m_pHeader );
+    }
+
+    return *this;
+}
+
+SharedBuffer& SharedBuffer::operator=( SharedBuffer&& other ) noexcept
+{
+    if ( this != &other )
+    {
+        Release();
+        m_pHeader = std::exchange( other.m_pHeader, nullptr );
+    }
+
+    return *this;
+}
+
+SharedBuffer::~SharedBuffer()
+{
+    Release();
+}
+
+std::string_view SharedBuffer::View() const
+{
+    if ( m_pHeader == nullptr )
+    {
+        return std::string_view();
+    }
+
+    return std::string_view( reinterpret_cast<const char*>( m_pHeader + 1 ), m_pHeader->size );
+}
+
+std::size_t SharedBuffer::Size() const
+{
+    return m_pHeader == nullptr ? 0 : m_pHeader->size;
+}
+
+void SharedBuffer::Release()
+{
+    // The last owner must see every write made through the others before freeing the buffer.
+    if ( m_pHeader != nullptr && m_pHeader->refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+    {
+        m_pHeader->~Header();
+        ::operator delete( m_pHeader );
+    }
+
+    m_pHeader = nullptr;
+}
+
+} // namespace sn
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string_view>
+
+namespace sn
+{
+
+/*!
+    @brief An immutable, reference counted copy of an encoded message. The count and the bytes
+           live in a single allocation, so a message can be queued to any number of sessions for
+           the cost of one allocation and one copy, and is freed when the last of them has written
+           it. Copies may be made and destroyed on different threads.
+ */
+class SharedBuffer final
+{
+public:
+    SharedBuffer() = default;
+
+    /*!
+        @param[in] contents The bytes to copy into the buffer.
+     */
+    explicit SharedBuffer( const std::string_view contents );
+
+    SharedBuffer( const SharedBuffer& other );
+    SharedBuffer( SharedBuffer&& other ) noexcept;
+    SharedBuffer& operator=( const SharedBuffer& other );
+    SharedBuffer& operator=( SharedBuffer&& other ) noexcept;
+    ~SharedBuffer();
+
+    std::string_view View() const;
+
+    std::size_t Size() const;
+
+private:
+    //! Precedes the bytes of the buffer in its allocation.
+    struct Header
+    {
+        std::atomic<std::size_t> refs;
+        std::size_t size;
+    };
+
+    void Release();
+
+private:
+    Header* m_pHeader = nullptr;
+};
+
+} // namespace sn
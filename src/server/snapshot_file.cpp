@@ -0,0 +1,223 @@
+#include "snapshot_file.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace sn
+{
+
+namespace bip = boost::interprocess;
+
+constexpr std::array<char, 8> snapshotMagic = { 'S', 'N', 'S', 'T', 'A', 'T', 'E', '\0' };
+constexpr std::uint32_t snapshotLayoutVersion = 1;
+
+struct SnapshotHeader
+{
+    std::array<char, 8> magic;
+    std::uint32_t layoutVersion;
+    std::uint32_t nodeCount;
+    std::uint64_t ioCount;
+    std::uint64_t savedAt;
+    std::uint64_t reserved;
+};
+
+struct SnapshotNode
+{
+    std::uint32_t id;
+    std::uint32_t ioCount;
+};
+
+struct SnapshotIO
+{
+    std::uint32_t id;
+    std::uint8_t type;
+    std::array<std::uint8_t, 3> reserved;
+    std::int32_t value;
+};
+
+static_assert( sizeof( SnapshotHeader ) == 40, "The snapshot header layout is fixed" );
+static_assert( sizeof( SnapshotNode ) == 8, "The snapshot node layout is fixed" );
+static_assert( sizeof( SnapshotIO ) == 12, "The snapshot IO layout is fixed" );
+static_assert( std::is_trivially_copyable_v<SnapshotHeader> );
+static_assert( std::is_trivially_copyable_v<SnapshotNode> );
+static_assert( std::is_trivially_copyable_v<SnapshotIO> );
+
+std::uint64_t SnapshotFileSize( const std::uint64_t nodeCount, const std::uint64_t ioCount )
+{
+    return sizeof( SnapshotHeader ) + nodeCount * sizeof( SnapshotNode ) +
+           ioCount * sizeof( SnapshotIO );
+}
+
+/*!
+    @brief Copies a record into the mapping and returns the position after it. The mapping is
+           not aligned for the record types, so they are copied rather than cast.
+ */
+template<typename Record>
+char* PutRecord( char* const pos, const Record& record )
+{
+    std::memcpy( pos, &record, sizeof( Record ) );
+    return pos + sizeof( Record );
+}
+
+template<typename Record>
+Record GetRecord( const char*& pos )
+{
+    Record record;
+    std::memcpy( &record, pos, sizeof( Record ) );
+    pos += sizeof( Record );
+    return record;
+}
+
+void WriteSnapshotFile(
+    const std::filesystem::path& path,
+    const std::vector<NodeStateSnapshotRef>& snapshots,
+    const Timestamp savedAt )
+{
+    std::size_t nodeCount = 0;
+    std::uint64_t ioCount = 0;
+    for ( const auto& pSnapshot : snapshots )
+    {
+        nodeCount += pSnapshot->Size();
+        pSnapshot->ForEachNode(
+            [&ioCount]( const NodeStateSnapshot::NodeView& node ) { ioCount += node.ioCount; } );
+    }
+
+    const auto size = SnapshotFileSize( nodeCount, ioCount );
+    auto tempPath = path;
+    tempPath += ".tmp";
+
+    if ( path.has_parent_path() )
+    {
+        std::filesystem::create_directories( path.parent_path() );
+    }
+
+    // A file must exist and have its final size before it can be mapped.
+    std::ofstream( tempPath, std::ios::binary | std::ios::trunc ).close();
+    std::filesystem::resize_file( tempPath, size );
+
+    {
+        const bip::file_mapping mapping( tempPath.string().c_str(), bip::read_write );
+        bip::mapped_region region( mapping, bip::read_write );
+        auto* const base = static_cast<char*>( region.get_address() );
+
+        const SnapshotHeader header{ snapshotMagic,
+                                     snapshotLayoutVersion,
+                                     static_cast<std::uint32_t>( nodeCount ),
+                                     ioCount,
+                                     savedAt,
+                                     0 };
+        PutRecord( base, header );
+
+        auto* nodePos = base + sizeof( SnapshotHeader );
+        auto* ioPos = nodePos + nodeCount * sizeof( SnapshotNode );
+
+        for ( const auto& pSnapshot : snapshots )
+        {
+            pSnapshot->ForEachNode( [&nodePos, &ioPos]( const NodeStateSnapshot::NodeView& node ) {
+                nodePos = PutRecord(
+                    nodePos,
+                    SnapshotNode{ static_cast<std::uint32_t>( node.id ),
+                                  static_cast<std::uint32_t>( node.ioCount ) } );
+
+                for ( std::size_t index = 0; index < node.ioCount; ++index )
+                {
+                    const auto& io = node.io[index];
+                    ioPos = PutRecord(
+                        ioPos,
+                        SnapshotIO{ static_cast<std::uint32_t>( io.id ),
+                                    static_cast<std::uint8_t>( io.type ),
+                                    {},
+                                    static_cast<std::int32_t>( io.value ) } );
+                }
+            } );
+        }
+
+        region.flush();
+    }
+
+    std::filesystem::rename( tempPath, path );
+}
+
+std::optional<SnapshotFileContents> ReadSnapshotFile( const std::filesystem::path& path )
+{
+    if ( !std::filesystem::exists( path ) )
+    {
+        return std::nullopt;
+    }
+
+    const auto fileSize = std::filesystem::file_size( path );
+    if ( fileSize < sizeof( SnapshotHeader ) )
+    {
+        throw std::runtime_error( "Snapshot file is too short" );
+    }
+
+    const bip::file_mapping mapping( path.string().c_str(), bip::read_only );
+    const bip::mapped_region region( mapping, bip::read_only );
+    const auto* pos = static_cast<const char*>( region.get_address() );
+
+    const auto header = GetRecord<SnapshotHeader>( pos );
+    if ( header.magic != snapshotMagic )
+    {
+        throw std::runtime_error( "Not a snapshot file" );
+    }
+    else if ( header.layoutVersion != snapshotLayoutVersion )
+    {
+        throw std::runtime_error(
+            "Unsupported snapshot layout version " + std::to_string( header.layoutVersion ) );
+    }
+    else if (
+        header.ioCount > fileSize / sizeof( SnapshotIO ) ||
+        SnapshotFileSize( header.nodeCount, header.ioCount ) != fileSize )
+    {
+        throw std::runtime_error( "Snapshot file size does not match its header" );
+    }
+
+    SnapshotFileContents contents{ header.savedAt, {} };
+    contents.nodes.reserve( header.nodeCount );
+
+    const auto* ioPos = pos + header.nodeCount * sizeof( SnapshotNode );
+    std::uint64_t iosLeft = header.ioCount;
+
+    for ( std::uint32_t nodeIndex = 0; nodeIndex < header.nodeCount; ++nodeIndex )
+    {
+        const auto node = GetRecord<SnapshotNode>( pos );
+        if ( node.ioCount > iosLeft )
+        {
+            throw std::runtime_error( "Snapshot file holds fewer IOs than its nodes" );
+        }
+
+        iosLeft -= node.ioCount;
+        auto& restored = contents.nodes.emplace_back( static_cast<NodeId>( node.id ) );
+        restored.io.reserve( node.ioCount );
+
+        for ( std::uint32_t ioIndex = 0; ioIndex < node.ioCount; ++ioIndex )
+        {
+            const auto io = GetRecord<SnapshotIO>( ioPos );
+            if ( io.type >= static_cast<std::uint8_t>( IOType::Existing ) )
+            {
+                throw std::runtime_error( "Snapshot file holds an invalid IO type" );
+            }
+
+            restored.io.emplace_back(
+                static_cast<IOId>( io.id ),
+                static_cast<IOType>( io.type ),
+                static_cast<int>( io.value ) );
+        }
+    }
+
+    if ( iosLeft != 0 )
+    {
+        throw std::runtime_error( "Snapshot file holds more IOs than its nodes" );
+    }
+
+    return contents;
+}
+
+} // namespace sn
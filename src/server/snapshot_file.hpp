@@ -0,0 +1,53 @@
+#pragma once
+
+#include "id_types.hpp"
+#include "data_types.hpp"
+#include "node_state_snapshot.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// A snapshot file holds the state of every node in a fixed binary layout, in the byte order of the
+// machine that wrote it:
+//
+//     header:  "SNSTATE" '\0', layout version (u32), node count (u32), IO count (u64),
+//              time saved (u64, milliseconds since the Unix epoch), reserved (u64)
+//     nodes:   (<node id> (u32) <io count> (u32))*
+//     IOs:     (<io id> (u32) <io type> (u8) reserved (3 bytes) <value> (i32))*
+//
+// The IOs of each node follow those of the node before it.
+
+namespace sn
+{
+
+/*!
+    @brief The contents of a snapshot file.
+ */
+struct SnapshotFileContents
+{
+    Timestamp savedAt;
+    std::vector<Node> nodes;
+};
+
+/*!
+    @brief Writes the node states to a snapshot file through a memory mapping. The file is written
+           next to the path and then renamed over it, so a reader never sees a partial snapshot.
+    @param[in] snapshots The node states to save, e.g. one snapshot from each shard of the server.
+               The nodes of each snapshot follow those of the one before it.
+    @throws std::exception if the file cannot be written.
+ */
+void WriteSnapshotFile(
+    const std::filesystem::path& path,
+    const std::vector<NodeStateSnapshotRef>& snapshots,
+    const Timestamp savedAt );
+
+/*!
+    @brief Maps a snapshot file and reads the node states it holds.
+    @returns An empty optional if there is no file at the path.
+    @throws std::runtime_error if the file is not a valid snapshot, or std::exception if it cannot
+            be read.
+ */
+std::optional<SnapshotFileContents> ReadSnapshotFile( const std::filesystem::path& path );
+
+} // namespace sn
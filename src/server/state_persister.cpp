@@ -0,0 +1,82 @@
+#include "state_persister.hpp"
+#include "logger.hpp"
+#include "message_engine.hpp"
+#include "snapshot_file.hpp"
+
+namespace sn
+{
+
+StatePersister::StatePersister(
+    std::vector<std::shared_ptr<const MessageEngine>> msgEngines,
+    std::filesystem::path path,
+    const std::chrono::milliseconds interval )
+    : m_msgEngines( std::move( msgEngines ) )
+    , m_path( std::move( path ) )
+    , m_interval( interval )
+    , m_savedVersions( m_msgEngines.size(), 0 )
+    , m_thread( [this]() { Run(); } )
+{}
+
+StatePersister::~StatePersister()
+{
+    {
+        std::lock_guard lock( m_mutex );
+        m_stopping = true;
+    }
+
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void StatePersister::Run()
+{
+    std::unique_lock lock( m_mutex );
+    while ( !m_stopping )
+    {
+        m_cv.wait_for( lock, m_interval, [this]() { return m_stopping; } );
+
+        lock.unlock();
+        SaveIfChanged();
+        lock.lock();
+    }
+}
+
+void StatePersister::SaveIfChanged()
+{
+    std::vector<NodeStateSnapshotRef> snapshots;
+    bool changed = false;
+    std::size_t nodeCount = 0;
+
+    for ( std::size_t index = 0; index < m_msgEngines.size(); ++index )
+    {
+        snapshots.push_back( m_msgEngines[index]->AcquireNodeStates() );
+        changed = changed || snapshots.back()->Version() != m_savedVersions[index];
+        nodeCount += snapshots.back()->Size();
+    }
+
+    if ( !changed )
+    {
+        return;
+    }
+
+    try
+    {
+        WriteSnapshotFile( m_path, snapshots, MessageEngine::Now() );
+        for ( std::size_t index = 0; index < snapshots.size(); ++index )
+        {
+            m_savedVersions[index] = snapshots[index]->Version();
+        }
+
+        Log( spdlog::level::debug, "Saved {} node(s) to {}", nodeCount, m_path.string() );
+    }
+    catch ( const std::exception& e )
+    {
+        // Keep the old versions so that the next interval tries again.
+        Log( spdlog::level::err,
+             "Failed to save node states to {}: {}",
+             m_path.string(),
+             e.what() );
+    }
+}
+
+} // namespace sn
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sn
+{
+
+class MessageEngine;
+
+/*!
+    @brief Periodically writes the state of every node to a snapshot file on a thread of its own.
+           It reads the state through the lock-free snapshots of the message engines, so saving
+           never holds up the handling of messages.
+ */
+class StatePersister final
+{
+public:
+    /*!
+        @param[in] msgEngines The engines whose node states are saved, e.g. every shard of a
+                   ShardedEngine.
+        @param[in] path The snapshot file to write.
+        @param[in] interval How often to save the node states if they have changed.
+     */
+    StatePersister(
+        std::vector<std::shared_ptr<const MessageEngine>> msgEngines,
+        std::filesystem::path path,
+        const std::chrono::milliseconds interval );
+
+    StatePersister( const StatePersister& ) = delete;
+    StatePersister& operator=( const StatePersister& ) = delete;
+
+    /*!
+        @brief Stops the thread after saving the node states one last time.
+     */
+    ~StatePersister();
+
+private: // methods
+    void Run();
+
+    /*!
+        @brief Writes the snapshot file if the node states of any engine changed since it was last
+               written.
+     */
+    void SaveIfChanged();
+
+private: // data
+    const std::vector<std::shared_ptr<const MessageEngine>> m_msgEngines;
+    const std::filesystem::path m_path;
+    const std::chrono::milliseconds m_interval;
+
+    // The version of the snapshot of each engine that was saved last.
+    std::vector<std::uint64_t> m_savedVersions;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping = false;
+
+    std::thread m_thread;
+};
+
+} // namespace sn
@@ -0,0 +1,321 @@
+#include "wal_writer.hpp"
+#include "console_printer.hpp"
+#include "logger.hpp"
+#include "write_ahead_log.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+
+namespace sn
+{
+
+// A log is checked a block at a time, so that checking it takes little memory however long it is.
+constexpr std::size_t recoveryBlockSize = 1024 * 1024;
+
+/*!
+    @brief Returns the file in which the writer records how much of the log has been synced to disk,
+           so that the records before that need not be checked again when it is reopened.
+ */
+std::filesystem::path SyncedEndPath( const std::filesystem::path& path )
+{
+    auto syncedEndPath = path;
+    syncedEndPath += ".synced";
+    return syncedEndPath;
+}
+
+/*!
+    @brief Returns how much of the log was last recorded as synced, if that is still within it.
+ */
+std::optional<std::uintmax_t> ReadSyncedEnd( const std::filesystem::path& path )
+{
+    std::ifstream file( SyncedEndPath( path ) );
+    std::uintmax_t end = 0;
+    if ( file >> end && end >= walHeaderSize && end <= std::filesystem::file_size( path ) )
+    {
+        return end;
+    }
+
+    return std::nullopt;
+}
+
+struct CheckResult
+{
+    WalStatus status;
+    std::uintmax_t offset;
+};
+
+/*!
+    @brief Checks the checksum of every record of the log from the offset, which must be the start
+           of a record, to its end, without decoding them.
+    @returns End if every record is whole, otherwise Truncated or Corrupt and the offset of the
+             record that could not be read.
+ */
+CheckResult CheckRecords( const std::filesystem::path& path, std::uintmax_t offset )
+{
+    std::ifstream file( path, std::ios::binary );
+    file.seekg( static_cast<std::streamoff>( offset ) );
+
+    // The records read from offset on, the last of which may not have been read in full.
+    std::string records;
+    while ( true )
+    {
+        const auto unchecked = records.size();
+        records.resize( unchecked + recoveryBlockSize );
+        file.read(
+            records.data() + unchecked,
+            static_cast<std::streamsize>( recoveryBlockSize ) );
+        records.resize( unchecked + static_cast<std::size_t>( file.gcount() ) );
+
+        WalReader reader( records, 0 );
+        auto status = WalStatus::Record;
+        while ( ( status = reader.Skip() ) == WalStatus::Record )
+        {
+        }
+
+        if ( status == WalStatus::Corrupt || !file )
+        {
+            return CheckResult{ status, offset + reader.Offset() };
+        }
+
+        // A record cut short by the end of the block is checked with the next block.
+        offset += reader.Offset();
+        records.erase( 0, reader.Offset() );
+    }
+}
+
+/*!
+    @brief Renames a log that cannot be appended to, so that a new one can be started without
+           losing what it holds.
+ */
+void MoveAside( const std::filesystem::path& path, const std::string& reason )
+{
+    const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    auto asidePath = path;
+    asidePath += ".corrupt-" +
+                 std::to_string(
+                     std::chrono::duration_cast<std::chrono::seconds>( sinceEpoch ).count() );
+    std::filesystem::rename( path, asidePath );
+
+    std::error_code ec;
+    std::filesystem::remove( SyncedEndPath( path ), ec );
+
+    Log( spdlog::level::err,
+         "{} {}. Moved it to {} and started a new log",
+         path.string(),
+         reason,
+         asidePath.string() );
+    PrintWarning(
+        path.string(),
+        " ",
+        reason,
+        ". Moved it to ",
+        asidePath.string(),
+        " and started a new log" );
+}
+
+/*!
+    @brief Checks that a log that already exists starts with a header this version can read, so
+           that records are never appended to some other file, and cuts off anything after the
+           last whole record, such as a record that was being written when the server stopped.
+           Only the records after the end last recorded as synced are checked, unless one of them
+           is corrupt.
+    @returns False if the log was moved aside for not being a write-ahead log or holding a
+             corrupt record.
+ */
+bool RecoverExistingLog( const std::filesystem::path& path )
+{
+    std::string header( walHeaderSize, '\0' );
+    {
+        std::ifstream file( path, std::ios::binary );
+        file.read( header.data(), static_cast<std::streamsize>( header.size() ) );
+        if ( !file || !IsWalHeader( header ) )
+        {
+            MoveAside( path, "is not a write-ahead log" );
+            return false;
+        }
+    }
+
+    const auto syncedEnd = ReadSyncedEnd( path );
+    auto checked = CheckRecords( path, syncedEnd.value_or( walHeaderSize ) );
+
+    // The synced end may be wrong if the log was replaced or the server stopped while recording
+    // it, so a corrupt record found after it is only believed once the whole log is checked.
+    if ( checked.status == WalStatus::Corrupt && syncedEnd )
+    {
+        checked = CheckRecords( path, walHeaderSize );
+    }
+
+    if ( checked.status == WalStatus::Corrupt )
+    {
+        MoveAside( path, "has a corrupt record at byte " + std::to_string( checked.offset ) );
+        return false;
+    }
+    else if ( checked.status == WalStatus::Truncated )
+    {
+        Log( spdlog::level::warn,
+             "Discarding {} byte(s) after the last whole record in {}",
+             std::filesystem::file_size( path ) - checked.offset,
+             path.string() );
+        std::filesystem::resize_file( path, checked.offset );
+    }
+
+    return true;
+}
+
+WalWriter::WalWriter(
+    const std::filesystem::path& path,
+    const std::chrono::milliseconds syncInterval )
+    : m_path( path )
+    , m_syncInterval( syncInterval )
+    , m_file( nullptr )
+    , m_lastSync( std::chrono::steady_clock::now() )
+{
+    if ( path.has_parent_path() )
+    {
+        std::filesystem::create_directories( path.parent_path() );
+    }
+
+    const bool exists = std::filesystem::exists( path ) &&
+                        std::filesystem::file_size( path ) > 0 && RecoverExistingLog( path );
+
+    m_file = std::fopen( path.string().c_str(), "ab" );
+    if ( m_file == nullptr )
+    {
+        throw std::runtime_error( "Failed to open " + path.string() );
+    }
+
+    if ( !exists )
+    {
+        std::string header;
+        WriteWalHeader( header );
+        Commit( header );
+        Sync();
+    }
+
+    m_thread = std::thread( [this]() { Run(); } );
+}
+
+WalWriter::~WalWriter()
+{
+    {
+        std::lock_guard lock( m_mutex );
+        m_stopping = true;
+    }
+
+    m_cv.notify_one();
+    m_thread.join();
+    std::fclose( m_file );
+}
+
+void WalWriter::Append( const ParsedMessage& msg, const Timestamp time )
+{
+    bool wasEmpty = false;
+
+    {
+        std::lock_guard lock( m_mutex );
+        wasEmpty = m_pending.empty();
+        AppendWalRecord( m_pending, msg, time );
+    }
+
+    // The thread only waits while there is nothing to commit.
+    if ( wasEmpty )
+    {
+        m_cv.notify_one();
+    }
+}
+
+void WalWriter::Run()
+{
+    std::unique_lock lock( m_mutex );
+    while ( true )
+    {
+        const auto ready = [this]() { return m_stopping || !m_pending.empty(); };
+        if ( m_unsynced )
+        {
+            m_cv.wait_until( lock, m_lastSync + m_syncInterval, ready );
+        }
+        else
+        {
+            m_cv.wait( lock, ready );
+        }
+
+        // Everything appended while the last batch was written goes out as one commit.
+        m_committing.swap( m_pending );
+        const bool stopping = m_stopping;
+        lock.unlock();
+
+        if ( !m_committing.empty() )
+        {
+            Commit( m_committing );
+            m_committing.clear();
+        }
+
+        if ( m_unsynced &&
+             ( stopping || std::chrono::steady_clock::now() >= m_lastSync + m_syncInterval ) )
+        {
+            Sync();
+        }
+
+        if ( stopping )
+        {
+            return;
+        }
+
+        lock.lock();
+    }
+}
+
+void WalWriter::Commit( const std::string& batch )
+{
+    if ( std::fwrite( batch.data(), 1, batch.size(), m_file ) != batch.size() ||
+         std::fflush( m_file ) != 0 )
+    {
+        // The records are lost rather than retried, as a partial write may already have left a
+        // truncated record that readers stop at.
+        Log( spdlog::level::err,
+             "Failed to write {} byte(s) to {}",
+             batch.size(),
+             m_path.string() );
+        m_writeFailed = true;
+    }
+
+    m_unsynced = true;
+}
+
+void WalWriter::Sync()
+{
+#ifdef _WIN32
+    const auto result = _commit( _fileno( m_file ) );
+#else
+    const auto result = fsync( fileno( m_file ) );
+#endif
+
+    if ( result != 0 )
+    {
+        Log( spdlog::level::err, "Failed to sync {}", m_path.string() );
+        m_writeFailed = true;
+    }
+    else if ( !m_writeFailed )
+    {
+        // Every record up to here is whole and on disk. Once a write fails, the log may hold a
+        // partial record, so the end recorded before it is kept.
+        std::error_code ec;
+        const auto syncedEnd = std::filesystem::file_size( m_path, ec );
+        if ( !ec )
+        {
+            std::ofstream( SyncedEndPath( m_path ), std::ios::trunc ) << syncedEnd;
+        }
+    }
+
+    m_unsynced = false;
+    m_lastSync = std::chrono::steady_clock::now();
+}
+
+} // namespace sn
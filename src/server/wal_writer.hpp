@@ -0,0 +1,86 @@
+#pragma once
+
+#include "messages.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sn
+{
+
+/*!
+    @brief Appends changes to a write-ahead log on a thread of its own. Changes are encoded into a
+           buffer in memory, and the thread writes everything that accumulated since its last
+           write as one group commit, so handling a message never waits on the disk. The log is
+           synced to disk at most once per sync interval, after which how much of it is on disk is
+           recorded in a ".synced" file beside it, so that reopening the log only checks the
+           records written since.
+ */
+class WalWriter final
+{
+public:
+    /*!
+        @param[in] path The log to append to. It is created if it does not exist, and a partial
+                   record at its end is removed. If it is not a write-ahead log or holds a corrupt
+                   record, it is renamed with a ".corrupt-<time>" suffix and a new log started.
+        @param[in] syncInterval The longest a committed change may wait to be synced to disk, or
+                   zero to sync every commit.
+        @throws std::runtime_error if the file cannot be opened, or
+                std::filesystem::filesystem_error if it cannot be checked or renamed.
+     */
+    WalWriter( const std::filesystem::path& path, const std::chrono::milliseconds syncInterval );
+
+    WalWriter( const WalWriter& ) = delete;
+    WalWriter& operator=( const WalWriter& ) = delete;
+
+    /*!
+        @brief Commits and syncs any changes still in memory, then closes the log.
+     */
+    ~WalWriter();
+
+    /*!
+        @brief Queues a NodeConnect, NodeUpdate, UiUpdate or NodeDisconnect to be logged. Only
+               takes a lock for as long as it takes to encode the message.
+     */
+    void Append( const ParsedMessage& msg, const Timestamp time );
+
+private: // methods
+    void Run();
+
+    /*!
+        @brief Writes a batch of records to the log.
+     */
+    void Commit( const std::string& batch );
+
+    /*!
+        @brief Flushes the log to disk.
+     */
+    void Sync();
+
+private: // data
+    const std::filesystem::path m_path;
+    const std::chrono::milliseconds m_syncInterval;
+    std::FILE* m_file;
+
+    // Changes are appended to m_pending, which the thread swaps with m_committing to write them.
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::string m_pending;
+    bool m_stopping = false;
+
+    // Only used by the thread.
+    std::string m_committing;
+    bool m_unsynced = false;
+    // Set once a write fails, after which the synced end of the log is no longer recorded.
+    bool m_writeFailed = false;
+    std::chrono::steady_clock::time_point m_lastSync;
+
+    std::thread m_thread;
+};
+
+} // namespace sn
@@ -1,5 +1,7 @@
 #include "session.hpp"
+#include "io_types.hpp"
 #include "message_builder.hpp"
+#include "node_cache.hpp"
 #include "parser.hpp"
 
 #include <imgui.h>
@@ -11,6 +13,7 @@
 #include <iostream>
 #include <memory>
 #include <thread>
+#include <unordered_set>
 
 // TODO:
 //  -> Deal with failing to connect (e.g. server not running)
@@ -71,90 +74,86 @@ private:
 class NodeStates
 {
 private:
-    std::vector<sn::Node> m_nodes;
+    sn::NodeCache m_nodes;
+    std::unordered_set<sn::NodeId> m_staleNodes;
     std::mutex m_mutex;
+    std::string m_sendBuffer;
+
+    // The last change applied, which is sent when reconnecting so that only the changes missed
+    // since are sent back. The server states it after connecting, and every NodeConnect,
+    // NodeUpdate and NodeDisconnect it forwards afterwards is the next change. Zero until known.
+    sn::SequenceNumber m_sequence = 0;
+
+    void ChangeApplied()
+    {
+        if ( m_sequence != 0 )
+        {
+            ++m_sequence;
+        }
+    }
 
 public:
-    void Reset()
+    sn::SequenceNumber LastSequence()
+    {
+        std::lock_guard l( m_mutex );
+        return m_sequence;
+    }
+
+    void SequenceReceived( const sn::SequenceNumber sequence )
     {
         std::lock_guard l( m_mutex );
-        m_nodes.clear();
+        m_sequence = sequence;
     }
 
     void SetNodeStates( const std::vector<sn::Node>& nodes )
     {
         std::lock_guard l( m_mutex );
-        m_nodes = nodes;
+        m_nodes.Assign( nodes );
+        m_staleNodes.clear();
     }
 
     void NodeConnected( const sn::Node& node )
     {
         std::lock_guard l( m_mutex );
-
-        auto nodeIter =
-            std::find_if( begin( m_nodes ), end( m_nodes ), [node]( const auto& existingNode ) {
-                return node.id == existingNode.id;
-            } );
-
-        if ( nodeIter == end( m_nodes ) )
-        {
-            m_nodes.push_back( node );
-        }
-        else
-        {
-            *nodeIter = node;
-        }
+        m_nodes.Add( node );
+        m_staleNodes.erase( node.id );
+        ChangeApplied();
     }
 
     void NodeDisconnected( const sn::Node& node )
     {
         std::lock_guard l( m_mutex );
+        m_nodes.Remove( node.id );
+        m_staleNodes.erase( node.id );
+        ChangeApplied();
+    }
 
-        auto nodeIter =
-            std::find_if( begin( m_nodes ), end( m_nodes ), [node]( const auto& existingNode ) {
-                return node.id == existingNode.id;
-            } );
-
-        if ( nodeIter != end( m_nodes ) )
-        {
-            m_nodes.erase( nodeIter );
-        }
+    // The server only knows the last values the node had before the server restarted.
+    void NodeStale( const sn::Node& node )
+    {
+        std::lock_guard l( m_mutex );
+        m_staleNodes.insert( node.id );
     }
 
     void NodeUpdated( const sn::Node& node )
     {
         std::lock_guard l( m_mutex );
+        ChangeApplied();
 
-        auto nodeIter =
-            std::find_if( begin( m_nodes ), end( m_nodes ), [node]( const auto& existingNode ) {
-                return node.id == existingNode.id;
-            } );
+        if ( !m_nodes.Contains( node.id ) )
+        {
+            std::cout << "Update for unknown Node " << node.id << '\n';
+            return;
+        }
 
-        if ( nodeIter != end( m_nodes ) )
+        for ( const auto& io : node.io )
         {
-            for ( const auto& io : node.io )
+            // Updates only carry the value, the type is known from when the node connected.
+            if ( !m_nodes.UpdateValue( node.id, io.id, io.value ) )
             {
-                const auto& existingIoBegin = begin( ( *nodeIter ).io );
-                const auto& existingIoEnd = end( ( *nodeIter ).io );
-                auto existingIoIter =
-                    std::find_if( existingIoBegin, existingIoEnd, [io]( const auto& existingIo ) {
-                        return io.id == existingIo.id;
-                    } );
-
-                if ( existingIoIter != existingIoEnd )
-                {
-                    *existingIoIter = io;
-                }
-                else
-                {
-                    std::cout << "Update for unknown IO " << io.id << '\n';
-                }
+                std::cout << "Update for unknown IO " << io.id << '\n';
             }
         }
-        else
-        {
-            std::cout << "Update for unknown Node " << node.id << '\n';
-        }
     }
 
     void DrawNodes( const std::shared_ptr<session>& pSession )
@@ -163,13 +162,18 @@ public:
         const auto font_size = ImGui::GetFontSize();
         const sf::FloatRect float_rect( 0.0, 0.0, font_size, font_size );
 
-        for ( auto& node : m_nodes )
-        {
+        m_nodes.ForEachNode( [&]( const sn::NodeCache::NodeView& node ) {
             std::vector<sn::IO> ios_to_update;
-            ImGui::Begin( sn::to_string( node.id ).c_str() );
 
-            for ( auto& io : node.io )
+            // The part after "###" identifies the window, so it stays put when it becomes stale.
+            const auto node_name = sn::to_string( node.id );
+            const auto stale = m_staleNodes.find( node.id ) != m_staleNodes.end();
+            const auto title = node_name + ( stale ? " (stale)" : "" ) + "###" + node_name;
+            ImGui::Begin( title.c_str() );
+
+            for ( std::size_t index = 0; index < node.ioCount; ++index )
             {
+                const auto io = node.IOAt( index );
                 std::ostringstream oss;
                 oss << io.type << ' ' << io.id;
                 ImGui::Text( oss.str().c_str() );
@@ -177,21 +181,20 @@ public:
                 ImGui::Text( "Value: %d", io.value );
                 ImGui::SameLine();
 
-                if ( io.type == "di" )
+                if ( io.type == sn::IOType::DigitalInput )
                 {
                     io.value == 0 ? ImGui::DrawRectFilled( float_rect, sf_red )
                                   : ImGui::DrawRectFilled( float_rect, sf_green );
 
                     ImGui::NewLine();
                 }
-                else if ( io.type == "do" )
+                else if ( io.type == sn::IOType::DigitalOutput )
                 {
                     std::string doLabel = io.value == 0 ? "Turn on" : "Turn off";
                     doLabel.append( "##" + to_string( io.id ) );
                     if ( ImGui::Button( doLabel.c_str(), { 75, 20 } ) )
                     {
-                        io.value = io.value == 0 ? 1 : 0;
-                        ios_to_update.emplace_back( io );
+                        ios_to_update.emplace_back( io.id, io.type, io.value == 0 ? 1 : 0 );
                     }
                     ImGui::SameLine();
                     io.value == 0 ? ImGui::DrawRectFilled( float_rect, sf_red )
@@ -199,35 +202,43 @@ public:
 
                     ImGui::NewLine();
                 }
-                else if ( io.type == "ai" )
+                else if ( io.type == sn::IOType::AnalogueInput )
                 {
                     const auto value = std::to_string( io.value );
                     ImGui::ProgressBar( io.value / 255.0, ImVec2( -1, 0 ), value.c_str() );
                 }
-                else if ( io.type == "ao" )
+                else if ( io.type == sn::IOType::AnalogueOutput )
                 {
                     std::string sliderLabel = "##" + to_string( io.id );
+                    int value = io.value;
                     if ( ImGui::SliderInt(
                              sliderLabel.c_str(),
-                             &( io.value ),
+                             &value,
                              0,
                              255,
                              "%d",
                              clampSlider ) )
                     {
-                        ios_to_update.emplace_back( io );
+                        ios_to_update.emplace_back( io.id, io.type, value );
                     }
                 }
             }
 
+            for ( const auto& io : ios_to_update )
+            {
+                m_nodes.UpdateValue( node.id, io.id, io.value );
+            }
+
             if ( pSession && !ios_to_update.empty() )
             {
-                const auto nodeUpdateMsg = sn::BuildUpdateMessage( node.id, ios_to_update );
-                pSession->async_write( nodeUpdateMsg );
+                m_sendBuffer.clear();
+                sn::WriteUpdateMessage(
+                    m_sendBuffer, node.id, ios_to_update, pSession->wire_format() );
+                pSession->async_write( m_sendBuffer );
             }
 
             ImGui::End();
-        }
+        } );
     }
 };
 
@@ -251,6 +262,7 @@ int main()
     char msg[1024] = {};
     char msg_out[1024] = {};
     std::uint32_t uiId = 1;
+    bool useBinaryProtocol = false;
 
     while ( window.isOpen() )
     {
@@ -321,6 +333,8 @@ int main()
 
         if ( !connection_state.IsConnected() )
         {
+            ImGui::Checkbox( "Binary protocol", &useBinaryProtocol );
+
             if ( ImGui::Button( "Connect" ) )
             {
                 std::ostringstream ipAddress;
@@ -330,41 +344,69 @@ int main()
                 std::cout << "Connecting to " << ipAddress.str() << ':' << port << '\n';
 
                 pSession = std::make_shared<session>( ioc );
-                pSession->register_connect_callback( [uiId, pSession]() {
-                    pSession->async_write( sn::BuildUiConnect( static_cast<sn::UIId>( uiId ) ) );
+                pSession->request_wire_format(
+                    useBinaryProtocol ? sn::WireFormat::Binary : sn::WireFormat::Text );
+                pSession->register_connect_callback( [uiId, pSession, &node_states]() {
+                    sn::ParsedMessage uiConnectMsg( sn::MessageType::UiConnect );
+                    uiConnectMsg.ui.id = static_cast<sn::UIId>( uiId );
+                    uiConnectMsg.sequence = node_states.LastSequence();
+                    pSession->async_write(
+                        sn::EncodeMessage( uiConnectMsg, pSession->wire_format() ) );
                 } );
-                pSession->register_read_callback( [&msg_out, &node_states]( std::string readMsg ) {
+                pSession->register_read_callback( [&msg_out, &node_states](
+                                                      std::string_view readMsg,
+                                                      sn::WireFormat format ) {
+                    // Binary messages aren't readable, so only show their size.
+                    std::string binaryDescription;
+                    std::string_view displayMsg = readMsg;
+                    if ( format == sn::WireFormat::Binary )
+                    {
+                        binaryDescription =
+                            "Binary message of " + std::to_string( readMsg.size() ) + " bytes";
+                        displayMsg = binaryDescription;
+                    }
+
                     std::size_t index = 0;
-                    while ( index < readMsg.size() )
+                    while ( index < displayMsg.size() && index < sizeof( msg_out ) - 1 )
                     {
-                        msg_out[index] = readMsg[index];
+                        msg_out[index] = displayMsg[index];
                         ++index;
                     }
                     msg_out[index] = '\0';
 
-                    try
+                    const auto result = sn::try_parse_ui_message( readMsg, format );
+                    if ( !result )
                     {
-                        const auto parsedMsg = sn::parse_ui_message( readMsg );
-                        if ( parsedMsg.type == sn::MessageType::FullState )
-                        {
-                            node_states.SetNodeStates( parsedMsg.nodes );
-                        }
-                        else if ( parsedMsg.type == sn::MessageType::NodeConnect )
-                        {
-                            node_states.NodeConnected( parsedMsg.nodes.front() );
-                        }
-                        else if ( parsedMsg.type == sn::MessageType::NodeDisconnect )
-                        {
-                            node_states.NodeDisconnected( parsedMsg.nodes.front() );
-                        }
-                        else if ( parsedMsg.type == sn::MessageType::NodeUpdate )
-                        {
-                            node_states.NodeUpdated( parsedMsg.nodes.front() );
-                        }
+                        std::cout << "Failed to parse incoming message: "
+                                  << sn::to_string( result.Failure().error ) << " at byte "
+                                  << result.Failure().offset << '\n';
+                        return;
                     }
-                    catch ( const std::exception& e )
+
+                    const auto& parsedMsg = result.Value();
+                    if ( parsedMsg.type == sn::MessageType::FullState )
+                    {
+                        node_states.SetNodeStates( parsedMsg.nodes );
+                    }
+                    else if ( parsedMsg.type == sn::MessageType::NodeConnect )
+                    {
+                        node_states.NodeConnected( parsedMsg.nodes.front() );
+                    }
+                    else if ( parsedMsg.type == sn::MessageType::NodeDisconnect )
+                    {
+                        node_states.NodeDisconnected( parsedMsg.nodes.front() );
+                    }
+                    else if ( parsedMsg.type == sn::MessageType::NodeUpdate )
                     {
-                        std::cout << "Failed to parse incoming message: " << e.what() << '\n';
+                        node_states.NodeUpdated( parsedMsg.nodes.front() );
+                    }
+                    else if ( parsedMsg.type == sn::MessageType::NodeStale )
+                    {
+                        node_states.NodeStale( parsedMsg.nodes.front() );
+                    }
+                    else if ( parsedMsg.type == sn::MessageType::Sequence )
+                    {
+                        node_states.SequenceReceived( parsedMsg.sequence );
                     }
                 } );
                 pSession->run( ipAddress.str(), std::to_string( port ) );
@@ -379,8 +421,8 @@ int main()
                 pSession->async_close();
                 std::cout << "Disconnect\n";
 
+                // The node states are kept so that reconnecting only needs the changes missed.
                 connection_state.Disconnected();
-                node_states.Reset();
             }
         }
 
@@ -398,7 +440,24 @@ int main()
             ImGui::SameLine();
             if ( ImGui::Button( "Send Message" ) )
             {
-                pSession->async_write( msg );
+                if ( pSession->wire_format() == sn::WireFormat::Binary )
+                {
+                    // Messages are typed in the text protocol and converted before sending.
+                    try
+                    {
+                        const auto parsedMsg = sn::parse( msg, sn::PeerType::UI );
+                        pSession->async_write(
+                            sn::EncodeMessage( parsedMsg, sn::WireFormat::Binary ) );
+                    }
+                    catch ( const std::exception& e )
+                    {
+                        std::cout << "Failed to encode message: " << e.what() << '\n';
+                    }
+                }
+                else
+                {
+                    pSession->async_write( msg );
+                }
             }
         }
 
@@ -413,7 +472,10 @@ int main()
 
         ImGui::End();
 
-        node_states.DrawNodes( pSession );
+        if ( connection_state.IsConnected() )
+        {
+            node_states.DrawNodes( pSession );
+        }
 
         window.clear();
         ImGui::SFML::Render( window );
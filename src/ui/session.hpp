@@ -13,6 +13,9 @@
 //
 //------------------------------------------------------------------------------
 
+#include "message_framer.hpp"
+#include "binary_protocol.hpp"
+
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/strand.hpp>
@@ -21,6 +24,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -42,9 +46,13 @@ class session : public std::enable_shared_from_this<session>
     tcp::resolver resolver_;
     websocket::stream<beast::tcp_stream> ws_;
     beast::flat_buffer buffer_;
+    sn::MessageFramer framer_;
+    websocket::response_type handshake_response_;
+    sn::WireFormat requested_format_ = sn::WireFormat::Text;
+    sn::WireFormat format_ = sn::WireFormat::Text;
     std::string host_;
     std::string send_msg_;
-    std::function<void( std::string )> read_callback_;
+    std::function<void( std::string_view, sn::WireFormat )> read_callback_;
     std::function<void()> connect_callback_;
 
 public:
@@ -54,11 +62,24 @@ public:
         , ws_( net::make_strand( ioc ) )
     {}
 
-    void register_read_callback( std::function<void( std::string )> callback )
+    // The callback is invoked once for every message, even if several arrive in one frame
+    void register_read_callback( std::function<void( std::string_view, sn::WireFormat )> callback )
     {
         read_callback_ = callback;
     }
 
+    // Ask the server for a protocol. Must be called before run().
+    void request_wire_format( sn::WireFormat format )
+    {
+        requested_format_ = format;
+    }
+
+    // The protocol agreed with the server, which is text until the handshake completes
+    sn::WireFormat wire_format() const
+    {
+        return format_;
+    }
+
     void register_connect_callback( std::function<void()> callback )
     {
         connect_callback_ = callback;
@@ -103,15 +124,25 @@ public:
         // Set suggested timeout settings for the websocket
         ws_.set_option( websocket::stream_base::timeout::suggested( beast::role_type::client ) );
 
-        // Set a decorator to change the User-Agent of the handshake
-        ws_.set_option( websocket::stream_base::decorator( []( websocket::request_type& req ) {
-            req.set(
-                http::field::user_agent,
-                std::string( BOOST_BEAST_VERSION_STRING ) + " websocket-client-async" );
-        } ) );
+        // Set a decorator to change the User-Agent of the handshake and offer the subprotocol
+        const bool offer_binary = requested_format_ == sn::WireFormat::Binary;
+        ws_.set_option(
+            websocket::stream_base::decorator( [offer_binary]( websocket::request_type& req ) {
+                req.set(
+                    http::field::user_agent,
+                    std::string( BOOST_BEAST_VERSION_STRING ) + " websocket-client-async" );
+
+                if ( offer_binary )
+                {
+                    req.set(
+                        http::field::sec_websocket_protocol,
+                        std::string( sn::binarySubprotocol ) );
+                }
+            } ) );
 
         // Perform the websocket handshake
         ws_.async_handshake(
+            handshake_response_,
             host_,
             "/",
             beast::bind_front_handler( &session::on_handshake, shared_from_this() ) );
@@ -137,6 +168,15 @@ public:
         if ( ec )
             return fail( ec, "handshake" );
 
+        // Servers that don't know the binary protocol won't select it
+        const auto protocol = handshake_response_[http::field::sec_websocket_protocol];
+        if ( std::string_view( protocol.data(), protocol.size() ) == sn::binarySubprotocol )
+        {
+            format_ = sn::WireFormat::Binary;
+            framer_ = sn::MessageFramer( format_ );
+            ws_.binary( true );
+        }
+
         if ( connect_callback_ )
         {
             connect_callback_();
@@ -159,16 +199,18 @@ public:
             return fail( ec, "read" );
 
         std::cout << "Read " << bytes_transferred << " bytes\n";
-        std::ostringstream oss;
-        oss << beast::make_printable( buffer_.data() );
+        const auto data = buffer_.data();
+        framer_.Append( std::string_view( static_cast<const char*>( data.data() ), data.size() ) );
+        buffer_.consume( buffer_.size() );
 
-        if ( read_callback_ )
+        while ( const auto msg = framer_.Next() )
         {
-            read_callback_( oss.str() );
+            if ( read_callback_ )
+            {
+                read_callback_( *msg, format_ );
+            }
         }
 
-        buffer_.consume( buffer_.size() );
-
         async_read();
     }
 
@@ -0,0 +1,191 @@
+#include "message_builder.hpp"
+#include "node_cache.hpp"
+#include "write_ahead_log.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+
+const std::string programName( "wal_tool" );
+
+// A log that ends part way through a record is what a crash leaves behind, so only a record that
+// fails its checksum or cannot be decoded is an error.
+const int exitCorrupt = 2;
+
+void PrintUsage()
+{
+    std::cerr << "Usage:\n"
+              << "    " << programName << " inspect <log>\n"
+              << "        Prints every record in the log.\n"
+              << "    " << programName << " replay <log> [until]\n"
+              << "        Applies the records stamped no later than the time until, in\n"
+              << "        milliseconds since the Unix epoch, and prints the resulting FullState.\n";
+}
+
+std::optional<std::string> ReadFile( const std::string& path )
+{
+    std::ifstream file( path, std::ios::binary );
+    if ( !file )
+    {
+        return std::nullopt;
+    }
+
+    return std::string( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+}
+
+/*!
+    @brief Calls onRecord for each record in the log, which returns whether it used the record,
+           and reports how reading ended.
+    @returns The exit code of the program.
+ */
+int ForEachRecord(
+    const std::string& path,
+    const std::function<bool( const sn::WalRecord& )>& onRecord )
+{
+    const auto log = ReadFile( path );
+    if ( !log )
+    {
+        std::cerr << "Failed to read " << path << '\n';
+        return EXIT_FAILURE;
+    }
+    else if ( !sn::IsWalHeader( *log ) )
+    {
+        std::cerr << path << " is not a write-ahead log\n";
+        return EXIT_FAILURE;
+    }
+
+    sn::WalReader reader( *log );
+    sn::WalRecord record;
+    std::size_t count = 0;
+    auto status = sn::WalStatus::Record;
+
+    while ( ( status = reader.Next( record ) ) == sn::WalStatus::Record )
+    {
+        if ( onRecord( record ) )
+        {
+            ++count;
+        }
+    }
+
+    std::cerr << count << " record(s) used\n";
+
+    if ( status == sn::WalStatus::Truncated )
+    {
+        std::cerr << "Log ends part way through a record at byte " << reader.Offset() << '\n';
+    }
+    else if ( status == sn::WalStatus::Corrupt )
+    {
+        std::cerr << "Corrupt record at byte " << reader.Offset() << '\n';
+        return exitCorrupt;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int Inspect( const std::string& path )
+{
+    return ForEachRecord( path, []( const sn::WalRecord& record ) {
+        const auto source = record.message.type == sn::MessageType::UiUpdate ? "ui  " : "node";
+        std::cout << record.time << ' ' << source << ' ' << sn::BuildMessage( record.message )
+                  << '\n';
+        return true;
+    } );
+}
+
+int Replay( const std::string& path, const sn::Timestamp until )
+{
+    sn::NodeCache nodes;
+    const auto result = ForEachRecord( path, [&nodes, until]( const sn::WalRecord& record ) {
+        // Engine shards stamp their records before taking turns to append them, so a record
+        // may follow one with a later time. Later records are skipped rather than ending the
+        // replay at the first of them.
+        if ( record.time > until )
+        {
+            return false;
+        }
+
+        const auto& msg = record.message;
+        switch ( msg.type )
+        {
+        case sn::MessageType::NodeConnect:
+            nodes.Add( msg.node );
+            break;
+
+        case sn::MessageType::NodeUpdate:
+        case sn::MessageType::UiUpdate:
+            for ( const auto& io : msg.node.io )
+            {
+                nodes.UpdateValue( msg.node.id, io.id, io.value );
+            }
+            break;
+
+        case sn::MessageType::NodeDisconnect:
+            nodes.Remove( msg.node.id );
+            break;
+
+        default:
+            break;
+        }
+
+        return true;
+    } );
+
+    std::vector<sn::Node> state;
+    nodes.CopyNodes( state );
+    std::cout << sn::BuildFullState( state ) << '\n';
+
+    return result;
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+    if ( argc < 3 )
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    const std::string command( argv[1] );
+    const std::string path( argv[2] );
+
+    if ( command == "inspect" && argc == 3 )
+    {
+        return Inspect( path );
+    }
+    else if ( command == "replay" && argc <= 4 )
+    {
+        auto until = std::numeric_limits<sn::Timestamp>::max();
+        if ( argc == 4 )
+        {
+            const std::string_view untilArg( argv[3] );
+            const auto [end, error] =
+                std::from_chars( untilArg.data(), untilArg.data() + untilArg.size(), until );
+
+            if ( error != std::errc() || end != untilArg.data() + untilArg.size() )
+            {
+                std::cerr << "Invalid time: " << untilArg << '\n';
+                PrintUsage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        return Replay( path, until );
+    }
+
+    PrintUsage();
+    return EXIT_FAILURE;
+}